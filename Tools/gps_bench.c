@@ -0,0 +1,125 @@
+/* gps_bench.c
+ * Tom Trebisky  10-19-2026
+ *
+ * Run the GPS parser (../gps_parse.c) on the host over a
+ * recorded log of what the GPS sends (NMEA, UBX, or both)
+ * and see how fast it goes.
+ *
+ *   ./gps_bench [logfile [passes]]
+ *
+ * With no log named we use gps.log, here in Tools, which is
+ * 30 seconds of what our receiver is set up to send: RMC,
+ * VTG, GGA, GSA, GSV, GLL and ZDA, then NAV-PVT and NAV-TIMEUTC,
+ * once a second.  It starts in the middle of a sentence, the
+ * way a capture does.  Use it to compare before and after.
+ *
+ * The log is fed in chunks of CHUNK bytes to look like the
+ * spans we get from the ring on the target.
+ * On x86 we report cycles (from rdtsc), elsewhere just ns.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#ifdef __x86_64__
+#include <x86intrin.h>
+#endif
+
+#include "hydra.h"
+
+void gps_parse_init ( struct gps_parser *, void (*) ( int, void * ) );
+void gps_parse ( struct gps_parser *, const unsigned char *, int );
+
+#define CHUNK	16
+
+#define DEFAULT_LOG	"gps.log"
+
+static int counts[8];
+
+static void
+error ( char *msg )
+{
+		fprintf ( stderr, "%s\n", msg );
+		exit ( 1 );
+}
+
+static void
+msg_fn ( int type, void *msg )
+{
+		counts[type]++;
+}
+
+static double
+now_ns ( void )
+{
+		struct timespec ts;
+
+		clock_gettime ( CLOCK_MONOTONIC, &ts );
+		return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int
+main ( int argc, char **argv )
+{
+		struct gps_parser parser;
+		unsigned char *buf;
+		char *log = DEFAULT_LOG;
+		FILE *fp;
+		long len;
+		long off;
+		int passes = 100;
+		int n;
+		int i;
+		double t0, t1;
+		unsigned long long c0 = 0, c1 = 0;
+		double bytes;
+
+		if ( argc > 1 )
+			log = argv[1];
+		if ( argc > 2 )
+			passes = atoi ( argv[2] );
+
+		fp = fopen ( log, "rb" );
+		if ( ! fp )
+			error ( "Cannot open log" );
+		fseek ( fp, 0, SEEK_END );
+		len = ftell ( fp );
+		fseek ( fp, 0, SEEK_SET );
+		buf = malloc ( len );
+		if ( ! buf || fread ( buf, 1, len, fp ) != len )
+			error ( "Cannot read log" );
+		fclose ( fp );
+
+		gps_parse_init ( &parser, msg_fn );
+
+		t0 = now_ns ();
+#ifdef __x86_64__
+		c0 = __rdtsc ();
+#endif
+		for ( i=0; i<passes; i++ ) {
+			for ( off=0; off<len; off += n ) {
+				n = len - off < CHUNK ? len - off : CHUNK;
+				gps_parse ( &parser, buf + off, n );
+			}
+		}
+#ifdef __x86_64__
+		c1 = __rdtsc ();
+#endif
+		t1 = now_ns ();
+
+		bytes = (double) len * passes;
+
+		printf ( "%ld bytes x %d passes\n", len, passes );
+		printf ( "GGA %d, RMC %d, ZDA %d, PVT %d, TIMEUTC %d, UBX %d\n",
+			counts[GPS_GGA] / passes, counts[GPS_RMC] / passes, counts[GPS_ZDA] / passes,
+			counts[GPS_PVT] / passes, counts[GPS_TIMEUTC] / passes, counts[GPS_UBX] / passes );
+		printf ( "good %d, bad %d, other %d (all passes)\n", parser.good, parser.bad, parser.other );
+		printf ( "%.2f ns per byte, %.1f MB/s\n", (t1-t0) / bytes, bytes * 1e3 / (t1-t0) );
+		if ( c1 )
+			printf ( "%.2f cycles per byte, %.3f bytes per cycle\n", (c1-c0) / bytes, bytes / (c1-c0) );
+
+		return 0;
+}
+
+/* THE END */
@@ -0,0 +1,312 @@
+/* prof.c
+ * Tom Trebisky  10-19-2026
+ *
+ * Make sense of what the sampling profiler (../prof.c) sends,
+ * for "make prof_report".
+ *
+ *   ./prof symbols log [folded]
+ *
+ * symbols is either hydra.dump (objdump -d, we want the lines
+ * like "08000188 <stm_init>:") or the output of "nm -n" on
+ * hydra.elf, either one will do.  log is whatever came out of
+ * the console or USB, we only look between PROF BEGIN and
+ * PROF END, so the rest can be there too.  If there is more
+ * than one dump in the log, we add them all up.
+ *
+ * We print a flat profile (samples by function, where the pc
+ * was), and if asked, write folded stacks for flamegraph.pl:
+ *
+ *   thread;caller;function count
+ *
+ * The root is "thread" unless the sample landed in a handler,
+ * then it is "systick" or "irq_N".  The caller comes from the
+ * lr, so it is only there when it means something (not the
+ * same function, not an EXC_RETURN value).  The lr is the
+ * return address, so we look up lr-2 in case the call was the
+ * last thing in the caller.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_SYMS	8000
+#define MAX_NAME	64
+#define MAX_STACKS	4000
+
+struct sym {
+	unsigned long addr;
+	char name[MAX_NAME];
+	unsigned int count;
+};
+
+static struct sym syms[MAX_SYMS];
+static int nsyms;
+
+struct stack {
+	char name[3*MAX_NAME+8];
+	unsigned int count;
+};
+
+static struct stack stacks[MAX_STACKS];
+static int nstacks;
+
+static unsigned int total;
+static unsigned int dropped;
+static unsigned int unknown;
+
+static void
+error ( char *msg )
+{
+		fprintf ( stderr, "%s\n", msg );
+		exit ( 1 );
+}
+
+static int
+by_addr ( const void *a, const void *b )
+{
+		const struct sym *sa = a;
+		const struct sym *sb = b;
+
+		return sa->addr < sb->addr ? -1 : sa->addr > sb->addr;
+}
+
+static int
+by_count ( const void *a, const void *b )
+{
+		const struct sym *sa = a;
+		const struct sym *sb = b;
+
+		return (int) sb->count - (int) sa->count;
+}
+
+static void
+add_sym ( unsigned long addr, char *name )
+{
+		struct sym *sp;
+
+		if ( nsyms >= MAX_SYMS )
+		    error ( "Too many symbols" );
+
+		sp = &syms[nsyms++];
+		sp->addr = addr;
+		strncpy ( sp->name, name, MAX_NAME-1 );
+}
+
+/* "08000188 <stm_init>:" from objdump, or "08000188 T stm_init" from nm */
+static void
+load_syms ( char *path )
+{
+		char line[512];
+		char name[256];
+		unsigned long addr;
+		char type;
+		char *p;
+		FILE *fp;
+		int i;
+
+		fp = fopen ( path, "r" );
+		if ( ! fp )
+		    error ( "Cannot open symbols" );
+
+		while ( fgets ( line, sizeof(line), fp ) ) {
+		    if ( sscanf ( line, "%lx <%255[^>]>:", &addr, name ) == 2 ) {
+			add_sym ( addr, name );
+			continue;
+		    }
+		    if ( sscanf ( line, "%lx %c %255s", &addr, &type, name ) == 3 ) {
+			if ( type == 'T' || type == 't' || type == 'W' || type == 'w' )
+			    add_sym ( addr, name );
+		    }
+		}
+		fclose ( fp );
+
+		if ( nsyms == 0 )
+		    error ( "No symbols" );
+
+		/* drop gcc's suffixes, foo.constprop.0 and such */
+		for ( i=0; i<nsyms; i++ ) {
+		    p = strchr ( syms[i].name, '.' );
+		    if ( p && p != syms[i].name )
+			*p = '\0';
+		}
+
+		qsort ( syms, nsyms, sizeof(struct sym), by_addr );
+}
+
+/* The last symbol at or below addr */
+static struct sym *
+lookup ( unsigned long addr )
+{
+		int lo = 0;
+		int hi = nsyms - 1;
+		int mid;
+
+		if ( addr < syms[0].addr )
+		    return NULL;
+
+		while ( lo < hi ) {
+		    mid = (lo + hi + 1) / 2;
+		    if ( syms[mid].addr <= addr )
+			lo = mid;
+		    else
+			hi = mid - 1;
+		}
+		return &syms[lo];
+}
+
+static void
+root_name ( char *buf, int ipsr )
+{
+		if ( ipsr == 0 )
+		    strcpy ( buf, "thread" );
+		else if ( ipsr == 15 )
+		    strcpy ( buf, "systick" );
+		else if ( ipsr < 16 )
+		    sprintf ( buf, "exception_%d", ipsr );
+		else
+		    sprintf ( buf, "irq_%d", ipsr - 16 );
+}
+
+static void
+add_stack ( char *name, unsigned int count )
+{
+		int i;
+
+		for ( i=0; i<nstacks; i++ )
+		    if ( strcmp ( stacks[i].name, name ) == 0 ) {
+			stacks[i].count += count;
+			return;
+		    }
+
+		if ( nstacks >= MAX_STACKS )
+		    error ( "Too many stacks" );
+
+		strcpy ( stacks[nstacks].name, name );
+		stacks[nstacks++].count = count;
+}
+
+static void
+sample ( unsigned long pc, unsigned long lr, int ipsr, unsigned int count )
+{
+		char stack[sizeof(stacks[0].name)];
+		char root[32];
+		struct sym *fp;
+		struct sym *cp;
+
+		total += count;
+
+		fp = lookup ( pc );
+		if ( ! fp ) {
+		    unknown += count;
+		    return;
+		}
+		fp->count += count;
+
+		cp = NULL;
+		if ( lr < 0xF0000000 && lr > 2 )
+		    cp = lookup ( (lr & ~1UL) - 2 );
+		if ( cp == fp )
+		    cp = NULL;
+
+		root_name ( root, ipsr );
+		if ( cp )
+		    snprintf ( stack, sizeof(stack), "%s;%s;%s", root, cp->name, fp->name );
+		else
+		    snprintf ( stack, sizeof(stack), "%s;%s", root, fp->name );
+		add_stack ( stack, count );
+}
+
+static void
+load_log ( char *path )
+{
+		char line[512];
+		unsigned long pc, lr;
+		unsigned int hz, n, drop, count;
+		int ipsr;
+		int in = 0;
+		int dumps = 0;
+		FILE *fp;
+
+		fp = fopen ( path, "r" );
+		if ( ! fp )
+		    error ( "Cannot open log" );
+
+		while ( fgets ( line, sizeof(line), fp ) ) {
+		    if ( sscanf ( line, "PROF BEGIN %u %u %u", &hz, &n, &drop ) == 3 ) {
+			in = 1;
+			dumps++;
+			dropped += drop;
+			continue;
+		    }
+		    if ( strncmp ( line, "PROF END", 8 ) == 0 ) {
+			in = 0;
+			continue;
+		    }
+		    if ( in && sscanf ( line, "%lx %lx %d %u", &pc, &lr, &ipsr, &count ) == 4 )
+			sample ( pc, lr, ipsr, count );
+		}
+		fclose ( fp );
+
+		if ( dumps == 0 )
+		    error ( "No PROF BEGIN in the log" );
+
+		printf ( "%d dumps, %u samples at %u Hz, %u dropped, %u not in any function\n\n",
+		    dumps, total, hz, dropped, unknown );
+}
+
+static void
+flat ( void )
+{
+		unsigned int sofar = 0;
+		int i;
+
+		qsort ( syms, nsyms, sizeof(struct sym), by_count );
+
+		printf ( "%7s %7s %8s  %s\n", "self%", "cum%", "samples", "function" );
+		for ( i=0; i<nsyms && syms[i].count; i++ ) {
+		    sofar += syms[i].count;
+		    printf ( "%6.2f%% %6.2f%% %8u  %s\n",
+			100.0 * syms[i].count / total, 100.0 * sofar / total,
+			syms[i].count, syms[i].name );
+		}
+}
+
+static void
+folded ( char *path )
+{
+		FILE *fp;
+		int i;
+
+		fp = fopen ( path, "w" );
+		if ( ! fp )
+		    error ( "Cannot write folded stacks" );
+
+		for ( i=0; i<nstacks; i++ )
+		    fprintf ( fp, "%s %u\n", stacks[i].name, stacks[i].count );
+		fclose ( fp );
+
+		printf ( "\n%d stacks written to %s\n", nstacks, path );
+}
+
+int
+main ( int argc, char **argv )
+{
+		if ( argc < 3 )
+		    error ( "usage: prof symbols log [folded]" );
+
+		load_syms ( argv[1] );
+		load_log ( argv[2] );
+
+		if ( total == 0 )
+		    error ( "No samples" );
+
+		flat ();
+
+		if ( argc > 3 )
+		    folded ( argv[3] );
+
+		return 0;
+}
+
+/* THE END */
@@ -0,0 +1,233 @@
+/* qemu_run.c
+ * Tom Trebisky  10-19-2026
+ *
+ * Run the system tests in qemu.c under QEMU, for "make qemu"
+ *
+ *   ./qemu_run "qemu command" shift scenarios
+ *
+ * The QEMU command must have "-serial pty" for our console,
+ * QEMU tells us (on stderr) which pty it made, and we talk
+ * to Hydra through that.  We wait for READY, send a line from
+ * the scenarios file, and gather up the STAT and RESULT lines
+ * until the next READY.  Anything else (flood sends a lot)
+ * is skipped.  Lines in the scenarios file that start with
+ * '#' are comments.
+ *
+ * The first READY goes out before we open the pty, so we
+ * send an empty line to get another one.
+ *
+ * Cycles come from systick under QEMU, at 168 Mhz.  With
+ * "-icount shift=N" each instruction is 2^N ns, so we also
+ * give instructions, which is the number to watch.
+ *
+ * The output is CSV, one line per STAT or RESULT:
+ *   scenario,arg,key,value
+ * where RESULT gives the keys cycles, insns and status.
+ * We exit 1 if any scenario has a nonzero status.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <poll.h>
+#include <sys/wait.h>
+
+#define CPU_HZ		168000000.0
+#define TIMEOUT_MS	60000
+
+static pid_t qemu_pid;
+static int qemu_err;
+static int tty = -1;
+
+static void
+error ( char *msg )
+{
+		fprintf ( stderr, "qemu_run: %s\n", msg );
+		if ( qemu_pid > 0 )
+		    kill ( qemu_pid, SIGTERM );
+		exit ( 2 );
+}
+
+/* QEMU with stderr to us */
+static void
+start_qemu ( char *cmd )
+{
+		int fds[2];
+
+		if ( pipe ( fds ) < 0 )
+		    error ( "pipe" );
+
+		qemu_pid = fork ();
+		if ( qemu_pid < 0 )
+		    error ( "fork" );
+
+		if ( qemu_pid == 0 ) {
+		    close ( fds[0] );
+		    dup2 ( fds[1], 2 );
+		    execl ( "/bin/sh", "sh", "-c", cmd, (char *) NULL );
+		    _exit ( 127 );
+		}
+
+		close ( fds[1] );
+		qemu_err = fds[0];
+}
+
+/* Read a line from fd, gives up after TIMEOUT_MS.
+ * Returns 0 at end of file.
+ */
+static int
+get_line ( int fd, char *buf, int size )
+{
+		struct pollfd pfd;
+		int n = 0;
+		char c;
+
+		pfd.fd = fd;
+		pfd.events = POLLIN;
+
+		for ( ;; ) {
+		    if ( poll ( &pfd, 1, TIMEOUT_MS ) <= 0 )
+			error ( "timeout" );
+		    if ( read ( fd, &c, 1 ) != 1 )
+			return 0;
+		    if ( c == '\r' )
+			continue;
+		    if ( c == '\n' )
+			break;
+		    if ( n < size - 1 )
+			buf[n++] = c;
+		}
+		buf[n] = '\0';
+		return 1;
+}
+
+/* "char device redirected to /dev/pts/5 (label serial1)" */
+static void
+open_tty ( void )
+{
+		char line[256];
+		char path[64];
+		struct termios tio;
+		char *p;
+
+		for ( ;; ) {
+		    if ( ! get_line ( qemu_err, line, sizeof(line) ) )
+			error ( "QEMU quit" );
+		    p = strstr ( line, "redirected to " );
+		    if ( p && sscanf ( p + 14, "%63s", path ) == 1 )
+			break;
+		    fprintf ( stderr, "%s\n", line );
+		}
+
+		tty = open ( path, O_RDWR | O_NOCTTY );
+		if ( tty < 0 )
+		    error ( "Cannot open pty" );
+
+		tcgetattr ( tty, &tio );
+		cfmakeraw ( &tio );
+		tcsetattr ( tty, TCSANOW, &tio );
+}
+
+static void
+wait_ready ( void )
+{
+		char line[256];
+
+		for ( ;; ) {
+		    if ( ! get_line ( tty, line, sizeof(line) ) )
+			error ( "pty closed" );
+		    if ( strcmp ( line, "READY" ) == 0 )
+			return;
+		}
+}
+
+/* Returns the status from RESULT */
+static int
+run ( char *cmd, int shift )
+{
+		char line[256];
+		char name[64];
+		char key[64];
+		int arg, status;
+		unsigned int cycles;
+		double insns;
+		int val;
+
+		if ( sscanf ( cmd, "%63s %d", name, &arg ) != 2 )
+		    arg = 0;
+
+		write ( tty, cmd, strlen(cmd) );
+		write ( tty, "\n", 1 );
+
+		status = -1;
+		for ( ;; ) {
+		    if ( ! get_line ( tty, line, sizeof(line) ) )
+			error ( "pty closed" );
+		    if ( strcmp ( line, "READY" ) == 0 )
+			break;
+
+		    if ( sscanf ( line, "STAT %63s %d", key, &val ) == 2 )
+			printf ( "%s,%d,%s,%d\n", name, arg, key, val );
+
+		    if ( sscanf ( line, "RESULT %*s %*d %u %d", &cycles, &status ) == 2 ) {
+			insns = cycles * 1.0e9 / (CPU_HZ * (1 << shift));
+			printf ( "%s,%d,cycles,%u\n", name, arg, cycles );
+			printf ( "%s,%d,insns,%.0f\n", name, arg, insns );
+			printf ( "%s,%d,status,%d\n", name, arg, status );
+		    }
+		}
+
+		fflush ( stdout );
+		return status;
+}
+
+int
+main ( int argc, char **argv )
+{
+		char line[256];
+		int failed = 0;
+		int shift;
+		FILE *fp;
+		char *p;
+
+		if ( argc != 4 )
+		    error ( "usage: qemu_run \"qemu command\" shift scenarios" );
+		shift = atoi ( argv[2] );
+
+		fp = fopen ( argv[3], "r" );
+		if ( ! fp )
+		    error ( "Cannot open scenarios" );
+
+		start_qemu ( argv[1] );
+		open_tty ();
+
+		/* We likely missed the first READY */
+		write ( tty, "\n", 1 );
+		wait_ready ();
+
+		printf ( "scenario,arg,key,value\n" );
+
+		while ( fgets ( line, sizeof(line), fp ) ) {
+		    p = strchr ( line, '\n' );
+		    if ( p )
+			*p = '\0';
+		    if ( line[0] == '\0' || line[0] == '#' )
+			continue;
+		    if ( run ( line, shift ) != 0 ) {
+			fprintf ( stderr, "FAILED: %s\n", line );
+			failed = 1;
+		    }
+		}
+
+		fclose ( fp );
+		kill ( qemu_pid, SIGTERM );
+		waitpid ( qemu_pid, NULL, 0 );
+
+		return failed;
+}
+
+/* THE END */
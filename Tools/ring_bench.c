@@ -0,0 +1,304 @@
+/* ring_bench.c
+ * Tom Trebisky  10-19-2026
+ *
+ * Run the ring code (../ring.c) on the host with a producer
+ * thread and a consumer thread, which is about as hard as we
+ * can push the one producer / one consumer rules.
+ * The producer sends a counting sequence and the consumer
+ * checks every byte, so this is a torture test as well as
+ * a benchmark.
+ *
+ *   ./ring_bench [megabytes]
+ *
+ * We do it twice, once a byte at a time with ring_put/ring_get
+ * and once with the copy calls (which use the spans).
+ * Whichever side finds the ring full (or empty) yields, so
+ * this works even on a single CPU (where the numbers are
+ * mostly about the scheduler).
+ *
+ * Before any of that, a few single threaded checks on a small
+ * ring for the edges the threads may never happen to land on:
+ * empty and full, spans that stop at the end of the buffer,
+ * and head and tail running past 2^32.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "hydra.h"
+
+void ring_init ( struct ring *, unsigned char *, int );
+int ring_put ( struct ring *, int );
+int ring_get ( struct ring * );
+int ring_write ( struct ring *, const void *, int );
+int ring_read ( struct ring *, void *, int );
+int ring_count ( struct ring * );
+int ring_space ( struct ring * );
+void ring_commit ( struct ring *, int );
+void ring_consume ( struct ring *, int );
+
+#define RING_SIZE	1024
+#define CHUNK		100
+
+static unsigned char ring_buf[RING_SIZE];
+static struct ring ring;
+
+static long total;
+static int bulk;
+
+#define SMALL_SIZE	8
+
+static int failed;
+
+#define CHECK(x)	check ( (x), #x, __LINE__ )
+
+static void
+check ( int ok, char *what, int line )
+{
+		if ( ok )
+			return;
+		printf ( "FAIL line %d: %s\n", line, what );
+		failed++;
+}
+
+static void
+edge_empty_full ( void )
+{
+		unsigned char buf[SMALL_SIZE];
+		struct ring r;
+		int n, i;
+
+		ring_init ( &r, buf, SMALL_SIZE );
+
+		CHECK ( ring_count ( &r ) == 0 );
+		CHECK ( ring_space ( &r ) == SMALL_SIZE );
+		CHECK ( ring_get ( &r ) == -1 );
+		ring_peek ( &r, &n );
+		CHECK ( n == 0 );
+		ring_reserve ( &r, &n );
+		CHECK ( n == SMALL_SIZE );
+
+		/* The whole buffer gets used */
+		for ( i=0; i<SMALL_SIZE; i++ )
+			CHECK ( ring_put ( &r, i ) == 0 );
+		CHECK ( ring_put ( &r, 99 ) == -1 );
+		CHECK ( ring_count ( &r ) == SMALL_SIZE );
+		CHECK ( ring_space ( &r ) == 0 );
+		ring_reserve ( &r, &n );
+		CHECK ( n == 0 );
+		CHECK ( ring_write ( &r, "x", 1 ) == 0 );
+
+		for ( i=0; i<SMALL_SIZE; i++ )
+			CHECK ( ring_get ( &r ) == i );
+		CHECK ( ring_get ( &r ) == -1 );
+		CHECK ( ring_count ( &r ) == 0 );
+}
+
+static void
+edge_spans ( void )
+{
+		unsigned char buf[SMALL_SIZE];
+		unsigned char out[SMALL_SIZE];
+		unsigned char *p;
+		struct ring r;
+		int n;
+
+		ring_init ( &r, buf, SMALL_SIZE );
+
+		/* Move head and tail to 6 */
+		CHECK ( ring_write ( &r, "abcdef", 6 ) == 6 );
+		CHECK ( ring_read ( &r, out, 6 ) == 6 );
+
+		/* 8 free, but only 2 before the end */
+		p = ring_reserve ( &r, &n );
+		CHECK ( p == &buf[6] );
+		CHECK ( n == 2 );
+		p[0] = 'A';
+		p[1] = 'B';
+		ring_commit ( &r, 2 );
+
+		/* The rest is at the start, less what we just used */
+		p = ring_reserve ( &r, &n );
+		CHECK ( p == &buf[0] );
+		CHECK ( n == 6 );
+
+		/* A copy that has to split */
+		CHECK ( ring_write ( &r, "CDEFGH", 6 ) == 6 );
+		CHECK ( ring_space ( &r ) == 0 );
+
+		p = ring_peek ( &r, &n );
+		CHECK ( p == &buf[6] );
+		CHECK ( n == 2 );
+		CHECK ( p[0] == 'A' && p[1] == 'B' );
+		ring_consume ( &r, 2 );
+
+		p = ring_peek ( &r, &n );
+		CHECK ( p == &buf[0] );
+		CHECK ( n == 6 );
+
+		CHECK ( ring_read ( &r, out, SMALL_SIZE ) == 6 );
+		CHECK ( memcmp ( out, "CDEFGH", 6 ) == 0 );
+		ring_peek ( &r, &n );
+		CHECK ( n == 0 );
+}
+
+/* head and tail run free, so they wrap at 2^32 */
+static void
+edge_counter_wrap ( void )
+{
+		unsigned char buf[SMALL_SIZE];
+		unsigned char out[SMALL_SIZE];
+		struct ring r;
+		int i;
+
+		ring_init ( &r, buf, SMALL_SIZE );
+		r.head = r.tail = 0xfffffffd;
+
+		CHECK ( ring_write ( &r, "01234567", 8 ) == 8 );
+		CHECK ( r.head == 5 );
+		CHECK ( ring_count ( &r ) == SMALL_SIZE );
+		CHECK ( ring_put ( &r, 'x' ) == -1 );
+
+		CHECK ( ring_read ( &r, out, 5 ) == 5 );
+		CHECK ( memcmp ( out, "01234", 5 ) == 0 );
+		for ( i=0; i<5; i++ )
+			CHECK ( ring_put ( &r, 'a' + i ) == 0 );
+		CHECK ( ring_read ( &r, out, SMALL_SIZE ) == SMALL_SIZE );
+		CHECK ( memcmp ( out, "567abcde", 8 ) == 0 );
+		CHECK ( ring_count ( &r ) == 0 );
+}
+
+static void
+edges ( void )
+{
+		edge_empty_full ();
+		edge_spans ();
+		edge_counter_wrap ();
+
+		if ( failed ) {
+			printf ( "edges: %d checks failed\n", failed );
+			exit ( 1 );
+		}
+		printf ( "edges: ok\n" );
+}
+
+static double
+now_ns ( void )
+{
+		struct timespec ts;
+
+		clock_gettime ( CLOCK_MONOTONIC, &ts );
+		return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void *
+producer ( void *arg )
+{
+		unsigned char buf[CHUNK];
+		unsigned char seq = 0;
+		long sent = 0;
+		int n, i;
+
+		while ( sent < total ) {
+			if ( ! bulk ) {
+				if ( ring_put ( &ring, seq ) == 0 ) {
+					seq++;
+					sent++;
+				} else
+					sched_yield ();
+				continue;
+			}
+			n = total - sent < CHUNK ? total - sent : CHUNK;
+			for ( i=0; i<n; i++ )
+				buf[i] = seq + i;
+			n = ring_write ( &ring, buf, n );
+			if ( n == 0 )
+				sched_yield ();
+			seq += n;
+			sent += n;
+		}
+		return NULL;
+}
+
+/* returns the number of bad bytes */
+static long
+consumer ( void )
+{
+		unsigned char buf[CHUNK];
+		unsigned char seq = 0;
+		long got = 0;
+		long bad = 0;
+		int n, i, c;
+
+		while ( got < total ) {
+			if ( ! bulk ) {
+				c = ring_get ( &ring );
+				if ( c < 0 ) {
+					sched_yield ();
+					continue;
+				}
+				if ( c != seq )
+					bad++;
+				seq = c + 1;
+				got++;
+				continue;
+			}
+			n = ring_read ( &ring, buf, CHUNK );
+			if ( n == 0 )
+				sched_yield ();
+			for ( i=0; i<n; i++ ) {
+				if ( buf[i] != seq )
+					bad++;
+				seq = buf[i] + 1;
+			}
+			got += n;
+		}
+		return bad;
+}
+
+static void
+run ( char *what )
+{
+		pthread_t thr;
+		double t0, t1;
+		long bad;
+
+		ring_init ( &ring, ring_buf, RING_SIZE );
+
+		t0 = now_ns ();
+		pthread_create ( &thr, NULL, producer, NULL );
+		bad = consumer ();
+		pthread_join ( thr, NULL );
+		t1 = now_ns ();
+
+		printf ( "%-6s %ld bytes, %ld bad, %.2f ns per byte, %.1f MB/s\n",
+			what, total, bad, (t1-t0) / total, total * 1e3 / (t1-t0) );
+		if ( bad )
+			exit ( 1 );
+}
+
+int
+main ( int argc, char **argv )
+{
+		int mb = 16;
+
+		if ( argc > 1 )
+			mb = atoi ( argv[1] );
+		total = mb * 1024L * 1024L;
+
+		edges ();
+
+		bulk = 0;
+		run ( "byte" );
+
+		bulk = 1;
+		run ( "bulk" );
+
+		return 0;
+}
+
+/* THE END */
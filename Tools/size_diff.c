@@ -0,0 +1,152 @@
+/* size_diff.c
+ * Tom Trebisky  10-19-2026
+ *
+ * Compare symbol sizes from two builds, for "make compare".
+ * Each file is the output of "nm -S --size-sort" on hydra.elf.
+ *
+ *   ./size_diff old.sizes new.sizes [count]
+ *
+ * gcc renames things when it clones or splits them, and LTO
+ * renames statics (foo.constprop.0, foo.lto_priv.0 and such),
+ * so we drop everything from the first dot on and add up the
+ * pieces.  Statics with the same name in different files get
+ * added up too, that is good enough to see where things went.
+ *
+ * We print the count (default 30) biggest changes, then totals
+ * for flash (text, rodata, and the flash copy of data) and
+ * for ram (data and bss).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_SYMS	4000
+#define MAX_NAME	64
+
+struct sym {
+	char name[MAX_NAME];
+	int old_size;
+	int new_size;
+};
+
+static struct sym syms[MAX_SYMS];
+static int nsyms;
+
+static void
+error ( char *msg )
+{
+		fprintf ( stderr, "%s\n", msg );
+		exit ( 1 );
+}
+
+static struct sym *
+lookup ( char *name )
+{
+		struct sym *sp;
+		int i;
+
+		for ( i=0; i<nsyms; i++ )
+		    if ( strcmp ( syms[i].name, name ) == 0 )
+			return &syms[i];
+
+		if ( nsyms >= MAX_SYMS )
+		    error ( "Too many symbols" );
+
+		sp = &syms[nsyms++];
+		strncpy ( sp->name, name, MAX_NAME-1 );
+		return sp;
+}
+
+static void
+load ( char *path, int which, int *flash, int *ram )
+{
+		char line[256];
+		char name[256];
+		unsigned long addr, size;
+		struct sym *sp;
+		char *p;
+		char type;
+		FILE *fp;
+
+		fp = fopen ( path, "r" );
+		if ( ! fp )
+		    error ( "Cannot open file" );
+
+		while ( fgets ( line, sizeof(line), fp ) ) {
+		    if ( sscanf ( line, "%lx %lx %c %255s", &addr, &size, &type, name ) != 4 )
+			continue;
+
+		    p = strchr ( name, '.' );
+		    if ( p && p != name )
+			*p = '\0';
+
+		    sp = lookup ( name );
+		    if ( which )
+			sp->new_size += size;
+		    else
+			sp->old_size += size;
+
+		    switch ( type ) {
+			case 'T': case 't': case 'R': case 'r':
+			    *flash += size;
+			    break;
+			case 'D': case 'd':
+			    *flash += size;
+			    *ram += size;
+			    break;
+			case 'B': case 'b':
+			    *ram += size;
+			    break;
+		    }
+		}
+
+		fclose ( fp );
+}
+
+static int
+by_change ( const void *a, const void *b )
+{
+		const struct sym *sa = a;
+		const struct sym *sb = b;
+
+		return abs ( sb->new_size - sb->old_size ) - abs ( sa->new_size - sa->old_size );
+}
+
+int
+main ( int argc, char **argv )
+{
+		int old_flash = 0, old_ram = 0;
+		int new_flash = 0, new_ram = 0;
+		int count = 30;
+		struct sym *sp;
+		int i;
+
+		if ( argc < 3 )
+		    error ( "usage: size_diff old.sizes new.sizes [count]" );
+		if ( argc > 3 )
+		    count = atoi ( argv[3] );
+
+		load ( argv[1], 0, &old_flash, &old_ram );
+		load ( argv[2], 1, &new_flash, &new_ram );
+
+		qsort ( syms, nsyms, sizeof(struct sym), by_change );
+
+		printf ( "%-32s %8s %8s %8s\n", "symbol", "old", "new", "change" );
+		for ( i=0; i<nsyms && i<count; i++ ) {
+		    sp = &syms[i];
+		    if ( sp->new_size == sp->old_size )
+			break;
+		    printf ( "%-32s %8d %8d %+8d%s\n", sp->name,
+			sp->old_size, sp->new_size, sp->new_size - sp->old_size,
+			sp->new_size ? "" : "  (gone or inlined)" );
+		}
+
+		printf ( "\n" );
+		printf ( "flash %8d -> %8d  (%+d)\n", old_flash, new_flash, new_flash - old_flash );
+		printf ( "ram   %8d -> %8d  (%+d)\n", old_ram, new_ram, new_ram - old_ram );
+
+		return 0;
+}
+
+/* THE END */
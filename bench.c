@@ -0,0 +1,531 @@
+/* bench.c
+ * (c) Tom Trebisky  10-19-2026
+ *
+ * Benchmarks, on the board itself, with the DWT cycle counter.
+ *
+ * A benchmark is a function that does something n times.
+ * bench_add() registers one, and the ones below are added
+ * the first time bench_run() is called.  For each benchmark:
+ *
+ *  - if it has no batch size, we run it once, then double n
+ *    until a batch takes BENCH_MIN_CYCLES, which also warms
+ *    things up (caches, the flash accelerator, lazy setup).
+ *    Otherwise we run one batch to warm up.
+ *  - then we time BENCH_SAMPLES batches, minus what it costs
+ *    to read the cycle counter, and sort them.
+ *
+ * We report the min, median and 99th percentile, per operation,
+ * in cycles and in ns (at the current CPU clock).  The min is
+ * what the code can do, the p99 shows what interrupts and such
+ * do to it.  Cycles compare across boards, ns across clocks.
+ * Each line also gives the board, the build profile and the
+ * clock, so results from anywhere can go in one pile.
+ *
+ * Benchmarks (printf, for one) can make noise, so nothing is
+ * reported until all of them are done.  Then the results go
+ * out between "BENCH BEGIN" and "BENCH END" lines, as CSV
+ * (with a header line) or JSON, on the console uart or USB.
+ *
+ *   bench_run ( 0, BENCH_CSV );		all of them
+ *   bench_run ( "event", BENCH_JSON | BENCH_USB );
+ *
+ * The first argument picks the ones whose names start with it.
+ * USB should be going (boot_late) before any of this.
+ *
+ * The host build (see host.c) runs this same code, where
+ * cycles are ns at a pretend 1 Ghz, and host_bench.c adds a
+ * few benchmarks only it can do.  There is no iic.c there.
+ */
+
+#include <stdarg.h>
+#include "hydra.h"
+
+#define MAX_BENCH		32
+#define BENCH_SAMPLES		100
+#define BENCH_MIN_CYCLES	10000
+#define BENCH_MAX_BATCH		(1 << 16)
+
+#define OUT_SIZE		160
+
+static struct bench benches[MAX_BENCH];
+static int num_bench;
+static int bench_ready;
+
+struct bench_result {
+	struct bench *bp;
+	int batch;
+	unsigned int min;	/* cycles per op x 100 */
+	unsigned int median;
+	unsigned int p99;
+};
+
+static struct bench_result results[MAX_BENCH];
+static int num_results;
+
+static unsigned int samples[BENCH_SAMPLES];
+static unsigned int overhead;
+
+static int bench_how;
+
+void asnprintf ( char *, unsigned int, const char *, va_list );
+
+#ifdef HYDRA_HOST
+/* see host.c, the console goes nowhere while this is set */
+extern int host_quiet;
+#endif
+
+/* ---------------------------------------------------------- */
+/* The benchmarks */
+/* ---------------------------------------------------------- */
+
+static void
+nothing ( void )
+{
+}
+
+#define BENCH_EVENTS	16
+
+/* Put an event somewhere in a list of 16, and take it out */
+static void
+b_event ( int n )
+{
+	int ids[BENCH_EVENTS];
+	int i;
+
+	for ( i=0; i<BENCH_EVENTS; i++ )
+	    ids[i] = event ( 100000 + i * 1000, nothing );
+
+	for ( i=0; i<n; i++ )
+	    event_cancel ( event ( 100000 + (i * 7919) % 16000, nothing ) );
+
+	for ( i=0; i<BENCH_EVENTS; i++ )
+	    event_cancel ( ids[i] );
+}
+
+static void
+bench_fmt ( char *buf, char *fmt, ... )
+{
+	va_list args;
+
+	va_start ( args, fmt );
+	asnprintf ( buf, OUT_SIZE, fmt, args );
+	va_end ( args );
+}
+
+static void
+b_format ( int n )
+{
+	char buf[OUT_SIZE];
+	int i;
+
+	for ( i=0; i<n; i++ )
+	    bench_fmt ( buf, "%s: %d %X %x\n", "count", i, i, i );
+}
+
+/* This is mostly the uart, at 115200 baud */
+static void
+b_printf ( int n )
+{
+	int i;
+
+	for ( i=0; i<n; i++ )
+	    printf ( "%s: %d %X %x\n", "count", i, i, i );
+}
+
+static unsigned char ring_buf[256];
+static struct ring ring = RING_INIT ( ring_buf );
+
+/* 48 bytes in and out, so the spans wrap now and then */
+static void
+b_ring_copy ( int n )
+{
+	unsigned char buf[48];
+	int i;
+
+	memset ( buf, 0x55, sizeof(buf) );
+	for ( i=0; i<n; i++ ) {
+	    ring_write ( &ring, buf, sizeof(buf) );
+	    ring_read ( &ring, buf, sizeof(buf) );
+	}
+}
+
+/* PB0, which nothing else in Hydra uses (PA2 is the GPS
+ * on USART2), so it can go on a scope.
+ */
+#define BENCH_GPIO	GPIOB
+#define BENCH_PIN	0
+
+static void
+gpio_setup ( void )
+{
+	gpio_output_pp_config ( BENCH_GPIO, BENCH_PIN );
+}
+
+/* One full cycle on the pin, three ways.
+ * gpio_bit() is the old function call, next to the two
+ * inline ones from hydra.h
+ */
+static void
+b_gpio ( int n )
+{
+	int i;
+
+	for ( i=0; i<n; i++ ) {
+	    gpio_bit_fast ( BENCH_GPIO, BENCH_PIN, 0 );
+	    gpio_bit_fast ( BENCH_GPIO, BENCH_PIN, 1 );
+	}
+}
+
+static void
+b_gpio_bit ( int n )
+{
+	int i;
+
+	for ( i=0; i<n; i++ ) {
+	    gpio_bit ( BENCH_GPIO, BENCH_PIN, 0 );
+	    gpio_bit ( BENCH_GPIO, BENCH_PIN, 1 );
+	}
+}
+
+static void
+b_gpio_mask ( int n )
+{
+	int i;
+
+	for ( i=0; i<n; i++ ) {
+	    gpio_write_mask ( BENCH_GPIO, BIT(BENCH_PIN), 0 );
+	    gpio_write_mask ( BENCH_GPIO, 0, BIT(BENCH_PIN) );
+	}
+}
+
+#ifndef HYDRA_HOST
+/* A bus just for this, with no START, nobody on it will care.
+ * PB9 and PB8, where I2C1 can go on both the F1 and F4.
+ */
+#define BENCH_SDA_GPIO	GPIOB
+#define BENCH_SDA_PIN	9
+#define BENCH_SCL_GPIO	GPIOB
+#define BENCH_SCL_PIN	8
+
+static iic_bus_t bench_bus;
+static int bench_bus_ok;
+
+static void
+iic_setup ( int speed )
+{
+	if ( ! bench_bus_ok ) {
+	    iic_bus_init ( &bench_bus, BENCH_SDA_GPIO, BENCH_SDA_PIN,
+		BENCH_SCL_GPIO, BENCH_SCL_PIN, speed );
+	    bench_bus_ok = 1;
+	}
+	iic_bus_speed ( &bench_bus, speed );
+}
+
+static void iic_setup_100 ( void ) { iic_setup ( IIC_100K ); }
+static void iic_setup_400 ( void ) { iic_setup ( IIC_400K ); }
+static void iic_setup_1m ( void ) { iic_setup ( IIC_1M ); }
+
+/* A byte and the ack, 9 clocks */
+static void
+b_iic ( int n )
+{
+	int i;
+
+	for ( i=0; i<n; i++ )
+	    iic_bus_byte ( &bench_bus, 0x55 );
+}
+#endif
+
+#if defined(HYDRA_USB) && !defined(CHIP_F103)
+/* see usbF4/library/public.c */
+void usb_fifo_write ( char *, int );
+void usb_fifo_read ( char *, int );
+void usb_fifo_flush ( void );
+
+/* One full speed packet */
+#define USB_PACKET	64
+
+static char usb_buf[USB_PACKET];
+
+static void
+b_usb_write ( int n )
+{
+	int i;
+
+	for ( i=0; i<n; i++ )
+	    usb_fifo_write ( usb_buf, USB_PACKET );
+}
+
+static void
+b_usb_read ( int n )
+{
+	int i;
+
+	for ( i=0; i<n; i++ )
+	    usb_fifo_read ( usb_buf, USB_PACKET );
+}
+#endif
+
+static void
+bench_init ( void )
+{
+	bench_add ( "event", b_event, 0, 0, 0, "event then event_cancel, 16 waiting" );
+	bench_add ( "format", b_format, 0, 0, 0, "asnprintf, 4 conversions" );
+	bench_add ( "printf", b_printf, 0, 1, 0, "printf out the console uart" );
+	bench_add ( "ring_copy", b_ring_copy, 0, 0, 0, "ring_write and ring_read, 48 bytes" );
+	bench_add ( "gpio_toggle", b_gpio, gpio_setup, 0, BENCH_NOIRQ, "gpio_bit_fast, 0 then 1" );
+	bench_add ( "gpio_bit", b_gpio_bit, gpio_setup, 0, BENCH_NOIRQ, "gpio_bit, 0 then 1" );
+	bench_add ( "gpio_mask", b_gpio_mask, gpio_setup, 0, BENCH_NOIRQ, "gpio_write_mask, set then clear" );
+#ifndef HYDRA_HOST
+	bench_add ( "iic_byte_100k", b_iic, iic_setup_100, 4, BENCH_NOIRQ, "bit banged i2c, one byte and ack" );
+	bench_add ( "iic_byte_400k", b_iic, iic_setup_400, 4, BENCH_NOIRQ, "bit banged i2c, one byte and ack" );
+	bench_add ( "iic_byte_1m", b_iic, iic_setup_1m, 4, BENCH_NOIRQ, "bit banged i2c, one byte and ack" );
+#endif
+#if defined(HYDRA_USB) && !defined(CHIP_F103)
+	/* One packet per sample, the FIFO only holds so much */
+	bench_add ( "usb_fifo_write", b_usb_write, usb_fifo_flush, 1, BENCH_NOIRQ | BENCH_NOUSB,
+	    "64 bytes into the endpoint 0 FIFO" );
+	bench_add ( "usb_fifo_read", b_usb_read, usb_fifo_flush, 1, BENCH_NOIRQ | BENCH_NOUSB,
+	    "64 bytes from the receive FIFO" );
+#endif
+}
+
+/* ---------------------------------------------------------- */
+/* The machinery */
+/* ---------------------------------------------------------- */
+
+void
+bench_add ( char *name, void (*fn) ( int ), void (*setup) ( void ), int batch, int flags, char *info )
+{
+	struct bench *bp;
+
+	if ( num_bench >= MAX_BENCH )
+	    panic ( "bench_add" );
+
+	bp = &benches[num_bench++];
+	bp->name = name;
+	bp->fn = fn;
+	bp->setup = setup;
+	bp->batch = batch;
+	bp->flags = flags;
+	bp->info = info;
+}
+
+/* What it costs to read the counter twice */
+static void
+bench_overhead ( void )
+{
+	unsigned int t;
+	int i;
+
+	overhead = ~0;
+	for ( i=0; i<16; i++ ) {
+	    t = get_cycles ();
+	    t = get_cycles () - t;
+	    if ( t < overhead )
+		overhead = t;
+	}
+}
+
+static unsigned int
+bench_once ( struct bench *bp, int n )
+{
+	unsigned int t;
+
+	if ( bp->setup )
+	    (*bp->setup) ();
+
+	if ( bp->flags & BENCH_NOIRQ )
+	    irq_disable ();
+
+	t = get_cycles ();
+	(*bp->fn) ( n );
+	t = get_cycles () - t;
+
+	if ( bp->flags & BENCH_NOIRQ )
+	    irq_enable ();
+
+	return t > overhead ? t - overhead : 0;
+}
+
+/* Only 100 of them */
+static void
+sort ( unsigned int *vals, int n )
+{
+	unsigned int v;
+	int i, j;
+
+	for ( i=1; i<n; i++ ) {
+	    v = vals[i];
+	    for ( j=i; j > 0 && vals[j-1] > v; j-- )
+		vals[j] = vals[j-1];
+	    vals[j] = v;
+	}
+}
+
+static unsigned int
+per_op ( unsigned int cycles, int n )
+{
+	return cycles / n * 100 + (cycles % n) * 100 / n;
+}
+
+static void
+bench_one ( struct bench *bp )
+{
+	struct bench_result *rp;
+	unsigned int t;
+	int n;
+	int i;
+
+	n = bp->batch;
+	if ( n ) {
+	    bench_once ( bp, n );
+	} else {
+	    /* so a slow first call doesn't leave us at n = 1 */
+	    bench_once ( bp, 1 );
+	    for ( n = 1; n < BENCH_MAX_BATCH; n *= 2 ) {
+		t = bench_once ( bp, n );
+		if ( t >= BENCH_MIN_CYCLES )
+		    break;
+	    }
+	}
+
+	for ( i=0; i<BENCH_SAMPLES; i++ )
+	    samples[i] = bench_once ( bp, n );
+
+	sort ( samples, BENCH_SAMPLES );
+
+	rp = &results[num_results++];
+	rp->bp = bp;
+	rp->batch = n;
+	rp->min = per_op ( samples[0], n );
+	rp->median = per_op ( samples[BENCH_SAMPLES/2], n );
+	rp->p99 = per_op ( samples[BENCH_SAMPLES * 99 / 100 - 1], n );
+}
+
+/* ---------------------------------------------------------- */
+
+static void
+bench_out ( char *fmt, ... )
+{
+	char buf[OUT_SIZE];
+	va_list args;
+
+	va_start ( args, fmt );
+	asnprintf ( buf, OUT_SIZE, fmt, args );
+	va_end ( args );
+
+#if defined(HYDRA_USB) && !defined(CHIP_F103)
+	if ( bench_how & BENCH_USB ) {
+	    usb_puts ( buf );
+	    return;
+	}
+#endif
+	puts ( buf );
+}
+
+/* x100 to "12.34", we have no %f */
+static char *
+fixed ( char *buf, unsigned int val )
+{
+	sprintf ( buf, "%d.%d%d", val / 100, (val / 10) % 10, val % 10 );
+	return buf;
+}
+
+static unsigned int
+to_ns ( unsigned int c100, int mhz )
+{
+	return c100 / mhz * 1000 + (c100 % mhz) * 1000 / mhz;
+}
+
+static int
+starts ( char *name, char *prefix )
+{
+	while ( *prefix )
+	    if ( *name++ != *prefix++ )
+		return 0;
+	return 1;
+}
+
+#ifndef HYDRA_TARGET
+#define HYDRA_TARGET	"unknown"
+#endif
+#ifndef HYDRA_PROFILE
+#define HYDRA_PROFILE	"unknown"
+#endif
+
+static void
+bench_report ( void )
+{
+	struct bench_result *rp;
+	int mhz = get_cpu_hz () / 1000000;
+	char f[6][16];
+	int i;
+
+	bench_out ( "BENCH BEGIN\n" );
+
+	if ( bench_how & BENCH_JSON )
+	    bench_out ( "{ \"board\": \"%s\", \"profile\": \"%s\", \"mhz\": %d, \"results\": [\n",
+		HYDRA_TARGET, HYDRA_PROFILE, mhz );
+	else
+	    bench_out ( "board,profile,mhz,bench,batch,min,median,p99,min_ns,median_ns,p99_ns,info\n" );
+
+	for ( i=0; i<num_results; i++ ) {
+	    rp = &results[i];
+	    fixed ( f[0], rp->min );
+	    fixed ( f[1], rp->median );
+	    fixed ( f[2], rp->p99 );
+	    fixed ( f[3], to_ns ( rp->min, mhz ) );
+	    fixed ( f[4], to_ns ( rp->median, mhz ) );
+	    fixed ( f[5], to_ns ( rp->p99, mhz ) );
+
+	    if ( bench_how & BENCH_JSON ) {
+		bench_out ( "  { \"bench\": \"%s\", \"batch\": %d, \"cycles\": [ %s, %s, %s ],",
+		    rp->bp->name, rp->batch, f[0], f[1], f[2] );
+		bench_out ( " \"ns\": [ %s, %s, %s ], \"info\": \"%s\" }%s\n",
+		    f[3], f[4], f[5], rp->bp->info, i < num_results - 1 ? "," : "" );
+	    } else {
+		bench_out ( "%s,%s,%d,%s,%d,%s,%s,%s,", HYDRA_TARGET, HYDRA_PROFILE, mhz,
+		    rp->bp->name, rp->batch, f[0], f[1], f[2] );
+		bench_out ( "%s,%s,%s,\"%s\"\n", f[3], f[4], f[5], rp->bp->info );
+	    }
+	}
+
+	if ( bench_how & BENCH_JSON )
+	    bench_out ( "] }\n" );
+
+	bench_out ( "BENCH END\n" );
+}
+
+void
+bench_run ( char *only, int how )
+{
+	struct bench *bp;
+
+	if ( ! bench_ready ) {
+	    bench_init ();
+	    bench_ready = 1;
+	}
+
+	bench_how = how;
+	bench_overhead ();
+	num_results = 0;
+
+#ifdef HYDRA_HOST
+	host_quiet = 1;
+#endif
+	for ( bp = benches; bp < &benches[num_bench]; bp++ ) {
+	    if ( only && ! starts ( bp->name, only ) )
+		continue;
+	    if ( (how & BENCH_USB) && (bp->flags & BENCH_NOUSB) )
+		continue;
+	    bench_one ( bp );
+	}
+#ifdef HYDRA_HOST
+	host_quiet = 0;
+#endif
+
+	bench_report ();
+}
+
+/* THE END */
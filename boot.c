@@ -0,0 +1,137 @@
+/* boot.c
+ * (c) Tom Trebisky  10-19-2026
+ *
+ * The boot timeline, and init work put off until later.
+ *
+ * stm_init() turns on the DWT cycle counter first thing and
+ * calls boot_mark() after each stage, which records the count.
+ * The clock changes partway through (in rcc_init) so we also
+ * keep the clock each stage ran at, which is what was in effect
+ * at the previous mark.  boot_show() prints it all, any time
+ * after boot.  The "startup" mark is when user code gets control.
+ *
+ * Slow things user code doesn't need right away (USB, which has
+ * well over 100 ms of delays in its setup, and banners on the
+ * blocking serial console) go on a list with boot_defer() and
+ * run in order from boot_late().  react_run() calls boot_late()
+ * before it sleeps the first time, user code that doesn't use the
+ * reactor calls it when whatever is urgent is done.  Calling it
+ * again does nothing.  These get marks too.
+ *
+ * The cycle counter wraps after 25 seconds or so, which only
+ * matters if boot_late() waits that long.
+ */
+
+#include "hydra.h"
+
+#define MAX_MARKS	20
+#define MAX_DEFER	8
+
+/* What we run at out of reset (HSI) */
+#ifdef CHIP_F103
+#define RESET_HZ	8000000
+#else
+#define RESET_HZ	16000000
+#endif
+
+struct boot_mark {
+	char *name;
+	unsigned int cycles;
+	int hz;			/* the clock from here on */
+};
+
+static struct boot_mark boot_marks[MAX_MARKS];
+static int num_marks;
+
+static int boot_hz = RESET_HZ;
+
+struct boot_defer {
+	char *name;
+	vfptr fn;
+};
+
+static struct boot_defer defer_list[MAX_DEFER];
+static int num_defer;
+static int late_done;
+
+void
+boot_mark ( char *name )
+{
+	struct boot_mark *mp;
+
+	if ( num_marks >= MAX_MARKS )
+	    return;
+
+	mp = &boot_marks[num_marks++];
+	mp->cycles = get_cycles ();
+	mp->name = name;
+	mp->hz = boot_hz;
+}
+
+/* Call this once rcc_init() has the real clock going */
+void
+boot_clock ( void )
+{
+	boot_hz = get_cpu_hz ();
+}
+
+/* fn gets called from boot_late().
+ * If the list is full, we just call it now.
+ */
+void
+boot_defer ( char *name, vfptr fn )
+{
+	if ( late_done || num_defer >= MAX_DEFER ) {
+	    (*fn) ();
+	    boot_mark ( name );
+	    return;
+	}
+
+	defer_list[num_defer].name = name;
+	defer_list[num_defer].fn = fn;
+	num_defer++;
+}
+
+void
+boot_late ( void )
+{
+	int i;
+
+	if ( late_done )
+	    return;
+	late_done = 1;
+
+	boot_clock ();
+	boot_mark ( "late" );
+
+	for ( i=0; i<num_defer; i++ ) {
+	    (*defer_list[i].fn) ();
+	    boot_mark ( defer_list[i].name );
+	}
+}
+
+/* Each line is the time the stage took and the time
+ * since reset when it was done, in microseconds.
+ */
+void
+boot_show ( void )
+{
+	struct boot_mark *mp;
+	unsigned int last = 0;
+	int hz = RESET_HZ;
+	int total = 0;
+	int us;
+	int i;
+
+	printf ( "Boot timeline (us):\n" );
+	for ( i=0; i<num_marks; i++ ) {
+	    mp = &boot_marks[i];
+	    us = (mp->cycles - last) / (hz / 1000000);
+	    total += us;
+	    printf ( "  %s %d, at %d\n", mp->name, us, total );
+	    last = mp->cycles;
+	    hz = mp->hz;
+	}
+}
+
+/* THE END */
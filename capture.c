@@ -0,0 +1,326 @@
+/* capture.c
+ * (c) Tom Trebisky  10-19-2026
+ *
+ * Timer input capture for the F4 chips.
+ *
+ * We use TIM2 and TIM5 since they are 32 bit.  The timer runs
+ * free at the full timer clock (84 or 96 Mhz), so an edge gets
+ * a timestamp good to about 12 ns, latched by the hardware
+ * when the edge happens, not when some interrupt gets around
+ * to looking.  Each capture triggers a DMA request and DMA moves
+ * the value (see dma.c) into a circular buffer in RAM, so there is no
+ * interrupt at all per edge.  The consumer just reads what is
+ * new in the buffer (see capture_read()) every so often.
+ * The consumer needs to keep up, so the buffer must hold more
+ * edges than arrive between looks.
+ *
+ * A timer used for capture runs free and is not available
+ * for timer_init() (see timer.c).
+ *
+ * This is F4 only (the F103 timers are 16 bit and the DMA
+ * is entirely different).
+ */
+
+#include "hydra.h"
+
+struct timer {
+	volatile unsigned int cr1;	/* 0x00 */
+	volatile unsigned int cr2;	/* 0x04 */
+	volatile unsigned int smcr;	/* 0x08 */
+	volatile unsigned int dier;	/* 0x0c - interrupt and DMA enables */
+	volatile unsigned int sr;	/* 0x10 - status */
+	volatile unsigned int egr;	/* 0x14 - event generation */
+	volatile unsigned int ccmr[2];	/* 0x18, 0x1c */
+	volatile unsigned int ccer;	/* 0x20 */
+	volatile unsigned int cnt;	/* 0x24 */
+	volatile unsigned int psc;	/* 0x28 - prescaler */
+	volatile unsigned int arr;	/* 0x2c - auto reload */
+	    int __pad1;
+	volatile unsigned int ccr[4];	/* 0x34 .. 0x40 */
+};
+
+#define TIM2_BASE	(struct timer *) 0x40000000
+#define TIM5_BASE	(struct timer *) 0x40000c00
+
+#define CR1_CEN		0x0001
+
+/* In the dier, CC1DE is bit 9, and so on */
+#define DIER_CCDE(c)	BIT(8+(c))
+
+/* Each ccmr has two 8 bit fields, for channels 1,2 and 3,4
+ * CCxS (low 2 bits) selects the input:
+ *  1 = the channels own input (TI1 for CH1)
+ *  2 = the neighbor (TI2 for CH1, TI1 for CH2)
+ * The input filter is the top 4 bits.
+ */
+#define CCS_DIRECT	1
+#define CCS_INDIRECT	2
+#define IC_FILTER	(2<<4)	/* N=4 at timer clock */
+
+/* In the ccer, 4 bits for each channel */
+#define CCER_E(c)	BIT(((c)-1)*4)
+#define CCER_P(c)	BIT(((c)-1)*4+1)
+#define CCER_NP(c)	BIT(((c)-1)*4+3)
+
+/* From the DMA1 request table in the RM (RM0090 table 42)
+ * indexed by capture channel 1-4.
+ * TIM2 is on DMA channel 3, TIM5 on DMA channel 6.
+ */
+static const int tim2_streams[] = { 0, 5, 6, 1, 7 };
+static const int tim5_streams[] = { 0, 2, 4, 0, 3 };
+
+#define TIM2_DMA_CHAN	3
+#define TIM5_DMA_CHAN	6
+
+static struct timer *
+cap_base ( int timer )
+{
+	return timer == TIMER5 ? TIM5_BASE : TIM2_BASE;
+}
+
+/* Start the timer running free over the full 32 bits.
+ * Harmless to call again for a second channel.
+ */
+static void
+cap_timer_start ( struct timer *tp )
+{
+	if ( tp->cr1 & CR1_CEN )
+	    return;
+
+	tp->psc = 0;
+	tp->arr = 0xffffffff;
+	tp->egr = 1;
+	tp->cr1 = CR1_CEN;
+}
+
+static void
+cap_chan_setup ( struct timer *tp, int chan, int sel, int edge )
+{
+	int shift = ((chan-1) % 2) * 8;
+	unsigned int val;
+
+	tp->ccer &= ~(CCER_E(chan) | CCER_P(chan) | CCER_NP(chan));
+
+	val = tp->ccmr[(chan-1)/2];
+	val &= ~(0xff << shift);
+	val |= (sel | IC_FILTER) << shift;
+	tp->ccmr[(chan-1)/2] = val;
+
+	/* P alone is falling, P and NP is both */
+	if ( edge == EXTI_FALLING )
+	    tp->ccer |= CCER_P(chan);
+	else if ( edge == EXTI_BOTH )
+	    tp->ccer |= CCER_P(chan) | CCER_NP(chan);
+
+	tp->ccer |= CCER_E(chan);
+}
+
+static int
+cap_start ( struct capture *cp, int timer, int chan, int sel, int edge, unsigned int *buf, int size )
+{
+	struct dma_config conf;
+	struct timer *tp;
+	int ds;
+
+	if ( chan < 1 || chan > 4 )
+	    return 1;
+	if ( timer != TIMER2 && timer != TIMER5 )
+	    return 1;
+
+	tp = cap_base ( timer );
+
+	cp->timer = timer;
+	cp->chan = chan;
+	cp->buf = buf;
+	cp->size = size;
+	cp->rd = 0;
+
+	if ( timer == TIMER5 ) {
+	    ds = DMA_STREAM ( DMA1, tim5_streams[chan] );
+	    conf.chan = TIM5_DMA_CHAN;
+	} else {
+	    ds = DMA_STREAM ( DMA1, tim2_streams[chan] );
+	    conf.chan = TIM2_DMA_CHAN;
+	}
+
+	/* Somebody else may have this stream */
+	if ( dma_alloc ( ds ) < 0 )
+	    return 1;
+	cp->stream = ds;
+
+	conf.dir = DMA_P2M;
+	conf.psize = 4;
+	conf.msize = 4;
+	conf.flags = DMA_MINC | DMA_CIRC;
+	conf.fifo = 0;
+	conf.burst = 1;
+	conf.pburst = 1;
+	conf.pri = 2;
+	conf.par = &tp->ccr[chan-1];
+	conf.m0 = buf;
+	conf.m1 = 0;
+	conf.count = size;
+	conf.half = 0;
+	conf.full = 0;
+	conf.error = 0;
+	conf.arg = 0;
+
+	cap_chan_setup ( tp, chan, sel, edge );
+	if ( dma_setup ( ds, &conf ) ) {
+	    dma_free ( ds );
+	    return 1;
+	}
+	dma_start ( ds );
+	tp->dier |= DIER_CCDE(chan);
+
+	cap_timer_start ( tp );
+	return 0;
+}
+
+/* Set up timer (TIMER2 or TIMER5) channel (1-4) to capture
+ * edges (EXTI_RISING, EXTI_FALLING, or EXTI_BOTH) into buf,
+ * which holds size timestamps.
+ * The pin must be one that the timer channel can use,
+ * for example PA15 or PA5 for TIM2 CH1, PA1 for TIM5 CH2.
+ */
+int
+capture_init ( struct capture *cp, int timer, int chan, int gpio, int pin, int edge, unsigned int *buf, int size )
+{
+	gpio_timer_pin_setup ( gpio, pin, timer == TIMER5 ? 2 : 1 );
+	return cap_start ( cp, timer, chan, CCS_DIRECT, edge, buf, size );
+}
+
+/* To measure duty cycle we need both edges, and need to know
+ * which is which.  So we use two channels looking at the same
+ * pin, one catching rising edges and the other falling edges.
+ * chan must be 1 or 3, the pin goes with it, and chan+1 is
+ * used for the falling edges.
+ */
+int
+capture_init_pwm ( struct capture *rise, struct capture *fall, int timer, int chan, int gpio, int pin,
+	unsigned int *rbuf, unsigned int *fbuf, int size )
+{
+	if ( chan != 1 && chan != 3 )
+	    return 1;
+
+	gpio_timer_pin_setup ( gpio, pin, timer == TIMER5 ? 2 : 1 );
+	if ( cap_start ( rise, timer, chan, CCS_DIRECT, EXTI_RISING, rbuf, size ) )
+	    return 1;
+	return cap_start ( fall, timer, chan+1, CCS_INDIRECT, EXTI_FALLING, fbuf, size );
+}
+
+/* Index of the next slot DMA will write */
+static int
+cap_wr ( struct capture *cp )
+{
+	int wr;
+
+	wr = cp->size - dma_count ( cp->stream );
+	if ( wr >= cp->size )
+	    wr = 0;
+	return wr;
+}
+
+/* How many new timestamps are waiting */
+int
+capture_avail ( struct capture *cp )
+{
+	int n;
+
+	n = cap_wr ( cp ) - cp->rd;
+	if ( n < 0 )
+	    n += cp->size;
+	return n;
+}
+
+/* Copy out up to max new timestamps, returns how many */
+int
+capture_read ( struct capture *cp, unsigned int *stamps, int max )
+{
+	int n;
+	int i;
+
+	n = capture_avail ( cp );
+	if ( n > max )
+	    n = max;
+
+	for ( i=0; i<n; i++ ) {
+	    *stamps++ = cp->buf[cp->rd++];
+	    if ( cp->rd >= cp->size )
+		cp->rd = 0;
+	}
+
+	return n;
+}
+
+/* A recent timestamp ("ago" back from the newest),
+ * without consuming anything.
+ */
+unsigned int
+capture_last ( struct capture *cp, int ago )
+{
+	int i;
+
+	i = cap_wr ( cp ) - 1 - ago;
+	while ( i < 0 )
+	    i += cp->size;
+	return cp->buf[i];
+}
+
+/* Current value of the timer, to compare to timestamps */
+unsigned int
+capture_now ( struct capture *cp )
+{
+	return cap_base ( cp->timer )->cnt;
+}
+
+/* The time between edges, in timer counts, averaged over
+ * the most recent n edges (which must have arrived).
+ * Timer counts are 1/get_timer_hz() seconds.
+ */
+unsigned int
+capture_period ( struct capture *cp, int n )
+{
+	if ( n < 1 )
+	    n = 1;
+	return (capture_last ( cp, 0 ) - capture_last ( cp, n )) / n;
+}
+
+/* Frequency in Hz, averaged over n edges */
+int
+capture_freq ( struct capture *cp, int n )
+{
+	unsigned int period = capture_period ( cp, n );
+
+	if ( ! period )
+	    return 0;
+	return get_timer_hz () / period;
+}
+
+/* Duty cycle in parts per thousand, from a pair set up with
+ * capture_init_pwm()
+ */
+int
+capture_duty ( struct capture *rise, struct capture *fall )
+{
+	unsigned int r0, r1, f;
+	unsigned int period, high;
+
+	r1 = capture_last ( rise, 0 );
+	f = capture_last ( fall, 0 );
+
+	r0 = capture_last ( rise, 1 );
+	period = r1 - r0;
+
+	/* we want the rise that came before the last fall */
+	if ( (int) (f - r1) < 0 )
+	    high = f - r0;
+	else
+	    high = f - r1;
+
+	if ( period < 1000 )
+	    return 0;
+	return high / (period / 1000);
+}
+
+/* THE END */
@@ -0,0 +1,479 @@
+/* dma.c
+ * (c) Tom Trebisky  10-19-2026
+ *
+ * Driver for the two DMA controllers on the F4 chips.
+ * This is section 10 of RM0090 (section 9 of RM0383).
+ *
+ * Each controller has 8 streams, and each stream can serve
+ * one of 8 request "channels".  Which peripheral request is
+ * on which stream/channel is fixed by the hardware and listed
+ * in the RM (tables 42 and 43 in RM0090), so a driver asks for
+ * a particular stream and passes the channel in the config.
+ * Only DMA2 can do memory to memory.
+ *
+ * We name a stream by a single number, DMA_STREAM(dma,stream)
+ * which is 0-7 for DMA1 and 8-15 for DMA2.
+ *
+ * Callbacks for half transfer, transfer complete, and errors
+ * get called at interrupt level with the arg from the config.
+ * In double buffer mode, dma_current() tells which buffer the
+ * hardware is working on, so the other one is ours.
+ *
+ * Remember that DMA cannot get at the CCM ram on the F407/F429,
+ * dma_setup() refuses buffers there (see HYDRA_DMA in hydra.h).
+ * The F103 DMA is an entirely different thing, and this
+ * is not for it.
+ */
+
+#include "hydra.h"
+
+struct dma_stream {
+	volatile unsigned int cr;	/* 0x00 */
+	volatile unsigned int ndtr;	/* 0x04 - items left to move */
+	volatile unsigned int par;	/* 0x08 */
+	volatile unsigned int m0ar;	/* 0x0c */
+	volatile unsigned int m1ar;	/* 0x10 */
+	volatile unsigned int fcr;	/* 0x14 */
+};
+
+struct dma {
+	volatile unsigned int isr[2];	/* 0x00, 0x04 */
+	volatile unsigned int ifcr[2];	/* 0x08, 0x0c */
+	struct dma_stream stream[8];	/* 0x10 ... */
+};
+
+#define DMA1_BASE	(struct dma *) 0x40026000
+#define DMA2_BASE	(struct dma *) 0x40026400
+
+static struct dma *dma_bases[] = { DMA1_BASE, DMA2_BASE };
+
+/* Bits in the stream cr */
+#define CR_EN		BIT(0)
+#define CR_DMEIE	BIT(1)
+#define CR_TEIE		BIT(2)
+#define CR_HTIE		BIT(3)
+#define CR_TCIE		BIT(4)
+#define CR_DIR_SHIFT	6
+#define CR_CIRC		BIT(8)
+#define CR_PINC		BIT(9)
+#define CR_MINC		BIT(10)
+#define CR_PSIZE_SHIFT	11
+#define CR_MSIZE_SHIFT	13
+#define CR_PL_SHIFT	16
+#define CR_DBM		BIT(18)
+#define CR_CT		BIT(19)
+#define CR_PBURST_SHIFT	21
+#define CR_MBURST_SHIFT	23
+#define CR_CHSEL_SHIFT	25
+
+/* Bits in the fcr */
+#define FCR_DMDIS	BIT(2)		/* FIFO on */
+#define FCR_FEIE	BIT(7)
+
+/* The 6 flag bits each stream has in isr and ifcr */
+#define F_FEIF		BIT(0)
+#define F_DMEIF		BIT(2)
+#define F_TEIF		BIT(3)
+#define F_HTIF		BIT(4)
+#define F_TCIF		BIT(5)
+#define F_ALL		(F_FEIF | F_DMEIF | F_TEIF | F_HTIF | F_TCIF)
+#define F_ERRORS	(F_FEIF | F_DMEIF | F_TEIF)
+
+/* Interrupt numbers for DMA1 stream 0-7, then DMA2 stream 0-7 */
+static const unsigned char dma_irqs[NUM_DMA_STREAMS] = {
+    11, 12, 13, 14, 15, 16, 17, 47,
+    56, 57, 58, 59, 60, 68, 69, 70
+};
+
+struct dma_stuff {
+	int busy;
+	afptr half;
+	afptr full;
+	afptr error;
+	void *arg;
+	int errors;
+	int last_error;		/* flag bits from the last error */
+};
+
+static struct dma_stuff dma_info[NUM_DMA_STREAMS] HYDRA_CCM;
+
+static struct dma_stream *
+dma_regs ( int ds )
+{
+	return &dma_bases[ds/8]->stream[ds%8];
+}
+
+/* Streams 0,1 are in the low half of isr[0] and ifcr[0],
+ * 2,3 in the high half, then 4-7 the same way in [1].
+ */
+static int
+flag_shift ( int ds )
+{
+	int s = ds % 8;
+
+	return (s%2) * 6 + ((s%4)/2) * 16;
+}
+
+static unsigned int
+dma_flags ( int ds )
+{
+	return (dma_bases[ds/8]->isr[(ds%8)/4] >> flag_shift ( ds )) & F_ALL;
+}
+
+static void
+dma_clear ( int ds, unsigned int flags )
+{
+	dma_bases[ds/8]->ifcr[(ds%8)/4] = flags << flag_shift ( ds );
+}
+
+static void
+dma_irq ( int ds )
+{
+	struct dma_stuff *dp = &dma_info[ds];
+	unsigned int flags;
+
+	flags = dma_flags ( ds );
+	dma_clear ( ds, flags );
+
+	if ( flags & F_ERRORS ) {
+	    dp->errors++;
+	    dp->last_error = flags & F_ERRORS;
+	    if ( dp->error )
+		(*dp->error) ( dp->arg );
+	}
+
+	if ( (flags & F_HTIF) && dp->half )
+	    (*dp->half) ( dp->arg );
+
+	if ( (flags & F_TCIF) && dp->full )
+	    (*dp->full) ( dp->arg );
+}
+
+/* These are referenced from the table in locore.s
+ */
+void dma1_s0_handler ( void ) { dma_irq ( 0 ); }
+void dma1_s1_handler ( void ) { dma_irq ( 1 ); }
+void dma1_s2_handler ( void ) { dma_irq ( 2 ); }
+void dma1_s3_handler ( void ) { dma_irq ( 3 ); }
+void dma1_s4_handler ( void ) { dma_irq ( 4 ); }
+void dma1_s5_handler ( void ) { dma_irq ( 5 ); }
+void dma1_s6_handler ( void ) { dma_irq ( 6 ); }
+void dma1_s7_handler ( void ) { dma_irq ( 7 ); }
+
+void dma2_s0_handler ( void ) { dma_irq ( 8 ); }
+void dma2_s1_handler ( void ) { dma_irq ( 9 ); }
+void dma2_s2_handler ( void ) { dma_irq ( 10 ); }
+void dma2_s3_handler ( void ) { dma_irq ( 11 ); }
+void dma2_s4_handler ( void ) { dma_irq ( 12 ); }
+void dma2_s5_handler ( void ) { dma_irq ( 13 ); }
+void dma2_s6_handler ( void ) { dma_irq ( 14 ); }
+void dma2_s7_handler ( void ) { dma_irq ( 15 ); }
+
+/* Claim a stream.  Returns ds, or -1 if somebody has it.
+ */
+int
+dma_alloc ( int ds )
+{
+	int rv = -1;
+
+	if ( ds < 0 || ds >= NUM_DMA_STREAMS )
+	    return -1;
+
+	irq_disable ();
+	if ( ! dma_info[ds].busy ) {
+	    dma_info[ds].busy = 1;
+	    rv = ds;
+	}
+	irq_enable ();
+
+	return rv;
+}
+
+/* Any free DMA2 stream, for memory to memory */
+int
+dma_alloc_m2m ( void )
+{
+	int ds;
+
+	for ( ds = DMA_STREAM(DMA2,7); ds >= DMA_STREAM(DMA2,0); ds-- )
+	    if ( dma_alloc ( ds ) >= 0 )
+		return ds;
+	return -1;
+}
+
+void
+dma_free ( int ds )
+{
+	dma_stop ( ds );
+	dma_info[ds].busy = 0;
+}
+
+/* 1, 2, or 4 bytes as the 2 bit size field */
+static int
+size_bits ( int size )
+{
+	if ( size == 4 )
+	    return 2;
+	if ( size == 2 )
+	    return 1;
+	return 0;
+}
+
+/* 1 (single), 4, 8, or 16 beats as the 2 bit burst field */
+static int
+burst_bits ( int burst )
+{
+	if ( burst == 16 )
+	    return 3;
+	if ( burst == 8 )
+	    return 2;
+	if ( burst == 4 )
+	    return 1;
+	return 0;
+}
+
+/* DMA can't get at the CCM on the F407/F429, a transfer
+ * would just end in a transfer error.
+ */
+static int
+in_ccm ( volatile void *addr )
+{
+	unsigned int a = (unsigned int) addr;
+
+	return a >= CCM_BASE && a < CCM_BASE + CCM_SIZE;
+}
+
+/* Set up a stream we have allocated.
+ * The stream is left stopped, call dma_start() to go.
+ * Returns 0, or -1 for a config the hardware won't do.
+ */
+int
+dma_setup ( int ds, struct dma_config *cp )
+{
+	struct dma_stream *sp = dma_regs ( ds );
+	struct dma_stuff *dp = &dma_info[ds];
+	unsigned int cr;
+	unsigned int fcr;
+
+	if ( ! dp->busy )
+	    return -1;
+
+	/* only DMA2 does memory to memory, and it needs the FIFO */
+	if ( cp->dir == DMA_M2M && (ds < DMA_STREAM(DMA2,0) || ! cp->fifo) )
+	    return -1;
+	/* bursts need the FIFO too */
+	if ( (cp->burst > 1 || cp->pburst > 1) && ! cp->fifo )
+	    return -1;
+	if ( cp->count < 1 || cp->count > 65535 )
+	    return -1;
+	/* see HYDRA_DMA in hydra.h */
+	if ( in_ccm ( cp->m0 ) || in_ccm ( cp->m1 ) )
+	    return -1;
+	if ( cp->dir == DMA_M2M && in_ccm ( cp->par ) )
+	    return -1;
+
+	dma_stop ( ds );
+
+	dp->half = cp->half;
+	dp->full = cp->full;
+	dp->error = cp->error;
+	dp->arg = cp->arg;
+
+	cr = cp->chan << CR_CHSEL_SHIFT;
+	cr |= cp->dir << CR_DIR_SHIFT;
+	cr |= size_bits ( cp->psize ) << CR_PSIZE_SHIFT;
+	cr |= size_bits ( cp->msize ) << CR_MSIZE_SHIFT;
+	cr |= (cp->pri & 3) << CR_PL_SHIFT;
+	cr |= burst_bits ( cp->burst ) << CR_MBURST_SHIFT;
+	cr |= burst_bits ( cp->pburst ) << CR_PBURST_SHIFT;
+
+	if ( cp->flags & DMA_PINC )
+	    cr |= CR_PINC;
+	if ( cp->flags & DMA_MINC )
+	    cr |= CR_MINC;
+	if ( cp->flags & DMA_CIRC )
+	    cr |= CR_CIRC;
+	if ( cp->flags & DMA_DOUBLE )
+	    cr |= CR_DBM | CR_CIRC;
+
+	/* We always want to hear about errors */
+	cr |= CR_TEIE | CR_DMEIE;
+	if ( cp->half )
+	    cr |= CR_HTIE;
+	if ( cp->full )
+	    cr |= CR_TCIE;
+
+	fcr = 0;
+	if ( cp->fifo )
+	    fcr = FCR_DMDIS | FCR_FEIE | ((cp->fifo - 1) & 3);
+
+	/* For memory to memory, "peripheral" is the source */
+	sp->par = (unsigned int) cp->par;
+	sp->m0ar = (unsigned int) cp->m0;
+	sp->m1ar = (unsigned int) cp->m1;
+	sp->ndtr = cp->count;
+	sp->fcr = fcr;
+	sp->cr = cr;
+
+	dma_clear ( ds, F_ALL );
+	nvic_enable ( dma_irqs[ds] );
+
+	return 0;
+}
+
+void
+dma_start ( int ds )
+{
+	struct dma_stream *sp = dma_regs ( ds );
+
+	dma_clear ( ds, F_ALL );
+	sp->cr |= CR_EN;
+}
+
+/* The hardware finishes the current beat before EN reads back 0 */
+void
+dma_stop ( int ds )
+{
+	struct dma_stream *sp = dma_regs ( ds );
+
+	sp->cr &= ~CR_EN;
+	while ( sp->cr & CR_EN )
+	    ;
+}
+
+/* Start again with a new count and memory address.
+ * Not for circular or double buffer mode.
+ */
+void
+dma_restart ( int ds, void *mem, int count )
+{
+	struct dma_stream *sp = dma_regs ( ds );
+
+	dma_stop ( ds );
+	sp->m0ar = (unsigned int) mem;
+	sp->ndtr = count;
+	dma_start ( ds );
+}
+
+/* How many items are left to move in this round */
+int
+dma_count ( int ds )
+{
+	return dma_regs ( ds )->ndtr;
+}
+
+/* In double buffer mode, which buffer (0 or 1) the
+ * hardware is using right now.
+ */
+int
+dma_current ( int ds )
+{
+	return (dma_regs ( ds )->cr & CR_CT) ? 1 : 0;
+}
+
+int
+dma_busy ( int ds )
+{
+	return (dma_regs ( ds )->cr & CR_EN) ? 1 : 0;
+}
+
+/* Flags from the last error (DMA_ERR_xxx in hydra.h),
+ * and how many we have seen.
+ */
+int
+dma_error ( int ds )
+{
+	return dma_info[ds].last_error;
+}
+
+int
+dma_error_count ( int ds )
+{
+	return dma_info[ds].errors;
+}
+
+/* ------------------------------------------------------ */
+
+/* Blocking memory to memory copy on a free DMA2 stream.
+ * Words and 4 beat bursts if everything is aligned,
+ * bytes otherwise.  Returns 0 if all went well.
+ * We poll, so the stream's interrupts stay off and we
+ * read the error flags ourselves once EN clears.  Leaving
+ * that to dma_irq() would race with it clearing them.
+ */
+int
+dma_memcpy ( void *dst, void *src, int len )
+{
+	struct dma_config conf;
+	int ds;
+	int size;
+	int n;
+	unsigned int err;
+	int rv = 0;
+
+	if ( len < 1 )
+	    return 0;
+
+	ds = dma_alloc_m2m ();
+	if ( ds < 0 )
+	    return -1;
+
+	size = 1;
+	if ( (((unsigned int) dst | (unsigned int) src | len) & 3) == 0 )
+	    size = 4;
+
+	conf.chan = 0;
+	conf.dir = DMA_M2M;
+	conf.psize = size;
+	conf.msize = size;
+	conf.flags = DMA_PINC | DMA_MINC;
+	conf.fifo = DMA_FIFO_FULL;
+	conf.burst = size == 4 ? 4 : 1;
+	conf.pburst = conf.burst;
+	conf.pri = 3;
+	conf.m1 = 0;
+	conf.half = 0;
+	conf.full = 0;
+	conf.error = 0;
+	conf.arg = 0;
+
+	while ( len > 0 ) {
+	    n = len / size;
+	    if ( n > 65535 )
+		n = 65535 & ~3;
+
+	    conf.par = src;
+	    conf.m0 = dst;
+	    conf.count = n;
+	    if ( dma_setup ( ds, &conf ) ) {
+		rv = -1;
+		break;
+	    }
+	    dma_regs ( ds )->cr &= ~(CR_TEIE | CR_DMEIE);
+	    dma_regs ( ds )->fcr &= ~FCR_FEIE;
+
+	    /* The hardware clears EN when it is done, or on an error */
+	    dma_start ( ds );
+	    while ( dma_busy ( ds ) )
+		;
+
+	    err = dma_flags ( ds ) & F_ERRORS;
+	    dma_clear ( ds, F_ALL );
+	    if ( err ) {
+		dma_info[ds].errors++;
+		dma_info[ds].last_error = err;
+		rv = -1;
+		break;
+	    }
+
+	    n *= size;
+	    src = (char *) src + n;
+	    dst = (char *) dst + n;
+	    len -= n;
+	}
+
+	dma_free ( ds );
+	return rv;
+}
+
+/* THE END */
@@ -20,7 +20,8 @@ extern char __end;
 extern char __bss_end;
 extern char __data_end;
 
-static unsigned int ram_next;
+/* unsigned long so it holds a pointer on Linux too */
+static unsigned long ram_next;
 
 void *
 ram_alloc ( int size )
@@ -29,7 +30,7 @@ ram_alloc ( int size )
 
 	rv = (void *) ram_next;
 	ram_next += size;
-	ram_next &= 0xfffffffc;
+	ram_next &= ~3UL;
 
 	return rv;
 }
@@ -52,8 +53,12 @@ ram_init ( void )
 	printf ( "SP: %X\n", get_sp() );
 #endif
 
-	ram_next = (unsigned int) &__end;
-	ram_next &= 0xfffffffc;
+#ifdef HYDRA_HOST
+	ram_next = (unsigned long) host_ram ();
+#else
+	ram_next = (unsigned long) &__end;
+#endif
+	ram_next &= ~3UL;
 
 #ifdef notdef
 	printf ( "ram next: %X\n", ram_next );
@@ -115,6 +120,7 @@ event_alloc ( void )
 	    // printf ( "Ealloc 2: %X\n", ep );
 	}
 	ep->id = event_id++;
+	return ep;
 }
 
 static void
@@ -140,10 +146,11 @@ remove_event ( struct event *ep )
                 event_head->delay += ep->delay;
         } else {
             for ( lp = event_head; lp; lp = lp->next )
-                if ( lp == ep ) {
-                    lp = ep->next;
-                    if ( lp )
-                        lp->delay += ep->delay;
+                if ( lp->next == ep ) {
+                    lp->next = ep->next;
+                    if ( ep->next )
+                        ep->next->delay += ep->delay;
+                    break;
                 }
         }
 
@@ -155,8 +162,9 @@ remove_event ( struct event *ep )
  * (i.e. from systick at 1000 Hz)
  * *** Runs at interrupt level.
  * Handles events and repeats.
+ * This runs from ram, see HYDRA_RAMFUNC in hydra.h
  */
-void
+void HYDRA_RAMFUNC
 event_tick ( void )
 {
         struct event *ep;
@@ -361,7 +369,11 @@ idle ( void )
 	    asm volatile( "wfe" );
 	    irq_enable ();
 	    */
+#ifdef __arm__
 	    asm volatile( "wfi" );
+#else
+	    host_wfi ();
+#endif
 	}
 }
 
@@ -378,7 +390,11 @@ sleep ( void )
 	asm volatile( "wfe" );
 	irq_enable ();
 	*/
+#ifdef __arm__
 	asm volatile( "wfi" );
+#else
+	host_wfi ();
+#endif
 }
 
 /* Using idle() is far better, yet this has its uses in
@@ -549,11 +565,15 @@ delay_calibrate ( void )
 #define DELAY_US_400K	56
 #endif
 
-/* XXX - when we get the F429 running at 168 Mhz or something
- * other than 96, we will need to add another entry here,
- * or perhaps ask the RCC module what the actual CPU clock
- * is and adjust the delay accordingly.
+/* 10-2026 - The numbers above are now just where we start.
+ * delay_init() times the loop with the cycle counter and
+ * works out new ones, and does it again whenever the CPU
+ * clock changes (rcc_set_sysclk).  The loop does not take
+ * the same number of cycles at every clock, since the flash
+ * wait states change.
  */
+static int delay_us_mult = DELAY_US_MULT;
+static int delay_us_400k = DELAY_US_400K;
 
 /* From libmaple.
  * Having the core loop in assembly makes this stay the
@@ -563,18 +583,22 @@ delay_calibrate ( void )
 void
 delay_us ( int us )
 {
-    us *= DELAY_US_MULT;
+    us *= delay_us_mult;
     us /= 10;
 
     /* fudge for function call overhead  */
     us--;
 
+#ifdef __arm__
     asm volatile("   mov r0, %[us]          \n\t"
                  "1: subs r0, #1            \n\t"
                  "   bhi 1b                 \n\t"
                  :
                  : [us] "r" (us)
                  : "r0");
+#else
+    loop_delay ( us );
+#endif
 }
 
 /* I checked this for the F429 (while running at 96 Mhz)
@@ -587,20 +611,115 @@ delay_ms ( int ms )
 		delay_us ( 1000 );
 }
 
+/* The delay loop above takes about 3.2 cycles per pass on the
+ * F411 at 96 Mhz (30.2 passes per us), and the F429 number was
+ * scaled from that.  The F103 (with flash wait states and no
+ * ART cache) needs about 6.9 (10.5 passes per us at 72 Mhz).
+ * These let us work out counts for any CPU clock.
+ */
+#ifdef CHIP_F103
+#define DELAY_LOOP_CYCLES_X100	686
+#else
+#define DELAY_LOOP_CYCLES_X100	318
+#endif
+
+static int delay_loop_x100 = DELAY_LOOP_CYCLES_X100;
+
+/* Convert nanoseconds to a count for delay_count().
+ * Good for delays up to a few ms, which is all we want.
+ */
+int
+delay_ns_count ( int ns )
+{
+    int mhz = get_cpu_hz () / 1000000;
+    int count;
+
+    count = (ns * mhz) / (10 * delay_loop_x100);
+    if ( count < 1 )
+	count = 1;
+    return count;
+}
+
+/* Spin for a count obtained from delay_ns_count()
+ * The i2c driver uses this so that each bus can have
+ * its own speed.
+ */
+void
+delay_count ( int count )
+{
+#ifdef __arm__
+    asm volatile("   mov r0, %[count]          \n\t"
+                 "1: subs r0, #1            \n\t"
+                 "   bhi 1b                 \n\t"
+                 :
+                 : [count] "r" (count)
+                 : "r0");
+#else
+    loop_delay ( count );
+#endif
+}
+
 /* This generates the delay for i2c at 400K, which would
  * be a 1.25 us delay
  */
 void
 delay_400k ( void )
 {
-    int count = DELAY_US_400K;
+    int count = delay_us_400k;
 
+#ifdef __arm__
     asm volatile("   mov r0, %[count]          \n\t"
                  "1: subs r0, #1            \n\t"
                  "   bhi 1b                 \n\t"
                  :
                  : [count] "r" (count)
                  : "r0");
+#else
+    loop_delay ( count );
+#endif
+}
+
+/* Time the delay loop with the cycle counter and work out
+ * the numbers above for the clock we have now.
+ * The 400K count was set with a scope, so we just scale it.
+ */
+#define DELAY_CAL_LOOPS	10000
+
+void
+delay_recalibrate ( void )
+{
+    unsigned int t;
+    int mhz = get_cpu_hz () / 1000000;
+
+    irq_disable ();
+    t = get_cycles ();
+    delay_count ( DELAY_CAL_LOOPS );
+    t = get_cycles () - t;
+    irq_enable ();
+
+    delay_loop_x100 = t / (DELAY_CAL_LOOPS / 100);
+    if ( delay_loop_x100 < 100 )
+	delay_loop_x100 = DELAY_LOOP_CYCLES_X100;
+
+    delay_us_mult = mhz * 1000 / delay_loop_x100;
+    delay_us_400k = DELAY_US_400K * delay_us_mult / DELAY_US_MULT;
+    if ( delay_us_400k < 1 )
+	delay_us_400k = 1;
+}
+
+static void
+delay_clock ( int what )
+{
+    if ( what == RCC_CHANGED )
+	delay_recalibrate ();
+}
+
+/* Needs the cycle counter, so after systick_init() */
+void
+delay_init ( void )
+{
+    delay_recalibrate ();
+    rcc_notify ( delay_clock );
 }
 
 /* THE END */
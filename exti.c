@@ -3,11 +3,15 @@
  *
  * Driver for the STM32F411 exti business
  *
+ * 10-2026 - generalized to all 16 gpio lines, each with its
+ *  own handler, a choice of edges, and a cycle count timestamp
+ *  for every event.  Also works for the F103 now.
  */
 
 #include "hydra.h"
 
 /* Here is the EXTI controller stuff for the F411
+ * The F103 uses the same IRQ numbers.
  */
 
 #define IRQ_EXTI0	6
@@ -15,16 +19,19 @@
 #define IRQ_EXTI2	8
 #define IRQ_EXTI3	9
 #define IRQ_EXTI4	10
-
-/* XXX there are a bunch more, see the RM chapter 10 */
+#define IRQ_EXTI9_5	23
+#define IRQ_EXTI15_10	40
 
 /* Each EXTI "line" is driven by the corresponding pin of the GPIO.
  * In other words PA0, PB0, PC0, ... drive EXTI0
  * with 16 pins per GPIO, this means we need EXTI0 .. EXTI15
+ * Only one gpio at a time can drive a given line.
  *
  * Also 16, 17, 18, 21, 22 have special uses.
  */
 
+#define NUM_LINES	16
+
 struct exti {
 	volatile unsigned int imask;	/* 0x00 */
 	volatile unsigned int mask;	/* 0x04 */
@@ -34,14 +41,24 @@ struct exti {
 	volatile unsigned int pending;	/* 0x14 */
 };
 
-#define EXTI_BASE	(struct exti *) 0x40013c00
-
 /* The RM also mentions configuring the SYSCFG_EXTICR1 register.
  * for events from GPIO A0 and B0,
  * and corresponding SYSCFG registers for other pins.
  * This is in section 7 of the RM.
+ *
+ * On the F103 the same 4 registers are in the AFIO block.
  */
 
+#ifdef CHIP_F103
+struct syscfg {
+	volatile unsigned int evcr;	/* 0x00 */
+	volatile unsigned int mapr;	/* 0x04 */
+	volatile unsigned int exti_conf[4];	/* 0x08 .. 0x14*/
+};
+
+#define EXTI_BASE	(struct exti *) 0x40010400
+#define SYSCFG_BASE	(struct syscfg *) 0x40010000
+#else
 struct syscfg {
 	volatile unsigned int memremap;	/* 0x00 */
 	volatile unsigned int pmc;	/* 0x04 */
@@ -50,91 +67,270 @@ struct syscfg {
 	volatile unsigned int cmpcr;	/* 0x20 */
 };
 
+#define EXTI_BASE	(struct exti *) 0x40013c00
 #define SYSCFG_BASE	(struct syscfg *) 0x40013800
+#endif
 
 /* The conf registers each have 4 fields of 4 bits.
- * conf[0] handles pins 0-3 and routes
- * them to exti lines 0-3
+ * conf[0] handles lines 0-3 and so on.
+ * Each field says which gpio (0 = A, 1 = B, ...)
+ * drives that line.
+ * This used to write ~(p_val<<l_shift), which
+ * set every other field in the register to 0xf.
  */
 static void
-exti_sysconfig ( int gpio, int pin, int line )
+exti_sysconfig ( int gpio, int line )
 {
 	struct syscfg *sp = SYSCFG_BASE;
 	int l_index;
 	int l_shift;
-	int p_index;
-	int p_val;
+	unsigned int conf;
 
 	l_index = line/4;
 	l_shift = (line%4) * 4;
 
-	p_index = pin/4;
-	p_val = pin & 3;
+	conf = sp->exti_conf[l_index];
+	conf &= ~(0xf<<l_shift);
+	conf |= gpio<<l_shift;
+	sp->exti_conf[l_index] = conf;
+}
 
-	if ( p_index != l_index )
-	    return;
+struct exti_line {
+	vfptr hook;
+	int post;		/* reactor source + 1, see react.c */
+	unsigned int stamp;	/* cycle count at last event */
+	unsigned int interval;	/* cycles between last two events */
+	int count;
+};
+
+static struct exti_line exti_info[NUM_LINES] HYDRA_CCM;
+
+static void
+exti_line_irq ( int line )
+{
+	struct exti_line *lp = &exti_info[line];
+	unsigned int now;
+
+	now = get_cycles ();
+	lp->interval = now - lp->stamp;
+	lp->stamp = now;
+	lp->count++;
 
-	sp->exti_conf[l_index] &= ~(0xf<<l_shift);
-	sp->exti_conf[l_index] |= ~(p_val<<l_shift);
+	if ( lp->hook )
+	    (*lp->hook) ();
+	if ( lp->post )
+	    react_post ( lp->post - 1 );
 }
 
-static vfptr exti_hook;
-static int exti_mask;
+/* Write 1 to clear, we must not touch other pending bits,
+ * so no |= here.
+ */
+static void
+exti_ack ( int line )
+{
+	struct exti *ep = EXTI_BASE;
+
+	ep->pending = BIT(line);
+}
 
-/* This is referenced from the table in locore.s
+/* Handle whatever lines in first .. last are pending */
+static void
+exti_scan ( int first, int last )
+{
+	struct exti *ep = EXTI_BASE;
+	unsigned int pend;
+	int line;
+
+	pend = ep->pending & ep->imask;
+
+	for ( line = first; line <= last; line++ ) {
+	    if ( pend & BIT(line) ) {
+		exti_ack ( line );
+		exti_line_irq ( line );
+	    }
+	}
+}
+
+/* These are referenced from the table in locore.s
  */
 void
 exti0_handler ( void )
 {
-	struct exti *ep = EXTI_BASE;
+	exti_ack ( 0 );
+	exti_line_irq ( 0 );
+}
 
-	ep->pending |= exti_mask;
+void exti1_handler ( void ) { exti_ack ( 1 ); exti_line_irq ( 1 ); }
+void exti2_handler ( void ) { exti_ack ( 2 ); exti_line_irq ( 2 ); }
+void exti3_handler ( void ) { exti_ack ( 3 ); exti_line_irq ( 3 ); }
+void exti4_handler ( void ) { exti_ack ( 4 ); exti_line_irq ( 4 ); }
 
-	// printf ( "EXTI !\n" );
-        if ( exti_hook )
-            (*exti_hook) ();
-}
+/* These two vectors are shared by several lines */
+void exti9_5_handler ( void ) { exti_scan ( 5, 9 ); }
+void exti15_10_handler ( void ) { exti_scan ( 10, 15 ); }
 
-#define EXTI0	0
-#define EXTI1	1
-#define EXTI2	2
-#define EXTI3	3
+static int
+exti_irq ( int line )
+{
+	if ( line < 5 )
+	    return IRQ_EXTI0 + line;
+	if ( line < 10 )
+	    return IRQ_EXTI9_5;
+	return IRQ_EXTI15_10;
+}
 
-/* Hackish first cut, suitable for A0.
- * will take a little work to generalize,
- *  but we wanted to be sure we were thinking
- *  straight first.
- * We should pick the "line" based on gpio and pin,
- *  and perhaps it isn't possible to accomodate all
- *  possible gpio inputs?  So if we get saturated we
- *  may need to reject requests.
- */
 /* Nothing special needs to be done for the GPIO
  * other than setting it up as an input.
- * Next set the sysconfig muxes to route the
- *  gpio signal to one of 4 exti lines that
- *  are available to it.
+ * Next set the sysconfig mux to route the gpio signal
+ * to the exti line with the same number as the pin.
  * Last, set up the exti business for that line.
+ * A second call for the same pin number (on any gpio)
+ * takes the line over.
+ *
+ * edge is EXTI_RISING, EXTI_FALLING, or EXTI_BOTH
  */
 void
-exti_setup ( int gpio, int pin, vfptr fn )
+exti_setup_edge ( int gpio, int pin, int edge, vfptr fn )
 {
 	struct exti *ep = EXTI_BASE;
-	int line = EXTI0;
+	int line = pin;
+
+	if ( line < 0 || line >= NUM_LINES )
+	    return;
 
 	gpio_input_config ( gpio, pin );
 
-	exti_sysconfig ( gpio, pin, line );
+	irq_disable ();
+
+	ep->imask &= ~BIT(line);
+
+	exti_sysconfig ( gpio, line );
+
+	if ( edge & EXTI_RISING )
+	    ep->rtrigger |= BIT(line);
+	else
+	    ep->rtrigger &= ~BIT(line);
+
+	if ( edge & EXTI_FALLING )
+	    ep->ftrigger |= BIT(line);
+	else
+	    ep->ftrigger &= ~BIT(line);
+
+	exti_info[line].hook = fn;
+	exti_info[line].post = 0;
+	exti_info[line].count = 0;
+	exti_info[line].stamp = get_cycles ();
+	exti_info[line].interval = 0;
+
+	exti_ack ( line );
+	ep->imask |= BIT(line);
+
+	irq_enable ();
+
+	nvic_enable ( exti_irq ( line ) );
+}
+
+/* The original call, falling edge (a button to ground) */
+void
+exti_setup ( int gpio, int pin, vfptr fn )
+{
+	exti_setup_edge ( gpio, pin, EXTI_FALLING, fn );
+}
+
+/* Stop interrupts from a line */
+void
+exti_release ( int line )
+{
+	struct exti *ep = EXTI_BASE;
+
+	ep->imask &= ~BIT(line);
+	ep->rtrigger &= ~BIT(line);
+	ep->ftrigger &= ~BIT(line);
+	exti_info[line].hook = (vfptr) 0;
+	exti_info[line].post = 0;
+}
+
+/* Have a line (already set up) post a reactor source
+ * (see react.c) on every event.
+ */
+void
+exti_post ( int line, int id )
+{
+	exti_info[line].post = id + 1;
+}
+
+/* Fire a line from software, handy for testing
+ * and for measuring interrupt latency.
+ */
+void
+exti_trigger ( int line )
+{
+	struct exti *ep = EXTI_BASE;
+
+	ep->soft = BIT(line);
+}
+
+/* These let a handler (or anybody else) find out when
+ * the last event happened, as a DWT cycle count.
+ */
+unsigned int
+exti_stamp ( int line )
+{
+	return exti_info[line].stamp;
+}
+
+unsigned int
+exti_interval ( int line )
+{
+	return exti_info[line].interval;
+}
+
+int
+exti_count ( int line )
+{
+	return exti_info[line].count;
+}
+
+/* Measure the time from a software trigger to the handler
+ * (we see it as the timestamp taken in exti_line_irq).
+ * Uses line 1 on whatever pin PA1 is doing.
+ */
+#define LAT_LINE	1
+#define LAT_TRIES	100
+
+static volatile int lat_done;
+
+static void
+lat_fn ( void )
+{
+	lat_done = 1;
+}
+
+void
+exti_latency_test ( void )
+{
+	unsigned int t0;
+	unsigned int lat;
+	unsigned int min = 0xffffffff;
+	unsigned int max = 0;
+	int i;
+
+	exti_setup_edge ( GPIOA, LAT_LINE, EXTI_RISING, lat_fn );
 
-	ep->ftrigger = 1<<line;
-	ep->rtrigger = ~(1<<line);
-	ep->mask = 1<<line;
-	ep->imask = 1<<line;
-	exti_mask = 1<<line;
+	for ( i=0; i<LAT_TRIES; i++ ) {
+	    lat_done = 0;
+	    t0 = get_cycles ();
+	    exti_trigger ( LAT_LINE );
+	    while ( ! lat_done )
+		;
+	    lat = exti_stamp ( LAT_LINE ) - t0;
+	    if ( lat < min ) min = lat;
+	    if ( lat > max ) max = lat;
+	}
 
-	exti_hook = fn;
-	nvic_enable ( IRQ_EXTI0 );
+	exti_release ( LAT_LINE );
 
+	printf ( "EXTI trigger to handler: %d to %d cycles\n", min, max );
 }
 
 /* THE END */
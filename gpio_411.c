@@ -306,6 +306,17 @@ gpio_uart_init ( int uart )
 	}
 }
 
+/* Timer input (capture) pins.
+ * TIM2 is AF1, TIM5 is AF2
+ */
+void
+gpio_timer_pin_setup ( int gpio, int pin, int alt )
+{
+	    gpio_af ( gpio, pin, alt );
+	    gpio_mode ( gpio, pin, MODE_AF );
+	    gpio_pupd ( gpio, pin, PUPD_NONE );
+}
+
 void
 gpio_mco_pin_setup ( int gpio, int pin )
 {
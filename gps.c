@@ -0,0 +1,108 @@
+/* gps.c
+ * (c) Tom Trebisky  10-19-2026
+ *
+ * The GPS receiver on UART2.
+ *
+ * The uart interrupt just drops each byte into a ring (ring.c).
+ * Every GPS_POLL_MS a repeat (see event.c) hands whatever
+ * is new to the parser in gps_parse.c, straight out of the
+ * ring.  If the new bytes wrap around the end of the ring
+ * that is two spans, otherwise one.
+ *
+ * Anybody interested in GPS messages calls gps_listen()
+ * and gets every decoded message (at interrupt level).
+ */
+
+#include "hydra.h"
+
+#define GPS_UART	UART2
+#define GPS_BAUD	9600
+
+#define GPS_POLL_MS	10
+
+/* Must be a power of 2.
+ * At 9600 baud we get 10 bytes or so per poll.
+ */
+#define GPS_RING	256
+
+#define MAX_LISTEN	4
+
+static unsigned char gps_buf[GPS_RING] HYDRA_CCM;
+static struct ring gps_ring = RING_INIT ( gps_buf );
+static int ring_overruns;
+
+static struct gps_parser gps_parser HYDRA_CCM;
+
+static void (*gps_listeners[MAX_LISTEN]) ( int, void * );
+static int num_listen;
+
+static int gps_running;
+
+/* uart interrupt, one byte */
+static void
+gps_rx ( int c )
+{
+	if ( ring_put ( &gps_ring, c ) )
+	    ring_overruns++;
+}
+
+static void
+gps_dispatch ( int type, void *msg )
+{
+	int i;
+
+	for ( i=0; i<num_listen; i++ )
+	    (*gps_listeners[i]) ( type, msg );
+}
+
+/* Runs at interrupt level every GPS_POLL_MS */
+static void
+gps_poll ( void )
+{
+	unsigned char *p;
+	int n;
+
+	for ( ;; ) {
+	    p = ring_peek ( &gps_ring, &n );
+	    if ( n == 0 )
+		break;
+	    gps_parse ( &gps_parser, p, n );
+	    ring_consume ( &gps_ring, n );
+	}
+}
+
+/* fn gets called with the message type (GPS_GGA and so on,
+ * see hydra.h) and a pointer to the decoded message, which
+ * is only good until fn returns.
+ */
+void
+gps_listen ( void (*fn) ( int, void * ) )
+{
+	if ( num_listen < MAX_LISTEN )
+	    gps_listeners[num_listen++] = fn;
+}
+
+/* Harmless to call more than once */
+void
+gps_init ( void )
+{
+	if ( gps_running )
+	    return;
+	gps_running = 1;
+
+	gps_parse_init ( &gps_parser, gps_dispatch );
+
+	serial_begin_gps ( GPS_UART, GPS_BAUD );
+	serial_read_hookup ( GPS_UART, gps_rx );
+
+	repeat ( GPS_POLL_MS, gps_poll );
+}
+
+void
+gps_show ( void )
+{
+	printf ( "GPS: %d good, %d bad, %d other, %d overruns\n",
+	    gps_parser.good, gps_parser.bad, gps_parser.other, ring_overruns );
+}
+
+/* THE END */
@@ -0,0 +1,516 @@
+/* gps_parse.c
+ * (c) Tom Trebisky  10-19-2026
+ *
+ * Streaming parser for what comes out of the GPS on UART2,
+ * NMEA sentences and u-blox UBX binary frames mixed together.
+ *
+ * We are handed whatever bytes are available (a span straight
+ * out of the receive ring in gps.c) and carry the parse state
+ * from one call to the next.  Nothing is ever copied into a
+ * line buffer: NMEA fields are converted to numbers digit by
+ * digit as they go by and the checksum is kept up to date as
+ * we go.  When a sentence or frame checks out, the decoded
+ * struct (see hydra.h) is handed to the callback.
+ *
+ * NMEA sentences we decode: GGA, RMC, ZDA (from any talker).
+ * UBX frames we decode: NAV-PVT and NAV-TIMEUTC.  Other UBX
+ * frames are passed along raw.  Other NMEA are just counted.
+ *
+ * Positions are in units of 1e-7 degree (same as UBX),
+ * times of day in ms.
+ *
+ * This has no hardware dependencies, so Tools/gps_bench.c
+ * can run it on the host against recorded logs.
+ */
+
+#include "hydra.h"
+
+/* parser states */
+#define PS_IDLE		0
+#define PS_BODY		1	/* between $ and * */
+#define PS_CK1		2
+#define PS_CK2		3
+#define PS_SYNC2	4	/* got 0xB5 */
+#define PS_CLS		5
+#define PS_ID		6
+#define PS_LEN1		7
+#define PS_LEN2		8
+#define PS_PAYLOAD	9
+#define PS_CKA		10
+#define PS_CKB		11
+
+#define UBX_SYNC1	0xb5
+#define UBX_SYNC2	0x62
+
+/* NMEA says 82 including $ and CR LF */
+#define NMEA_MAX	82
+
+/* Sentence names, the last 3 characters packed */
+#define ID(a,b,c)	(((a)<<16) | ((b)<<8) | (c))
+#define ID_GGA		ID('G','G','A')
+#define ID_RMC		ID('R','M','C')
+#define ID_ZDA		ID('Z','D','A')
+
+/* Most digits we keep in a field */
+#define MAX_DIGITS	9
+
+void
+gps_parse_init ( struct gps_parser *pp, void (*fn) ( int, void * ) )
+{
+	pp->state = PS_IDLE;
+	pp->fn = fn;
+	pp->good = 0;
+	pp->bad = 0;
+	pp->other = 0;
+}
+
+/* ------------------------------------------------------ */
+/* NMEA */
+
+static void
+field_reset ( struct gps_parser *pp )
+{
+	pp->num = 0;
+	pp->ndig = 0;
+	pp->frac = 0;
+	pp->dot = 0;
+	pp->neg = 0;
+	pp->ch = 0;
+}
+
+/* Rescale a field to "want" digits after the point */
+static int
+field_scaled ( struct gps_parser *pp, int want )
+{
+	int v = pp->num;
+	int f = pp->frac;
+
+	while ( f < want ) {
+	    v *= 10;
+	    f++;
+	}
+	while ( f > want ) {
+	    v /= 10;
+	    f--;
+	}
+	return pp->neg ? -v : v;
+}
+
+/* hhmmss.sss to ms into the day */
+static int
+field_time ( struct gps_parser *pp )
+{
+	int v = field_scaled ( pp, 3 );
+
+	return (v / 10000000) * 3600000 + ((v / 100000) % 100) * 60000 + v % 100000;
+}
+
+/* ddmm.mmmmm (or dddmm.mmmmm) to 1e-7 degrees */
+static int
+field_latlon ( struct gps_parser *pp )
+{
+	int v = field_scaled ( pp, 5 );
+
+	return (v / 10000000) * 10000000 + (v % 10000000) * 100 / 60;
+}
+
+/* Clear what we are about to fill in, empty fields stay 0 */
+static void
+nmea_start ( struct gps_parser *pp )
+{
+	struct gps_gga *gp = &pp->msg.gga;
+	struct gps_rmc *rp = &pp->msg.rmc;
+	struct gps_zda *zp = &pp->msg.zda;
+
+	if ( pp->id == ID_GGA ) {
+	    gp->tod = gp->lat = gp->lon = 0;
+	    gp->quality = gp->nsat = gp->hdop = gp->alt = 0;
+	} else if ( pp->id == ID_RMC ) {
+	    rp->tod = rp->status = rp->lat = rp->lon = 0;
+	    rp->speed = rp->course = 0;
+	    rp->day = rp->mon = rp->year = 0;
+	} else if ( pp->id == ID_ZDA ) {
+	    zp->tod = zp->day = zp->mon = zp->year = 0;
+	}
+}
+
+/* A field just ended, put it where it goes */
+static void
+nmea_field ( struct gps_parser *pp )
+{
+	struct gps_gga *gp = &pp->msg.gga;
+	struct gps_rmc *rp = &pp->msg.rmc;
+	struct gps_zda *zp = &pp->msg.zda;
+	int v;
+
+	if ( pp->field == 0 ) {
+	    nmea_start ( pp );
+	    return;
+	}
+
+	if ( pp->ndig == 0 && pp->ch == 0 )
+	    return;
+
+	switch ( pp->id ) {
+	case ID_GGA:
+	    switch ( pp->field ) {
+	    case 1: gp->tod = field_time ( pp ); break;
+	    case 2: gp->lat = field_latlon ( pp ); break;
+	    case 3: if ( pp->ch == 'S' ) gp->lat = -gp->lat; break;
+	    case 4: gp->lon = field_latlon ( pp ); break;
+	    case 5: if ( pp->ch == 'W' ) gp->lon = -gp->lon; break;
+	    case 6: gp->quality = pp->num; break;
+	    case 7: gp->nsat = pp->num; break;
+	    case 8: gp->hdop = field_scaled ( pp, 2 ); break;
+	    case 9: gp->alt = field_scaled ( pp, 3 ); break;
+	    }
+	    break;
+	case ID_RMC:
+	    switch ( pp->field ) {
+	    case 1: rp->tod = field_time ( pp ); break;
+	    case 2: rp->status = pp->ch; break;
+	    case 3: rp->lat = field_latlon ( pp ); break;
+	    case 4: if ( pp->ch == 'S' ) rp->lat = -rp->lat; break;
+	    case 5: rp->lon = field_latlon ( pp ); break;
+	    case 6: if ( pp->ch == 'W' ) rp->lon = -rp->lon; break;
+	    case 7: rp->speed = field_scaled ( pp, 3 ); break;
+	    case 8: rp->course = field_scaled ( pp, 2 ); break;
+	    case 9:
+		v = pp->num;
+		rp->day = v / 10000;
+		rp->mon = (v / 100) % 100;
+		rp->year = 2000 + v % 100;
+		break;
+	    }
+	    break;
+	case ID_ZDA:
+	    switch ( pp->field ) {
+	    case 1: zp->tod = field_time ( pp ); break;
+	    case 2: zp->day = pp->num; break;
+	    case 3: zp->mon = pp->num; break;
+	    case 4: zp->year = pp->num; break;
+	    }
+	    break;
+	}
+}
+
+static void
+nmea_done ( struct gps_parser *pp )
+{
+	if ( pp->ck != pp->sum ) {
+	    pp->bad++;
+	    return;
+	}
+
+	switch ( pp->id ) {
+	case ID_GGA:
+	    pp->good++;
+	    (*pp->fn) ( GPS_GGA, &pp->msg.gga );
+	    break;
+	case ID_RMC:
+	    pp->good++;
+	    (*pp->fn) ( GPS_RMC, &pp->msg.rmc );
+	    break;
+	case ID_ZDA:
+	    pp->good++;
+	    (*pp->fn) ( GPS_ZDA, &pp->msg.zda );
+	    break;
+	default:
+	    pp->other++;
+	    break;
+	}
+}
+
+static int
+hexval ( int c )
+{
+	if ( c >= '0' && c <= '9' )
+	    return c - '0';
+	if ( c >= 'A' && c <= 'F' )
+	    return c - 'A' + 10;
+	return -1;
+}
+
+/* Run through the body of a sentence, as far as this span goes.
+ * This is where nearly all the bytes go, so it gets a loop
+ * of its own rather than going around the big switch.
+ * Returns how many bytes we used.
+ */
+static int
+nmea_body ( struct gps_parser *pp, const unsigned char *buf, int len )
+{
+	const unsigned char *p = buf;
+	const unsigned char *end = buf + len;
+	int c;
+
+	while ( p < end ) {
+	    c = *p++;
+
+	    if ( c >= '0' && c <= '9' ) {
+		pp->sum ^= c;
+		if ( pp->ndig < MAX_DIGITS ) {
+		    pp->num = pp->num * 10 + c - '0';
+		    pp->ndig++;
+		    pp->frac += pp->dot;
+		}
+		continue;
+	    }
+
+	    if ( c == ',' ) {
+		pp->sum ^= c;
+		nmea_field ( pp );
+		pp->field++;
+		field_reset ( pp );
+		continue;
+	    }
+
+	    if ( c == '*' ) {
+		nmea_field ( pp );
+		pp->state = PS_CK1;
+		break;
+	    }
+
+	    if ( c == '$' || c == '\r' || c == '\n' || c == UBX_SYNC1 ) {
+		/* bad news, start over with this byte */
+		pp->bad++;
+		pp->state = PS_IDLE;
+		p--;
+		break;
+	    }
+
+	    pp->sum ^= c;
+	    if ( pp->field == 0 )
+		pp->id = ((pp->id << 8) | c) & 0xffffff;
+	    else if ( c == '.' )
+		pp->dot = 1;
+	    else if ( c == '-' )
+		pp->neg = 1;
+	    else if ( ! pp->ch )
+		pp->ch = c;
+	}
+
+	pp->count += p - buf;
+	if ( pp->state == PS_BODY && pp->count > NMEA_MAX ) {
+	    pp->bad++;
+	    pp->state = PS_IDLE;
+	}
+
+	return p - buf;
+}
+
+/* ------------------------------------------------------ */
+/* UBX */
+
+static unsigned int
+get_u2 ( unsigned char *p )
+{
+	return p[0] | p[1] << 8;
+}
+
+static unsigned int
+get_u4 ( unsigned char *p )
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (unsigned int) p[3] << 24;
+}
+
+#define UBX_NAV		0x01
+#define UBX_NAV_PVT	0x07
+#define UBX_NAV_TIMEUTC	0x21
+
+#define PVT_LEN		92
+#define TIMEUTC_LEN	20
+
+static void
+ubx_done ( struct gps_parser *pp )
+{
+	struct gps_pvt *vp = &pp->msg.pvt;
+	struct gps_timeutc *tp = &pp->msg.timeutc;
+	struct gps_ubx *up = &pp->msg.ubx;
+	unsigned char *p = pp->payload;
+
+	pp->good++;
+
+	if ( pp->ubx_cls == UBX_NAV && pp->ubx_id == UBX_NAV_PVT && pp->ubx_len == PVT_LEN ) {
+	    vp->itow = get_u4 ( p );
+	    vp->year = get_u2 ( p+4 );
+	    vp->mon = p[6];
+	    vp->day = p[7];
+	    vp->hour = p[8];
+	    vp->min = p[9];
+	    vp->sec = p[10];
+	    vp->valid = p[11];
+	    vp->tacc = get_u4 ( p+12 );
+	    vp->nano = get_u4 ( p+16 );
+	    vp->fix = p[20];
+	    vp->flags = p[21];
+	    vp->nsat = p[23];
+	    vp->lon = get_u4 ( p+24 );
+	    vp->lat = get_u4 ( p+28 );
+	    vp->height = get_u4 ( p+32 );
+	    vp->hmsl = get_u4 ( p+36 );
+	    (*pp->fn) ( GPS_PVT, vp );
+	    return;
+	}
+
+	if ( pp->ubx_cls == UBX_NAV && pp->ubx_id == UBX_NAV_TIMEUTC && pp->ubx_len == TIMEUTC_LEN ) {
+	    tp->itow = get_u4 ( p );
+	    tp->tacc = get_u4 ( p+4 );
+	    tp->nano = get_u4 ( p+8 );
+	    tp->year = get_u2 ( p+12 );
+	    tp->mon = p[14];
+	    tp->day = p[15];
+	    tp->hour = p[16];
+	    tp->min = p[17];
+	    tp->sec = p[18];
+	    tp->valid = p[19];
+	    (*pp->fn) ( GPS_TIMEUTC, tp );
+	    return;
+	}
+
+	up->cls = pp->ubx_cls;
+	up->id = pp->ubx_id;
+	up->len = pp->ubx_len;
+	up->payload = pp->payload;
+	(*pp->fn) ( GPS_UBX, up );
+}
+
+static void
+ubx_ck ( struct gps_parser *pp, int c )
+{
+	pp->ck_a += c;
+	pp->ck_b += pp->ck_a;
+}
+
+/* Payload bytes, as many as this span has.
+ * We keep what fits in pp->payload.
+ */
+static int
+ubx_payload ( struct gps_parser *pp, const unsigned char *buf, int len )
+{
+	unsigned char a = pp->ck_a;
+	unsigned char b = pp->ck_b;
+	int n = pp->ubx_len - pp->count;
+	int i;
+
+	if ( n > len )
+	    n = len;
+
+	for ( i=0; i<n; i++ ) {
+	    a += buf[i];
+	    b += a;
+	    if ( pp->count + i < GPS_UBX_MAX )
+		pp->payload[pp->count + i] = buf[i];
+	}
+
+	pp->ck_a = a;
+	pp->ck_b = b;
+	pp->count += n;
+	if ( pp->count == pp->ubx_len )
+	    pp->state = PS_CKA;
+
+	return n;
+}
+
+/* ------------------------------------------------------ */
+
+/* Feed the parser the next len bytes of the stream.
+ */
+void
+gps_parse ( struct gps_parser *pp, const unsigned char *buf, int len )
+{
+	int i = 0;
+	int c;
+
+	while ( i < len ) {
+	    if ( pp->state == PS_BODY ) {
+		i += nmea_body ( pp, buf+i, len-i );
+		continue;
+	    }
+	    if ( pp->state == PS_PAYLOAD ) {
+		i += ubx_payload ( pp, buf+i, len-i );
+		continue;
+	    }
+
+	    c = buf[i++];
+
+	    switch ( pp->state ) {
+	    case PS_IDLE:
+		if ( c == '$' ) {
+		    pp->state = PS_BODY;
+		    pp->sum = 0;
+		    pp->id = 0;
+		    pp->field = 0;
+		    pp->count = 1;
+		    field_reset ( pp );
+		} else if ( c == UBX_SYNC1 )
+		    pp->state = PS_SYNC2;
+		break;
+
+	    case PS_CK1:
+	    case PS_CK2:
+		if ( hexval ( c ) < 0 ) {
+		    pp->bad++;
+		    pp->state = PS_IDLE;
+		    i--;
+		    break;
+		}
+		if ( pp->state == PS_CK1 ) {
+		    pp->ck = hexval ( c ) << 4;
+		    pp->state = PS_CK2;
+		} else {
+		    pp->ck |= hexval ( c );
+		    pp->state = PS_IDLE;
+		    nmea_done ( pp );
+		}
+		break;
+
+	    case PS_SYNC2:
+		if ( c == UBX_SYNC2 )
+		    pp->state = PS_CLS;
+		else {
+		    pp->state = PS_IDLE;
+		    i--;
+		}
+		break;
+	    case PS_CLS:
+		pp->ck_a = pp->ck_b = 0;
+		ubx_ck ( pp, c );
+		pp->ubx_cls = c;
+		pp->state = PS_ID;
+		break;
+	    case PS_ID:
+		ubx_ck ( pp, c );
+		pp->ubx_id = c;
+		pp->state = PS_LEN1;
+		break;
+	    case PS_LEN1:
+		ubx_ck ( pp, c );
+		pp->ubx_len = c;
+		pp->state = PS_LEN2;
+		break;
+	    case PS_LEN2:
+		ubx_ck ( pp, c );
+		pp->ubx_len |= c << 8;
+		pp->count = 0;
+		pp->state = pp->ubx_len ? PS_PAYLOAD : PS_CKA;
+		break;
+	    case PS_CKA:
+		if ( c == pp->ck_a )
+		    pp->state = PS_CKB;
+		else {
+		    pp->bad++;
+		    pp->state = PS_IDLE;
+		}
+		break;
+	    case PS_CKB:
+		pp->state = PS_IDLE;
+		if ( c == pp->ck_b )
+		    ubx_done ( pp );
+		else
+		    pp->bad++;
+		break;
+	    }
+	}
+}
+
+/* THE END */
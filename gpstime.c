@@ -0,0 +1,406 @@
+/* gpstime.c
+ * (c) Tom Trebisky  10-19-2026
+ *
+ * GPS time discipline.
+ *
+ * The SAM-M8Q on UART2 (see serial.c) gives us NMEA sentences
+ * that tell the time of day, and a PPS (timepulse) output whose
+ * rising edge marks the start of each UTC second.
+ *
+ * Our local clock is the 32 bit timer that capture.c runs free
+ * for input capture (84 or 96 Mhz on the F4).  The PPS edge is
+ * latched by that same timer in hardware, so we know to within
+ * a timer count (12 ns or so) when each second began.
+ *
+ * On top of that counter we keep an "anchor":
+ *   - a timer count,
+ *   - the time (ns since 1970, UTC) at that count,
+ *   - the rate, as ns per count with 28 bits of fraction.
+ * time_now_ns() just reads the counter and extrapolates.
+ * The rate is 64 bits, since at the low clock speeds
+ * rcc_set_sysclk() allows (24 Mhz, say) a count is more
+ * than the 16 ns that would fit in 32 bits.  The product
+ * with the counts since the anchor is fine in 64 bits for
+ * a minute or so, and time_poll() moves the anchor up
+ * every second.
+ *
+ * Once per second, when a PPS edge shows up, we compare what
+ * our clock said at the edge with the true time and run a
+ * simple servo:
+ *   - rate: the count between edges is the true oscillator
+ *     frequency, which we filter a bit.
+ *   - offset: half of the error is taken out over the next
+ *     second by adjusting the rate, so time never jumps.
+ * If the error is big (first lock, or we lost the GPS for a
+ * long time), we just step the clock.
+ *
+ * The GPS messages (see gps.c) only tell us which second an
+ * edge was.  They arrive a few hundred ms after the edge they
+ * describe.  RMC, ZDA, or UBX NAV-TIMEUTC will all do.
+ *
+ * Nothing here may do 64 bit division, we don't link libgcc.
+ * div64() below does the one division we need, slowly,
+ * once per second.
+ *
+ * F4 only, since it needs capture.c
+ */
+
+#include "hydra.h"
+
+/* UBX NAV-TIMEUTC, the UTC time is good */
+#define TIMEUTC_VALID	0x04
+
+#define NS_PER_SEC	1000000000
+
+/* Fraction bits in ns per count */
+#define RATE_SHIFT	28
+
+/* Error (ns) beyond which we step rather than slew */
+#define STEP_LIMIT	1000000
+
+/* How often we look for new PPS edges, in ms */
+#define POLL_MS		10
+
+#define PPS_BUF_SIZE	8
+
+static struct capture pps_cap;
+static unsigned int pps_buf[PPS_BUF_SIZE] HYDRA_DMA;
+
+/* The anchor, see above.
+ * Changed at interrupt level, so read it with
+ * interrupts off.
+ */
+static unsigned int anchor_count;
+static unsigned long long anchor_ns;
+static unsigned long long anchor_rate;
+
+/* Servo state */
+static int locked;
+static unsigned int last_edge;		/* timer count */
+static unsigned int last_sec;		/* UTC second of last_edge */
+static int have_edge;
+static unsigned int freq_q4;		/* filtered counts per second, x16 */
+
+/* statistics */
+static int last_err;			/* ns, at the last edge, pinned if we stepped */
+static int edge_count;
+static int step_count;
+static int gps_count;
+
+/* Set from GPS messages at interrupt level */
+static volatile unsigned int gps_sec;
+static volatile int gps_new;
+
+/* 64 by 32 bit unsigned divide, shift and subtract.
+ * Plenty fast for something we do once a second.
+ */
+static unsigned long long
+div64 ( unsigned long long n, unsigned int d )
+{
+	unsigned long long q = 0;
+	unsigned long long r = 0;
+	int i;
+
+	for ( i=63; i>=0; i-- ) {
+	    r = (r << 1) | ((n >> i) & 1);
+	    q <<= 1;
+	    if ( r >= d ) {
+		r -= d;
+		q |= 1;
+	    }
+	}
+	return q;
+}
+
+/* ns per count for a clock of "counts" per "span" ns */
+static unsigned long long
+rate_for ( unsigned int span, unsigned int counts )
+{
+	return div64 ( (unsigned long long) span << RATE_SHIFT, counts );
+}
+
+/* Time at a given count, using the anchor.
+ * Caller has interrupts off (or is at interrupt level).
+ */
+static unsigned long long
+anchor_time ( unsigned int count )
+{
+	unsigned int delta = count - anchor_count;
+
+	return anchor_ns + ((delta * anchor_rate) >> RATE_SHIFT);
+}
+
+/* Public */
+unsigned long long
+time_now_ns ( void )
+{
+	unsigned long long rv;
+	int state;
+
+	state = irq_save ();
+	rv = anchor_time ( capture_now ( &pps_cap ) );
+	irq_restore ( state );
+
+	return rv;
+}
+
+/* Split a time into seconds and ns, without
+ * 64 bit division.
+ */
+void
+time_split ( unsigned long long ns, unsigned int *sec, unsigned int *frac )
+{
+	unsigned int s;
+
+	s = div64 ( ns, NS_PER_SEC );
+	*sec = s;
+	*frac = ns - (unsigned long long) s * NS_PER_SEC;
+}
+
+int
+time_locked ( void )
+{
+	return locked;
+}
+
+/* Move the anchor up to the present, but keep the same rate.
+ * The timer wraps in about 45 seconds, so we must do this
+ * now and then even if there is no PPS.
+ */
+static void
+anchor_advance ( unsigned int count )
+{
+	anchor_ns = anchor_time ( count );
+	anchor_count = count;
+}
+
+/* Set the clock outright, at the edge given by count */
+static void
+time_step ( unsigned int count, unsigned int sec )
+{
+	anchor_count = count;
+	anchor_ns = (unsigned long long) sec * NS_PER_SEC;
+	step_count++;
+}
+
+/* We have an edge and we know what UTC second it began.
+ */
+static void
+pps_servo ( unsigned int edge, unsigned int sec )
+{
+	unsigned long long truth;
+	unsigned int counts;
+	unsigned int nsec;
+	unsigned int nominal;
+	long long err;
+	int ierr;
+
+	truth = (unsigned long long) sec * NS_PER_SEC;
+
+	if ( ! locked ) {
+	    time_step ( edge, sec );
+	    locked = 1;
+	    return;
+	}
+
+	/* Rate: how many counts in that many seconds */
+	counts = edge - last_edge;
+	nsec = sec - last_sec;
+	nominal = freq_q4 >> 4;
+	if ( nsec == 1 && counts > nominal - nominal/1000 && counts < nominal + nominal/1000 )
+	    freq_q4 += (int) ((counts << 4) - freq_q4) / 8;
+
+	/* Offset, what did we think the time was at the edge */
+	/* This stays 64 bits until we know it is small, a
+	 * bad edge or a jump in the GPS time can be seconds
+	 * off, which would wrap an int.
+	 */
+	err = (long long) (anchor_time ( edge ) - truth);
+
+	if ( err > STEP_LIMIT || err < -STEP_LIMIT ) {
+	    last_err = err > 0 ? 0x7fffffff : -0x7fffffff;
+	    time_step ( edge, sec );
+	    anchor_rate = rate_for ( NS_PER_SEC, freq_q4 >> 4 );
+	    return;
+	}
+
+	ierr = err;
+	last_err = ierr;
+
+	/* Keep time continuous across the edge, and run
+	 * fast or slow over the next second to take out
+	 * half of the error.
+	 * We want NS_PER_SEC - err/2 over freq_q4/16 counts.
+	 */
+	anchor_advance ( edge );
+	anchor_rate = div64 ( (unsigned long long) (NS_PER_SEC - ierr/2) << (RATE_SHIFT+4), freq_q4 );
+}
+
+/* Runs at interrupt level every POLL_MS */
+static void
+time_poll ( void )
+{
+	unsigned int edge;
+	unsigned int sec;
+	unsigned int now;
+	unsigned int counts;
+	unsigned int nominal;
+
+	now = capture_now ( &pps_cap );
+
+	while ( capture_read ( &pps_cap, &edge, 1 ) ) {
+	    edge_count++;
+
+	    if ( locked && have_edge ) {
+		/* Whole seconds since the last edge, in case we missed some */
+		counts = edge - last_edge;
+		nominal = freq_q4 >> 4;
+		sec = last_sec + (counts + nominal/2) / nominal;
+		pps_servo ( edge, sec );
+		last_edge = edge;
+		last_sec = sec;
+	    } else {
+		last_edge = edge;
+		have_edge = 1;
+	    }
+	}
+
+	/* The GPS time for an edge shows up after the edge.
+	 * If we aren't locked, this is what gets us going.
+	 * If we are, it should agree with what we counted,
+	 * and if not we believe the GPS.
+	 */
+	if ( gps_new ) {
+	    gps_new = 0;
+	    sec = gps_sec;
+
+	    if ( have_edge && now - last_edge < (freq_q4 >> 4) ) {
+		if ( ! locked ) {
+		    pps_servo ( last_edge, sec );
+		    last_sec = sec;
+		} else if ( sec != last_sec ) {
+		    time_step ( last_edge, sec );
+		    last_sec = sec;
+		}
+	    }
+	}
+
+	/* Read the counter again, an edge may have come in
+	 * since we did, and the anchor may now be on it.
+	 */
+	now = capture_now ( &pps_cap );
+	if ( now - anchor_count > (freq_q4 >> 4) )
+	    anchor_advance ( now );
+}
+
+/* ------------------------------------------------------ */
+
+/* Days from 1-1-1970 to the given date, good from 1970 to 2099
+ */
+static unsigned int
+days_since_1970 ( int year, int mon, int day )
+{
+	static const short mdays[] = { 0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334 };
+	unsigned int days;
+
+	days = (year - 1970) * 365 + (year - 1969) / 4;
+	days += mdays[mon-1] + day - 1;
+	if ( (year % 4) == 0 && mon > 2 )
+	    days++;
+	return days;
+}
+
+static void
+gps_second ( int year, int mon, int day, int sec_of_day )
+{
+	if ( year < 2020 || mon < 1 || mon > 12 )
+	    return;
+
+	gps_sec = days_since_1970 ( year, mon, day ) * 86400 + sec_of_day;
+	gps_new = 1;
+	gps_count++;
+}
+
+/* Called at interrupt level for each message from the GPS.
+ * Any of these tell us the time of the last second.
+ */
+static void
+time_gps_msg ( int type, void *msg )
+{
+	struct gps_rmc *rp = (struct gps_rmc *) msg;
+	struct gps_zda *zp = (struct gps_zda *) msg;
+	struct gps_timeutc *tp = (struct gps_timeutc *) msg;
+
+	if ( type == GPS_RMC && rp->status == 'A' )
+	    gps_second ( rp->year, rp->mon, rp->day, rp->tod / 1000 );
+	else if ( type == GPS_ZDA )
+	    gps_second ( zp->year, zp->mon, zp->day, zp->tod / 1000 );
+	else if ( type == GPS_TIMEUTC && (tp->valid & TIMEUTC_VALID) )
+	    gps_second ( tp->year, tp->mon, tp->day, tp->hour * 3600 + tp->min * 60 + tp->sec );
+}
+
+/* ------------------------------------------------------ */
+
+/* The timer clock is about to change, or just did (see
+ * rcc_notify).  Bring the anchor up to the switch at the
+ * old rate, then start over with the new nominal rate.
+ * The counts during the switch itself are a bit off, the
+ * servo takes that out at the next edge.
+ * We must forget the last edge, the count since then
+ * is a mix of the two rates.  That also leaves last_sec
+ * stale, so we drop the lock and let the next edge with
+ * a GPS time pick it up again.
+ */
+static void
+time_clock ( int what )
+{
+	unsigned int hz;
+	int state;
+
+	state = irq_save ();
+	if ( what == RCC_CHANGING ) {
+	    anchor_advance ( capture_now ( &pps_cap ) );
+	} else {
+	    hz = get_timer_hz ();
+	    anchor_count = capture_now ( &pps_cap );
+	    freq_q4 = hz << 4;
+	    anchor_rate = rate_for ( NS_PER_SEC, hz );
+	    have_edge = 0;
+	    locked = 0;
+	}
+	irq_restore ( state );
+}
+
+/* The PPS must go to a pin for TIMER2 or TIMER5 channel chan,
+ * see capture.c
+ */
+int
+time_init ( int timer, int chan, int gpio, int pin )
+{
+	unsigned int hz = get_timer_hz ();
+
+	if ( capture_init ( &pps_cap, timer, chan, gpio, pin, EXTI_RISING, pps_buf, PPS_BUF_SIZE ) )
+	    return 1;
+
+	freq_q4 = hz << 4;
+	anchor_rate = rate_for ( NS_PER_SEC, hz );
+	anchor_count = capture_now ( &pps_cap );
+	anchor_ns = 0;
+
+	gps_listen ( time_gps_msg );
+	gps_init ();
+
+	rcc_notify ( time_clock );
+	repeat ( POLL_MS, time_poll );
+	return 0;
+}
+
+void
+time_show ( void )
+{
+	printf ( "GPS time: %s, %d edges, %d gps times, %d steps\n",
+	    locked ? "locked" : "not locked", edge_count, gps_count, step_count );
+	printf ( "  last error %d ns, clock %d Hz\n", last_err, freq_q4 >> 4 );
+}
+
+/* THE END */
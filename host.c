@@ -0,0 +1,389 @@
+/* host.c
+ * (c) Tom Trebisky  10-19-2026
+ *
+ * Hydra on Linux, see Makefile.host
+ *
+ * The drivers get at the chip through pointers made from fixed
+ * addresses (UART1_BASE, SYSTICK_BASE, NVIC_BASE, the USB core
+ * registers, and so on).  Rather than change all of that, we ask
+ * Linux for memory at those very addresses, and that is our
+ * simulated register file.  This is a 64 bit process, but all of
+ * this is below 4G, so the USB code that keeps addresses in
+ * uint32_t works too.
+ *
+ * Plain memory reads back what was last written, which is most
+ * of what a driver needs.  For the rest:
+ *
+ *  - Registers that don't reset to zero get their reset values
+ *    (the uart TXE bit, the USB core "AHB idle" bit).
+ *  - The uart transmitter is always ready, serial.c hands each
+ *    byte to host_uart_tx() and the console goes to stdout.
+ *    host_uart_rx() hands a byte to the receive interrupt.
+ *  - Interrupts only happen when we say so.  host_irq() calls
+ *    the handler if the NVIC has it enabled, and host_wfi()
+ *    (which is what wfi is here) is one systick, so delay(),
+ *    react_run() and such see time go by.
+ *  - get_cycles() is nanoseconds, and get_cpu_hz() says 1 Ghz.
+ *  - The clock never changes, so there is no rcc.c
+ *
+ * The USB core can be walked through a bus reset and SETUP
+ * packets (host_usb_reset and host_usb_setup).  The receive
+ * FIFO is just one word of memory, so a SETUP packet reads
+ * the same word twice.  Luckily GET_DESCRIPTOR still works,
+ * the second half becomes wIndex (ignored) and wLength (the
+ * same as wValue, which is bigger than any descriptor).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+
+#include "hydra.h"
+
+#define HOST_HZ		1000000000
+
+/* serial.c's printf, see RENAMES in Makefile.host */
+void hydra_printf ( char *, ... );
+
+#define REG(a)		(*(volatile unsigned int *) (unsigned long) (a))
+
+/* Where the simulated chip lives */
+struct host_window {
+	unsigned long base;
+	unsigned long size;
+	char *name;
+};
+
+static struct host_window host_windows[] = {
+	{ 0x40000000, 0x00080000, "peripherals" },	/* APB1, APB2, AHB1, USB HS */
+	{ 0x50000000, 0x00040000, "usb fs" },		/* AHB2 */
+	{ 0xE0000000, 0x00100000, "cortex" },		/* systick, NVIC, SCB, DWT */
+};
+
+#define NUM_WINDOWS	(sizeof(host_windows) / sizeof(host_windows[0]))
+
+/* The USB core we use (USE_HS in usbF4/library/usb_conf.h) */
+#define OTG_BASE	0x40040000
+#define OTG_IRQ		77
+
+#define OTG_GRSTCTL	(OTG_BASE + 0x010)
+#define OTG_GINTSTS	(OTG_BASE + 0x014)
+#define OTG_GRXSTSP	(OTG_BASE + 0x020)
+#define OTG_DSTS	(OTG_BASE + 0x808)
+#define OTG_DAINT	(OTG_BASE + 0x818)
+#define OTG_DOEPINT0	(OTG_BASE + 0xB08)
+#define OTG_FIFO0	(OTG_BASE + 0x1000)
+
+/* bits in GINTSTS */
+#define GINT_SOF	BIT(3)
+#define GINT_RXFLVL	BIT(4)
+#define GINT_USBRST	BIT(12)
+#define GINT_ENUMDNE	BIT(13)
+#define GINT_OEPINT	BIT(19)
+
+#define RXSTS_SETUP	(6 << 17)	/* SETUP data, in GRXSTSP */
+#define DOEPINT_STUP	BIT(3)
+#define DSTS_FS		(3 << 1)	/* enumerated at full speed */
+
+/* uart status register, see serial.c */
+static unsigned long host_uarts[] = { 0x40011000, 0x40004400, 0x40011400 };
+static int host_uart_irqs[] = { 37, 38, 71 };
+
+#define UART_RXNE	0x20
+#define UART_TC		0x40
+#define UART_TXE	0x80
+
+#define SYST_CSR	0xE000E010
+#define NVIC_ISER	0xE000E100
+
+/* Registers that don't come up zero */
+struct host_reset {
+	unsigned long addr;
+	unsigned int val;
+};
+
+static struct host_reset host_resets[] = {
+	{ 0x40011000, UART_TXE | UART_TC },
+	{ 0x40004400, UART_TXE | UART_TC },
+	{ 0x40011400, UART_TXE | UART_TC },
+	{ OTG_GRSTCTL, 0x80000000 },		/* AHB master idle */
+	{ 0xE000ED00, 0x410FC241 },		/* CPUID, a Cortex-M4 */
+};
+
+#define NUM_RESETS	(sizeof(host_resets) / sizeof(host_resets[0]))
+
+/* The part of the vector table (locore_411.s) we can use here */
+void exti0_handler ( void );
+void exti1_handler ( void );
+void exti2_handler ( void );
+void exti3_handler ( void );
+void exti4_handler ( void );
+void exti9_5_handler ( void );
+void exti15_10_handler ( void );
+void uart1_handler ( void );
+void uart2_handler ( void );
+void usb_hs_irq_handler ( void );
+void systick_handler ( void );
+
+struct host_vector {
+	int irq;
+	vfptr fn;
+};
+
+static struct host_vector host_vectors[] = {
+	{ 6, exti0_handler },
+	{ 7, exti1_handler },
+	{ 8, exti2_handler },
+	{ 9, exti3_handler },
+	{ 10, exti4_handler },
+	{ 23, exti9_5_handler },
+	{ 37, uart1_handler },
+	{ 38, uart2_handler },
+	{ 40, exti15_10_handler },
+	{ OTG_IRQ, usb_hs_irq_handler },
+};
+
+#define NUM_VECTORS	(sizeof(host_vectors) / sizeof(host_vectors[0]))
+
+/* For ram_alloc() in event.c */
+#define HOST_RAM	(64 * 1024)
+
+static char host_ram_buf[HOST_RAM];
+
+static unsigned int host_ticks;
+static unsigned long host_start;
+
+/* Console output is dropped while this is set (for benchmarks) */
+int host_quiet;
+
+/* bytes sent, by uart */
+unsigned int host_tx_count[3];
+
+/* ---------------------------------------------------------- */
+
+static void
+host_map ( void )
+{
+	struct host_window *wp;
+	void *p;
+	int i;
+
+	for ( i=0; i<NUM_WINDOWS; i++ ) {
+	    wp = &host_windows[i];
+	    p = mmap ( (void *) wp->base, wp->size, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0 );
+	    if ( p != (void *) wp->base ) {
+		fprintf ( stderr, "Cannot map %s at %lx\n", wp->name, wp->base );
+		exit ( 1 );
+	    }
+	}
+
+	for ( i=0; i<NUM_RESETS; i++ )
+	    REG(host_resets[i].addr) = host_resets[i].val;
+
+	/* our "reset" */
+	host_start = host_cycles ();
+}
+
+void *
+host_ram ( void )
+{
+	return host_ram_buf;
+}
+
+unsigned int
+host_cycles ( void )
+{
+	struct timespec ts;
+
+	clock_gettime ( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec * 1000000000UL + ts.tv_nsec - host_start;
+}
+
+/* Fire an interrupt, if the NVIC has it enabled.
+ * Returns 1 if a handler ran.
+ */
+int
+host_irq ( int irq )
+{
+	int i;
+
+	if ( ! (REG(NVIC_ISER + 4 * (irq / 32)) & BIT(irq % 32)) )
+	    return 0;
+
+	for ( i=0; i<NUM_VECTORS; i++ )
+	    if ( host_vectors[i].irq == irq ) {
+		(*host_vectors[i].fn) ();
+		return 1;
+	    }
+
+	return 0;
+}
+
+/* What "wfi" does here, one millisecond goes by */
+void
+host_wfi ( void )
+{
+	host_ticks++;
+	if ( (REG(SYST_CSR) & 3) == 3 )
+	    systick_handler ();
+}
+
+/* ---------------------------------------------------------- */
+
+/* From serial_putc() and serial_write() */
+void
+host_uart_tx ( int uart, int c )
+{
+	host_tx_count[uart]++;
+
+	if ( uart != get_std_serial () || host_quiet || c == '\r' )
+	    return;
+	putchar ( c );
+}
+
+/* A byte comes in.  The handler clears the status register,
+ * but TXE is read only on the real thing.
+ */
+void
+host_uart_rx ( int uart, int c )
+{
+	unsigned long base = host_uarts[uart];
+
+	REG(base + 4) = c;
+	REG(base) |= UART_RXNE;
+	host_irq ( host_uart_irqs[uart] );
+	REG(base) |= UART_TXE | UART_TC;
+}
+
+/* ---------------------------------------------------------- */
+
+static void
+usb_interrupt ( unsigned int bits )
+{
+	REG(OTG_GINTSTS) = bits;
+	host_irq ( OTG_IRQ );
+	REG(OTG_GINTSTS) = 0;
+}
+
+/* Bus reset, then enumeration at full speed */
+void
+host_usb_reset ( void )
+{
+	usb_interrupt ( GINT_USBRST );
+	REG(OTG_DSTS) = DSTS_FS;
+	usb_interrupt ( GINT_ENUMDNE );
+}
+
+void
+host_usb_sof ( void )
+{
+	usb_interrupt ( GINT_SOF );
+}
+
+/* A SETUP packet on endpoint 0, the word goes in the
+ * FIFO (see above), then setup done.
+ */
+void
+host_usb_setup ( unsigned int word )
+{
+	REG(OTG_GRXSTSP) = RXSTS_SETUP | (8 << 4);
+	REG(OTG_FIFO0) = word;
+	usb_interrupt ( GINT_RXFLVL );
+
+	REG(OTG_DAINT) = BIT(16);
+	REG(OTG_DOEPINT0) = DOEPINT_STUP;
+	usb_interrupt ( GINT_OEPINT );
+	REG(OTG_DAINT) = 0;
+	REG(OTG_DOEPINT0) = 0;
+}
+
+/* ---------------------------------------------------------- */
+
+/* What rcc_411.c would give us */
+int
+get_cpu_hz ( void )
+{
+	return HOST_HZ;
+}
+
+int
+get_pclk1 ( void )
+{
+	return HOST_HZ / 4;
+}
+
+int
+get_pclk2 ( void )
+{
+	return HOST_HZ / 2;
+}
+
+/* The clock never changes here */
+void
+rcc_notify ( void (*fn) ( int ) )
+{
+}
+
+void
+panic ( char *msg )
+{
+	fflush ( stdout );
+	fprintf ( stderr, "panic: %s\n", msg );
+	exit ( 1 );
+}
+
+/* ---------------------------------------------------------- */
+
+/* Like stm_init(), for what we have */
+static void
+host_init ( void )
+{
+	host_map ();
+	cycle_init ();
+	boot_mark ( "map" );
+
+	ram_init ();
+	boot_clock ();
+	set_std_serial ( UART1 );
+	serial_begin ( UART1, 115200 );
+	boot_mark ( "serial" );
+
+	systick_init ();
+	delay_init ();
+	nvic_init ();
+	boot_mark ( "systick" );
+
+	/* The USB init is chatty */
+	host_quiet = 1;
+	usb_init ();
+	host_usb_reset ();
+	host_quiet = 0;
+	boot_mark ( "usb" );
+}
+
+/* hydra_host [name ...]
+ * runs the benchmarks whose names start with each name (all
+ * of them if none), see bench.c and host_bench.c
+ * "hydra_host test" runs the unit tests in host_test.c
+ * instead, and exits 1 if any fail.
+ */
+int
+main ( int argc, char **argv )
+{
+	host_init ();
+
+	hydra_printf ( "Hydra on Linux (%s build)\n", HYDRA_PROFILE );
+	boot_show ();
+
+	if ( argc == 2 && strcmp ( argv[1], "test" ) == 0 )
+	    return host_test () ? 1 : 0;
+
+	host_bench ( argc - 1, argv + 1 );
+
+	return 0;
+}
+
+/* THE END */
@@ -0,0 +1,161 @@
+/* host_bench.c
+ * (c) Tom Trebisky  10-19-2026
+ *
+ * Benchmarks for Hydra on Linux (see host.c)
+ *
+ * These run in bench.c like the ones on the board, with the
+ * same batches, samples and report.  Here we only add what
+ * the host can do and the board can't easily (or doesn't
+ * need to, since it has the real thing): the byte at a time
+ * ring calls, message queues, event_tick, the GPS parser on a
+ * canned sentence, and the USB interrupt driven by host.c
+ *
+ * This is a Linux box, not a Cortex-M4, so the numbers only
+ * mean something next to each other: before and after a
+ * change, on the same machine.
+ */
+
+#include "hydra.h"
+
+/* see host.c */
+void host_usb_sof ( void );
+void host_usb_setup ( unsigned int );
+
+/* ---------------------------------------------------------- */
+
+static unsigned char ring_buf[256];
+static struct ring ring = RING_INIT ( ring_buf );
+
+static void
+b_ring_byte ( int n )
+{
+	int i;
+
+	for ( i=0; i<n; i++ ) {
+	    ring_put ( &ring, i );
+	    ring_get ( &ring );
+	}
+}
+
+struct bench_msg {
+	int type;
+	int val;
+	unsigned int stamp;
+};
+
+static struct bench_msg msg_slots[8];
+static struct msgq msgq = MSGQ_INIT ( msg_slots );
+
+static void
+b_msgq ( int n )
+{
+	struct bench_msg *mp;
+	int i;
+
+	for ( i=0; i<n; i++ ) {
+	    mp = msgq_reserve ( &msgq );
+	    mp->type = 1;
+	    mp->val = i;
+	    msgq_commit ( &msgq );
+	    mp = msgq_get ( &msgq );
+	    msgq_release ( &msgq );
+	}
+}
+
+/* ---------------------------------------------------------- */
+
+#define BENCH_REPEATS	8
+
+static void
+nothing ( void )
+{
+}
+
+/* event_tick with 8 repeats to run through */
+static void
+b_event_tick ( int n )
+{
+	int ids[BENCH_REPEATS];
+	int i;
+
+	for ( i=0; i<BENCH_REPEATS; i++ )
+	    ids[i] = repeat ( 2 + i, nothing );
+
+	for ( i=0; i<n; i++ )
+	    event_tick ();
+
+	for ( i=0; i<BENCH_REPEATS; i++ )
+	    repeat_cancel ( ids[i] );
+}
+
+/* ---------------------------------------------------------- */
+
+static char gga[] =
+    "$GPGGA,172814.00,3231.49384,N,11057.30917,W,1,08,1.01,786.4,M,-27.6,M,,*63\r\n";
+
+static struct gps_parser gps_parser;
+
+static void
+gps_msg ( int type, void *msg )
+{
+}
+
+static void
+b_gps_nmea ( int n )
+{
+	int len = strlen ( gga );
+	int i;
+
+	gps_parse_init ( &gps_parser, gps_msg );
+	for ( i=0; i<n; i++ )
+	    gps_parse ( &gps_parser, (unsigned char *) gga, len );
+}
+
+/* ---------------------------------------------------------- */
+
+/* GET_DESCRIPTOR (device), see host_usb_setup() */
+#define SETUP_GET_DEVICE	0x01000680
+
+static void
+b_usb_sof ( int n )
+{
+	int i;
+
+	for ( i=0; i<n; i++ )
+	    host_usb_sof ();
+}
+
+static void
+b_usb_setup ( int n )
+{
+	int i;
+
+	for ( i=0; i<n; i++ )
+	    host_usb_setup ( SETUP_GET_DEVICE );
+}
+
+/* ---------------------------------------------------------- */
+
+/* Add ours, then run the named ones (by prefix, as bench_run
+ * does it), or all of them if no names.
+ */
+void
+host_bench ( int argc, char **argv )
+{
+	int i;
+
+	bench_add ( "ring_byte", b_ring_byte, 0, 0, 0, "ring_put and ring_get" );
+	bench_add ( "msgq", b_msgq, 0, 0, 0, "reserve, commit, get, release" );
+	bench_add ( "event_tick", b_event_tick, 0, 0, 0, "event_tick, 8 repeats" );
+	bench_add ( "gps_nmea", b_gps_nmea, 0, 0, 0, "gps_parse, one GGA sentence" );
+	bench_add ( "usb_sof", b_usb_sof, 0, 0, 0, "USB interrupt, SOF" );
+	bench_add ( "usb_setup", b_usb_setup, 0, 0, 0, "USB interrupts, GET_DESCRIPTOR setup" );
+
+	if ( argc == 0 )
+	    bench_run ( 0, BENCH_CSV );
+
+	for ( i=0; i<argc; i++ )
+	    bench_run ( argv[i], BENCH_CSV );
+}
+
+/* THE END */
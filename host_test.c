@@ -0,0 +1,374 @@
+/* host_test.c
+ * (c) Tom Trebisky  10-19-2026
+ *
+ * Unit tests for Hydra on Linux (see host.c)
+ *
+ *   make TARGET=host test
+ *
+ * or "hydra_host test".  Each CHECK that fails prints the line
+ * and what it expected, and hydra_host exits 1 if any did.
+ * These go after the edges, where a bug would otherwise only
+ * show up now and then on the board:
+ *
+ *  - events come due in order (same delay, first in first out),
+ *    and cancelling one leaves the rest on time
+ *  - the printf formatter, each conversion and truncation
+ *  - rings, empty, full, and spans at the end of the buffer
+ *  - message queues refuse a slot count that isn't a power of 2
+ *  - the GPS parser throws out anything with a bad checksum
+ *
+ * Nothing here runs systick, we call event_tick() ourselves.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include "hydra.h"
+
+/* ours, see RENAMES in Makefile.host */
+void asnprintf ( char *, unsigned int, const char *, va_list );
+
+static int checks;
+static int failed;
+
+#define CHECK(x)	check ( (x), #x, __LINE__ )
+
+static void
+check ( int ok, char *what, int line )
+{
+	checks++;
+	if ( ok )
+	    return;
+	printf ( "FAIL host_test.c:%d: %s\n", line, what );
+	failed++;
+}
+
+/* ---------------------------------------------------------- */
+
+#define MAX_FIRED	16
+
+static char fired[MAX_FIRED+1];
+static int fired_tick[MAX_FIRED];
+static int nfired;
+static int tick_now;
+
+static void
+fire ( int c )
+{
+	if ( nfired < MAX_FIRED ) {
+	    fired_tick[nfired] = tick_now;
+	    fired[nfired++] = c;
+	    fired[nfired] = '\0';
+	}
+}
+
+static void ev_a ( void ) { fire ( 'a' ); }
+static void ev_b ( void ) { fire ( 'b' ); }
+static void ev_c ( void ) { fire ( 'c' ); }
+static void ev_d ( void ) { fire ( 'd' ); }
+
+static void
+ticks ( int n )
+{
+	while ( n-- ) {
+	    tick_now++;
+	    event_tick ();
+	}
+}
+
+static void
+fired_reset ( void )
+{
+	nfired = 0;
+	fired[0] = '\0';
+	tick_now = 0;
+}
+
+static void
+test_event_order ( void )
+{
+	fired_reset ();
+
+	event ( 5, ev_a );
+	event ( 2, ev_b );
+	event ( 8, ev_c );
+	event ( 2, ev_d );
+
+	ticks ( 10 );
+
+	CHECK ( strcmp ( fired, "bdac" ) == 0 );
+	CHECK ( fired_tick[0] == 2 && fired_tick[1] == 2 );
+	CHECK ( fired_tick[2] == 5 );
+	CHECK ( fired_tick[3] == 8 );
+}
+
+static void
+test_event_cancel ( void )
+{
+	int a, b, c;
+
+	fired_reset ();
+
+	/* the middle, then the head */
+	a = event ( 2, ev_a );
+	b = event ( 4, ev_b );
+	c = event ( 6, ev_c );
+	event ( 6, ev_d );
+
+	event_cancel ( b );
+	event_cancel ( a );
+
+	ticks ( 5 );
+	CHECK ( nfired == 0 );
+	ticks ( 1 );
+	CHECK ( strcmp ( fired, "cd" ) == 0 );
+	CHECK ( fired_tick[0] == 6 && fired_tick[1] == 6 );
+
+	/* already gone, must do nothing */
+	event_cancel ( c );
+
+	/* the tail */
+	fired_reset ();
+	event ( 1, ev_a );
+	c = event ( 3, ev_c );
+	event_cancel ( c );
+	event ( 2, ev_b );
+	ticks ( 4 );
+	CHECK ( strcmp ( fired, "ab" ) == 0 );
+	CHECK ( fired_tick[1] == 2 );
+}
+
+/* ---------------------------------------------------------- */
+
+static char fmt_buf[32];
+
+static char *
+fmt ( unsigned int size, char *f, ... )
+{
+	va_list args;
+
+	memset ( fmt_buf, 'Z', sizeof(fmt_buf) );
+	va_start ( args, f );
+	asnprintf ( fmt_buf, size, f, args );
+	va_end ( args );
+	return fmt_buf;
+}
+
+static void
+test_format ( void )
+{
+	CHECK ( strcmp ( fmt ( 32, "plain" ), "plain" ) == 0 );
+	CHECK ( strcmp ( fmt ( 32, "%d", 0 ), "0" ) == 0 );
+	CHECK ( strcmp ( fmt ( 32, "%d", 1234567 ), "1234567" ) == 0 );
+	CHECK ( strcmp ( fmt ( 32, "%d", -42 ), "-42" ) == 0 );
+	CHECK ( strcmp ( fmt ( 32, "%X", 0xdeadbeef ), "DEADBEEF" ) == 0 );
+	CHECK ( strcmp ( fmt ( 32, "%h", 0x1f ), "0000001F" ) == 0 );
+
+	/* %x is just the low byte */
+	CHECK ( strcmp ( fmt ( 32, "%x", 0x1234 ), "34" ) == 0 );
+	CHECK ( strcmp ( fmt ( 32, "%c%c", 'o', 'k' ), "ok" ) == 0 );
+	CHECK ( strcmp ( fmt ( 32, "<%s>", "str" ), "<str>" ) == 0 );
+	CHECK ( strcmp ( fmt ( 32, "%s: %d %X", "n", 7, 7 ), "n: 7 00000007" ) == 0 );
+
+	/* Truncated to size-1, and always terminated */
+	fmt ( 8, "0123456789" );
+	CHECK ( strcmp ( fmt_buf, "0123456" ) == 0 );
+	CHECK ( fmt_buf[8] == 'Z' );
+	fmt ( 4, "%d", 123456 );
+	CHECK ( strcmp ( fmt_buf, "123" ) == 0 );
+	fmt ( 1, "abc" );
+	CHECK ( fmt_buf[0] == '\0' && fmt_buf[1] == 'Z' );
+}
+
+/* ---------------------------------------------------------- */
+
+#define SMALL_RING	8
+
+static void
+test_ring ( void )
+{
+	unsigned char buf[SMALL_RING];
+	unsigned char out[SMALL_RING];
+	struct ring r;
+	unsigned char *p;
+	int n, i;
+
+	ring_init ( &r, buf, SMALL_RING );
+
+	/* empty */
+	CHECK ( ring_count ( &r ) == 0 );
+	CHECK ( ring_get ( &r ) == -1 );
+	ring_peek ( &r, &n );
+	CHECK ( n == 0 );
+	CHECK ( ring_read ( &r, out, 1 ) == 0 );
+
+	/* full, all 8 bytes usable */
+	for ( i=0; i<SMALL_RING; i++ )
+	    CHECK ( ring_put ( &r, 'a' + i ) == 0 );
+	CHECK ( ring_put ( &r, 'x' ) == -1 );
+	CHECK ( ring_space ( &r ) == 0 );
+	ring_reserve ( &r, &n );
+	CHECK ( n == 0 );
+	CHECK ( ring_write ( &r, "x", 1 ) == 0 );
+
+	/* take 5 out, the free space is now at the start */
+	CHECK ( ring_read ( &r, out, 5 ) == 5 );
+	CHECK ( memcmp ( out, "abcde", 5 ) == 0 );
+	p = ring_reserve ( &r, &n );
+	CHECK ( p == &buf[0] && n == 5 );
+
+	/* wrap: the data is in two spans */
+	CHECK ( ring_write ( &r, "12345", 5 ) == 5 );
+	p = ring_peek ( &r, &n );
+	CHECK ( p == &buf[5] && n == 3 );
+	CHECK ( ring_read ( &r, out, SMALL_RING ) == SMALL_RING );
+	CHECK ( memcmp ( out, "fgh12345", SMALL_RING ) == 0 );
+	CHECK ( ring_count ( &r ) == 0 );
+
+	/* head and tail wrap at 2^32 */
+	r.head = r.tail = 0xfffffffe;
+	CHECK ( ring_write ( &r, "wxyz", 4 ) == 4 );
+	CHECK ( r.head == 2 && ring_count ( &r ) == 4 );
+	CHECK ( ring_get ( &r ) == 'w' );
+	CHECK ( ring_read ( &r, out, 3 ) == 3 );
+	CHECK ( memcmp ( out, "xyz", 3 ) == 0 );
+	CHECK ( ring_get ( &r ) == -1 );
+}
+
+/* ---------------------------------------------------------- */
+
+static void
+test_msgq ( void )
+{
+	int slots[8];
+	struct msgq q;
+	int i;
+
+	CHECK ( msgq_init ( &q, slots, sizeof(int), 6 ) == -1 );
+	CHECK ( msgq_reserve ( &q ) == 0 );
+	CHECK ( msgq_drops ( &q ) == 1 );
+	CHECK ( msgq_init ( &q, slots, sizeof(int), 0 ) == -1 );
+
+	CHECK ( msgq_init ( &q, slots, sizeof(int), 8 ) == 0 );
+	for ( i=0; i<8; i++ ) {
+	    CHECK ( msgq_reserve ( &q ) == &slots[i] );
+	    msgq_commit ( &q );
+	}
+	CHECK ( msgq_reserve ( &q ) == 0 );
+
+	/* what a failed react_add() hands back */
+	CHECK ( msgq_notify ( &q, -1 ) == -1 );
+	react_post ( -1 );
+}
+
+/* ---------------------------------------------------------- */
+
+static int gps_type;
+static int gps_calls;
+
+static void
+gps_msg ( int type, void *msg )
+{
+	gps_type = type;
+	gps_calls++;
+}
+
+static void
+gps_feed ( struct gps_parser *pp, void *s, int len )
+{
+	gps_type = 0;
+	gps_calls = 0;
+	gps_parse_init ( pp, gps_msg );
+	gps_parse ( pp, s, len );
+}
+
+#define GGA_GOOD "$GPGGA,172814.00,3231.49384,N,11057.30917,W,1,08,1.01,786.4,M,-27.6,M,,*63\r\n"
+#define GGA_DATA "$GPGGA,172814.00,3231.49384,N,11057.30917,W,1,08,1.01,786.5,M,-27.6,M,,*63\r\n"
+#define GGA_SUM  "$GPGGA,172814.00,3231.49384,N,11057.30917,W,1,08,1.01,786.4,M,-27.6,M,,*64\r\n"
+#define GGA_HEX  "$GPGGA,172814.00,3231.49384,N,11057.30917,W,1,08,1.01,786.4,M,-27.6,M,,*6G\r\n"
+
+static void
+test_gps ( void )
+{
+	struct gps_parser gp;
+	char good[] = GGA_GOOD;
+	unsigned char ubx[] = { 0xb5, 0x62, 0x0a, 0x04, 0x00, 0x00, 0x0e, 0x34 };
+	int i;
+
+	gps_feed ( &gp, good, strlen ( good ) );
+	CHECK ( gps_calls == 1 && gps_type == GPS_GGA );
+	CHECK ( gp.good == 1 && gp.bad == 0 );
+	CHECK ( gp.msg.gga.nsat == 8 );
+
+	/* one digit changed, same checksum */
+	gps_feed ( &gp, GGA_DATA, strlen ( GGA_DATA ) );
+	CHECK ( gps_calls == 0 );
+	CHECK ( gp.good == 0 && gp.bad == 1 );
+
+	/* same data, wrong checksum */
+	gps_feed ( &gp, GGA_SUM, strlen ( GGA_SUM ) );
+	CHECK ( gps_calls == 0 && gp.bad == 1 );
+
+	/* not even hex */
+	gps_feed ( &gp, GGA_HEX, strlen ( GGA_HEX ) );
+	CHECK ( gps_calls == 0 && gp.bad == 1 );
+
+	/* The good one a byte at a time, the state carries over */
+	gps_type = 0;
+	gps_calls = 0;
+	gps_parse_init ( &gp, gps_msg );
+	for ( i=0; good[i]; i++ )
+	    gps_parse ( &gp, (unsigned char *) &good[i], 1 );
+	CHECK ( gps_calls == 1 && gps_type == GPS_GGA );
+
+	/* UBX, an empty frame, good, then each checksum byte off */
+	gps_feed ( &gp, ubx, sizeof(ubx) );
+	CHECK ( gps_calls == 1 && gps_type == GPS_UBX );
+
+	ubx[6]++;
+	gps_feed ( &gp, ubx, sizeof(ubx) );
+	CHECK ( gps_calls == 0 && gp.bad == 1 );
+	ubx[6]--;
+
+	ubx[7]++;
+	gps_feed ( &gp, ubx, sizeof(ubx) );
+	CHECK ( gps_calls == 0 && gp.bad == 1 );
+}
+
+/* ---------------------------------------------------------- */
+
+struct host_test {
+	char *name;
+	void (*fn) ( void );
+};
+
+static struct host_test tests[] = {
+	{ "event_order",	test_event_order },
+	{ "event_cancel",	test_event_cancel },
+	{ "format",		test_format },
+	{ "ring",		test_ring },
+	{ "msgq",		test_msgq },
+	{ "gps",		test_gps },
+};
+
+#define NUM_TESTS	(sizeof(tests) / sizeof(tests[0]))
+
+/* Returns the number of checks that failed */
+int
+host_test ( void )
+{
+	struct host_test *tp;
+	int was;
+
+	for ( tp = tests; tp < &tests[NUM_TESTS]; tp++ ) {
+	    was = failed;
+	    (*tp->fn) ();
+	    printf ( "%-14s %s\n", tp->name, failed == was ? "ok" : "FAILED" );
+	}
+
+	printf ( "%d checks, %d failed\n", checks, failed );
+	return failed;
+}
+
+/* THE END */
@@ -14,6 +14,13 @@
 #define UART3	2
 /* F411 has only 2 uarts accessible, the F103 has 3 */
 
+/* names for the general purpose timers (see timer.c) */
+#define TIMER2	0
+#define TIMER3	1
+#define TIMER4	2
+#define TIMER5	3
+/* The F103 has no TIMER5 */
+
 /* names to index the bases array */
 #ifdef notdef
 #define GPIOA	0
@@ -24,10 +31,420 @@ enum { GPIOA, GPIOB, GPIOC,
 		GPIOD, GPIOE, GPIOF, GPIOG,
 		GPIOH, GPIOI, GPIOJ, GPIOK };
 
+/* edges for exti_setup_edge() */
+#define EXTI_RISING	1
+#define EXTI_FALLING	2
+#define EXTI_BOTH	3
+
 /* pointer to void function */
 typedef void (*vfptr) ( void );
 typedef void (*ifptr) ( int );
 typedef void (*bfptr) ( char *, int );
+typedef void (*afptr) ( void * );
+
+/* Where things go in ram, see the lds files.
+ * The F405/F407/F429 have 64K of CCM, no wait states, but only
+ * the CPU can get at it, never DMA.  Stacks live there.
+ * SRAM2 (and SRAM3 on the F429) have their own bus matrix port.
+ * Chips without one of these just put things in ordinary sram.
+ * The plain ones are zeroed by stm_init(), the _DATA ones are
+ * initialized from flash.
+ * HYDRA_DMA is for buffers DMA moves in or out of.  Putting
+ * HYDRA_DMA and HYDRA_CCM on the same thing is a compile error
+ * (section conflict), and dma_setup() rejects CCM addresses.
+ */
+#if defined(CHIP_F405) || defined(CHIP_F407) || defined(CHIP_F429)
+#define HAS_CCM
+#define HAS_SRAM2
+#endif
+#ifdef CHIP_F429
+#define HAS_SRAM3
+#endif
+
+#ifdef HYDRA_HOST
+/* On Linux (see host.c) it is all just memory */
+#define HYDRA_CCM
+#define HYDRA_CCM_DATA
+#define HYDRA_SRAM2
+#define HYDRA_SRAM2_DATA
+#define HYDRA_SRAM3
+#define HYDRA_SRAM3_DATA
+#define HYDRA_DMA
+#else
+#define HYDRA_CCM		__attribute__ ((section (".ccmram")))
+#define HYDRA_CCM_DATA		__attribute__ ((section (".ccmram_data")))
+#define HYDRA_SRAM2		__attribute__ ((section (".sram2")))
+#define HYDRA_SRAM2_DATA	__attribute__ ((section (".sram2_data")))
+#define HYDRA_SRAM3		__attribute__ ((section (".sram3")))
+#define HYDRA_SRAM3_DATA	__attribute__ ((section (".sram3_data")))
+#define HYDRA_DMA		__attribute__ ((section (".bss.dma")))
+#endif
+
+/* Code that runs from sram instead of flash, copied there by
+ * stm_init().  At 168 Mhz flash has 5 wait states and we depend
+ * on the ART cache, which branchy interrupt code misses a lot.
+ * (Not CCM, the instruction bus can't get at it.)  The linker
+ * puts in veneers for the long branches to and from flash.
+ * Build with -DNO_RAMFUNC to leave everything in flash.
+ */
+#ifdef NO_RAMFUNC
+#define HYDRA_RAMFUNC
+#else
+#define HYDRA_RAMFUNC		__attribute__ ((section (".ramfunc"), noinline))
+#endif
+
+#define CCM_BASE	0x10000000
+#define CCM_SIZE	0x10000
+
+/* Clock change notices, see rcc_notify() */
+#define RCC_CHANGING	0	/* about to change */
+#define RCC_CHANGED	1	/* get_cpu_hz() and friends are new */
+
+/* A segment in a combined i2c transaction, see iic.c */
+struct iic_seg {
+	int flags;
+	unsigned char *buf;
+	int len;
+};
+
+#define IIC_SEG_WRITE	0
+#define IIC_SEG_READ	1
+#define IIC_SEG_NOSTART	2	/* continue previous segment, no START/address */
+
+/* A queued i2c transaction, run by the interrupt driven engine.
+ * done() gets called at interrupt level when it finishes,
+ * with status set to 0 (ok), 1 (no ack), or IIC_BADSEG.
+ */
+struct iic_xact {
+	struct iic_xact *next;
+	int addr;
+	struct iic_seg *segs;
+	int nseg;
+	void (*done) ( struct iic_xact * );
+	void *arg;
+	int pri;	/* bigger runs first */
+	volatile int status;
+};
+
+#define IIC_PENDING	-1
+#define IIC_BADSEG	2	/* NOSTART segment changes direction */
+
+/* One bit banged i2c bus, see iic.c */
+typedef struct iic_bus {
+	unsigned char sda_gpio;
+	unsigned char sda_pin;
+	unsigned char scl_gpio;
+	unsigned char scl_pin;
+	unsigned char cur_sda;
+	unsigned char cur_scl;
+	int speed;
+	int step;	/* delay loop count for one protocol step */
+	int step9;	/* the same, for the 9th clock */
+
+	/* for the interrupt driven engine */
+	int timer;
+	struct iic_xact *cur;
+	struct iic_xact *head;
+	struct iic_xact *tail;
+	int phase;
+	int tick;
+	int bit;
+	int byte;
+	int seg;
+	int idx;
+	int nak;
+
+	int naks;	/* bytes nobody acked, both paths */
+} iic_bus_t;
+
+/* bus speeds */
+#define IIC_100K	0
+#define IIC_400K	1
+#define IIC_1M		2
+
+/* A byte ring, one producer and one consumer, see ring.c
+ * size must be a power of 2.
+ */
+struct ring {
+	unsigned char *buf;
+	int size;
+	unsigned int mask;
+	volatile unsigned int head;	/* only the producer moves this */
+	volatile unsigned int tail;	/* only the consumer moves this */
+};
+
+/* To set one up statically, from an array */
+#define RING_INIT(b)	{ (b), sizeof(b), sizeof(b) - 1, 0, 0 }
+
+/* These hand back pointers into the ring */
+unsigned char *ring_reserve ( struct ring *, int * );
+unsigned char *ring_peek ( struct ring *, int * );
+
+/* A message queue, fixed size slots, see msgq.c
+ * one producer and one consumer, the number of slots
+ * must be a power of 2.
+ */
+struct msgq {
+	char *slots;
+	int size;			/* bytes in each slot */
+	int num;			/* how many slots */
+	volatile unsigned int head;	/* only the producer moves this */
+	volatile unsigned int tail;	/* only the consumer moves this */
+	int react;			/* reactor source + 1, or 0 */
+	int drops;
+};
+
+/* To set one up statically, from an array of whatever
+ * type the messages are:
+ *   static struct my_msg my_slots[8];
+ *   static struct msgq my_q = MSGQ_INIT ( my_slots );
+ */
+#define MSGQ_INIT(a)	{ (char *) (a), sizeof((a)[0]), sizeof(a) / sizeof((a)[0]), 0, 0, 0, 0 }
+
+/* These hand back pointers to slots */
+void *msgq_reserve ( struct msgq * );
+void *msgq_get ( struct msgq * );
+void *msgq_wait ( struct msgq * );
+
+/* DMA on the F4, see dma.c
+ * A stream is named by DMA_STREAM(DMA2,3) and so on.
+ */
+#define DMA1		0
+#define DMA2		1
+#define DMA_STREAM(d,s)	((d)*8 + (s))
+#define NUM_DMA_STREAMS	16
+
+/* direction */
+#define DMA_P2M		0
+#define DMA_M2P		1
+#define DMA_M2M		2
+
+/* flags */
+#define DMA_PINC	0x01
+#define DMA_MINC	0x02
+#define DMA_CIRC	0x04
+#define DMA_DOUBLE	0x08	/* double buffer, m0 and m1 (implies circular) */
+
+/* fifo threshold, 0 is direct mode (no FIFO) */
+#define DMA_FIFO_1_4	1
+#define DMA_FIFO_HALF	2
+#define DMA_FIFO_3_4	3
+#define DMA_FIFO_FULL	4
+
+/* from dma_error() */
+#define DMA_ERR_FIFO	0x01
+#define DMA_ERR_DIRECT	0x04
+#define DMA_ERR_XFER	0x08
+
+struct dma_config {
+	int chan;	/* request channel 0-7, from the RM table */
+	int dir;
+	int psize;	/* 1, 2, or 4 bytes */
+	int msize;
+	int flags;
+	int fifo;
+	int burst;	/* memory burst: 1, 4, 8, or 16 */
+	int pburst;	/* peripheral burst */
+	int pri;	/* 0 (low) to 3 (very high) */
+	volatile void *par;	/* peripheral (or source for M2M) */
+	void *m0;
+	void *m1;	/* second buffer for DMA_DOUBLE */
+	int count;	/* items of psize */
+	afptr half;	/* callbacks, at interrupt level */
+	afptr full;
+	afptr error;
+	void *arg;
+};
+
+/* One timer input capture channel, see capture.c (F4 only) */
+struct capture {
+	int timer;	/* TIMER2 or TIMER5 */
+	int chan;	/* 1-4 */
+	int stream;	/* DMA1 stream, see dma.c */
+	unsigned int *buf;
+	int size;
+	int rd;
+};
+
+/* Messages from the GPS, see gps_parse.c
+ * Positions are 1e-7 degree, tod is ms into the UTC day.
+ */
+#define GPS_GGA		1
+#define GPS_RMC		2
+#define GPS_ZDA		3
+#define GPS_PVT		4	/* UBX NAV-PVT */
+#define GPS_TIMEUTC	5	/* UBX NAV-TIMEUTC */
+#define GPS_UBX		6	/* any other UBX frame, raw */
+
+struct gps_gga {
+	int tod;
+	int lat;
+	int lon;
+	int quality;	/* 0 = no fix */
+	int nsat;
+	int hdop;	/* x 100 */
+	int alt;	/* mm above MSL */
+};
+
+struct gps_rmc {
+	int tod;
+	int status;	/* 'A' is valid */
+	int lat;
+	int lon;
+	int speed;	/* knots x 1000 */
+	int course;	/* degrees x 100 */
+	int day;
+	int mon;
+	int year;
+};
+
+struct gps_zda {
+	int tod;
+	int day;
+	int mon;
+	int year;
+};
+
+struct gps_pvt {
+	unsigned int itow;
+	int year, mon, day;
+	int hour, min, sec;
+	int valid;
+	unsigned int tacc;	/* ns */
+	int nano;
+	int fix;
+	int flags;
+	int nsat;
+	int lon;
+	int lat;
+	int height;		/* mm */
+	int hmsl;		/* mm */
+};
+
+struct gps_timeutc {
+	unsigned int itow;
+	unsigned int tacc;
+	int nano;
+	int year, mon, day;
+	int hour, min, sec;
+	int valid;
+};
+
+struct gps_ubx {
+	int cls;
+	int id;
+	int len;
+	unsigned char *payload;	/* only the first GPS_UBX_MAX bytes */
+};
+
+#define GPS_UBX_MAX	96
+
+/* Parser state, carried from one span of bytes to the next */
+struct gps_parser {
+	int state;
+	int count;		/* bytes so far in this sentence or payload */
+
+	/* NMEA */
+	int id;
+	int field;
+	int sum;
+	int ck;
+	int num;		/* the field being converted */
+	int ndig;
+	int frac;
+	int dot;
+	int neg;
+	int ch;
+
+	/* UBX */
+	int ubx_cls;
+	int ubx_id;
+	int ubx_len;
+	unsigned char ck_a;
+	unsigned char ck_b;
+	unsigned char payload[GPS_UBX_MAX];
+
+	union {
+	    struct gps_gga gga;
+	    struct gps_rmc rmc;
+	    struct gps_zda zda;
+	    struct gps_pvt pvt;
+	    struct gps_timeutc timeutc;
+	    struct gps_ubx ubx;
+	} msg;
+
+	void (*fn) ( int, void * );
+
+	/* statistics */
+	int good;
+	int bad;		/* checksum or framing errors */
+	int other;		/* good NMEA we don't decode */
+};
+
+/* A device on a bus, with statistics, see iic_queue.c */
+struct iic_dev {
+	struct iic_dev *next;
+	iic_bus_t *bus;
+	struct iic_xact xact;
+	void (*done) ( struct iic_dev * );
+	char *name;
+	int period;		/* in ms, 0 if not periodic */
+	int count_down;
+	unsigned int t_submit;	/* cycle count at submit */
+
+	/* statistics */
+	int count;
+	int errors;
+	int overruns;		/* periodic sample still pending */
+	unsigned int lat_min;	/* latency (submit to done) in us */
+	unsigned int lat_max;
+	unsigned int lat_total;
+	unsigned int lat_last;
+};
+
+/* A benchmark, see bench.c
+ * fn does the thing n times, setup (if any) runs before each
+ * sample and isn't timed.  batch is n for each sample, or 0 to
+ * let bench.c pick one.
+ */
+struct bench {
+	char *name;
+	void (*fn) ( int );
+	void (*setup) ( void );
+	int batch;
+	int flags;
+	char *info;
+};
+
+/* bench flags */
+#define BENCH_NOIRQ	0x01	/* time it with interrupts off */
+#define BENCH_NOUSB	0x02	/* not while results go out on USB */
+
+/* how bench_run reports */
+#define BENCH_CSV	0x00
+#define BENCH_JSON	0x01
+#define BENCH_UART	0x00
+#define BENCH_USB	0x02
+
+void bench_add ( char *, void (*) ( int ), void (*) ( void ), int, int, char * );
+void bench_run ( char *, int );
+
+/* the sampling profiler, see prof.c */
+void prof_init ( int );
+void prof_start ( void );
+void prof_stop ( void );
+void prof_clear ( void );
+void prof_dump ( int );
+
+void nvic_priority ( int, int );
+void nvic_priority_all ( int );
+void nvic_priority_save ( void );
+void nvic_priority_restore ( void );
+
+/* see string.c, we have no libc */
+void *memcpy ( void *, const void *, __SIZE_TYPE__ );
+void *memmove ( void *, const void *, __SIZE_TYPE__ );
+void *memset ( void *, int, __SIZE_TYPE__ );
 
 /* Handy macros */
 
@@ -47,6 +464,15 @@ typedef void (*bfptr) ( char *, int );
  * You need to tell the compiler to optimize for these
  *  to actually go inline.
  */
+#ifdef HYDRA_HOST
+/* On Linux, interrupts only happen when we wait for one,
+ * see host_wfi() in host.c, so there is nothing to mask.
+ */
+static inline void irq_enable( void ) { }
+static inline void irq_disable( void ) { }
+static inline int irq_save( void ) { return 0; }
+static inline void irq_restore( int state ) { }
+#else
 static inline void irq_enable( void )
 {
   __asm__ __volatile__ ("cpsie i"); /* Clear PRIMASK */
@@ -57,6 +483,61 @@ static inline void irq_disable( void )
   __asm__ __volatile__ ("cpsid i"); /* Set PRIMASK */
 }
 
+/* For code that may be called with interrupts already
+ * masked (at interrupt level, say), this leaves them the
+ * way it found them:
+ *   state = irq_save ();
+ *   ...
+ *   irq_restore ( state );
+ */
+static inline int irq_save( void )
+{
+  int state;
+
+  __asm__ __volatile__ ("mrs %0, primask\n\tcpsid i" : "=r" (state) :: "memory");
+  return state;
+}
+
+static inline void irq_restore( int state )
+{
+  __asm__ __volatile__ ("msr primask, %0" :: "r" (state) : "memory");
+}
+#endif
+
+/* The DWT cycle counter (enabled in systick_init)
+ * It wraps every 25 seconds at 168 Mhz, which is fine for
+ * timing things that take less than that.
+ */
+#define DWT_CYCCNT	((volatile unsigned int *) 0xE0001004)
+
+#ifdef HYDRA_HOST
+/* The simulated chip, see host.c */
+void host_wfi ( void );
+void host_uart_tx ( int, int );
+void *host_ram ( void );
+
+/* Nanoseconds on Linux, get_cpu_hz() says 1 Ghz there */
+unsigned int host_cycles ( void );
+
+static inline unsigned int get_cycles ( void )
+{
+  return host_cycles ();
+}
+#elif defined(HYDRA_QEMU)
+/* QEMU has no DWT, see systick.c */
+unsigned int systick_cycles ( void );
+
+static inline unsigned int get_cycles ( void )
+{
+  return systick_cycles ();
+}
+#else
+static inline unsigned int get_cycles ( void )
+{
+  return *DWT_CYCCNT;
+}
+#endif
+
 /* This macro in particular, I am intending to discipline myself
  * to use more often.  It allows you to look at a datasheet and
  * just copy a bit number rather than working out a hex constant
@@ -66,4 +547,44 @@ static inline void irq_disable( void )
  */
 #define BIT(nr)		(1<<(nr))
 
+/* GPIO fast path.
+ * gpio_bit() and gpio_read() in gpio_xxx.c are real function
+ * calls that look up the base address in a table and work out
+ * shifts at run time.  These inline versions work out the BSRR
+ * or IDR address and mask in the compiler when gpio and pin are
+ * constants, so a pin change is a single store.
+ * The GPIO blocks are 0x400 apart on both chip families.
+ * The addresses go through unsigned long so the 64 bit host
+ * builds (host.c and Tools) don't warn about the cast.
+ */
+#ifdef CHIP_F103
+#define GPIO_PORT(g)	(0x40010800 + 0x400 * (g))
+#define GPIO_IDR(g)	((volatile unsigned int *) (unsigned long) (GPIO_PORT(g) + 0x08))
+#define GPIO_BSRR(g)	((volatile unsigned int *) (unsigned long) (GPIO_PORT(g) + 0x10))
+#else
+#define GPIO_PORT(g)	(0x40020000 + 0x400 * (g))
+#define GPIO_IDR(g)	((volatile unsigned int *) (unsigned long) (GPIO_PORT(g) + 0x10))
+#define GPIO_BSRR(g)	((volatile unsigned int *) (unsigned long) (GPIO_PORT(g) + 0x18))
+#endif
+
+/* Same sense as gpio_bit(), 1 drives the pin low */
+static inline void gpio_bit_fast ( int gpio, int pin, int val )
+{
+  *GPIO_BSRR(gpio) = val ? BIT(pin+16) : BIT(pin);
+}
+
+static inline int gpio_read_fast ( int gpio, int pin )
+{
+  return (*GPIO_IDR(gpio) >> pin) & 1;
+}
+
+/* Drive the pins in set_mask high and those in clear_mask low,
+ * all in one store (so all at once).
+ * If a pin is in both, the hardware lets set win.
+ */
+static inline void gpio_write_mask ( int gpio, unsigned int set_mask, unsigned int clear_mask )
+{
+  *GPIO_BSRR(gpio) = (clear_mask << 16) | (set_mask & 0xffff);
+}
+
 /* THE END */
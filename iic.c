@@ -1,493 +1,1096 @@
-/*
- * Copyright (C) 2016  Tom Trebisky  <tom@mmto.org>
- *
- * This program is free software; you can redistribute it and/or modify
- * it under the terms of the GNU General Public License version 2 as
- * published by the Free Software Foundation. See README and COPYING for
- * more details.
- */
-
-/* Tom Trebisky
- * 5-11-2016 - begun for ESP8266
- * 5-29-2016 - begin port for ARM/BBB/Kyu
- * 6-22-2016 - integrated under new i2c.c
- * 11-13-2020 - moved to libmaple-unwired
- * 12-4-2020 - moved to Hydra with big cleanup.
- *
- *  iic.c
- *
- *  Bit banging i2c library
- *    for the ESP8266 and for Kyu/BBB
- *
- * A key idea is that the sda and scl pins can be
- * specified as arguments to the initializer function.
- *
- * A fairly high level interface is presented as an API.
- *  low level code derived from i2c_master.c
- *
- * There are 3 functions in the API:
- *    void iic_init ( sda_gpio, sda_pin, sclk_gpio, sclk_pin );
- *    (previously -- ) void iic_init ( sda_pin, sclk_pin );
- *    int iic_send ( addr, unsigned char *, int );
- *    int iic_recv ( addr, unsigned char *, int );
- */
-
-typedef unsigned char uint8;
-
-/* For libmaple-unwired */
-// #define ARCH_MAPLE
-
-/* For Kyu */
-// #define ARCH_KYU
-
-/* For Hydra */
-#define ARCH_HYDRA
-
-#ifdef ARCH_HYDRA
-#define GPIO_INPUT(g,p)		gpio_input_config ( g, p )
-#define GPIO_OUTPUT(g,p)	gpio_output_od_config ( g, p )
-#define GPIO_READ(g,p)		gpio_read ( g, p )
-
-// #define GPIO_SET(g,p)	gpio_bit ( g, p, 1 )
-// #define GPIO_CLEAR(g,p)	gpio_bit ( g, p, 0 )
-#define GPIO_VAL(g,p,x)	gpio_bit ( g, p, x )
-#endif
-
-/* On the Maple/STM32, we have a handy upper layer on the more fundamental
- * lower gpio layer.  The lower layer requires a gpio device and pin.
- * The upper layer requires a single index that indexes pinmap transparently
- * hiding the details of device/pin.  So we use the upper layer.
- * (we abandon that in Hydra though)
- */
-
-#ifdef ARCH_MAPLE
-#include "serial.h"
-#include "time.h"
-#include "gpio.h"
-#include "io.h"
-
-#define GPIO_INPUT(x)	pinMode ( x, INPUT_FLOATING )
-#define GPIO_OUTPUT(x)	pinMode ( x, OUTPUT_OPEN_DRAIN )
-#define GPIO_READ(x)	digitalRead ( x )
-
-#define GPIO_SET(x)	digitalWrite ( x, 1 )
-#define GPIO_CLEAR(x)	digitalWrite ( x, 0 )
-#endif
-
-#ifdef ARCH_KYU
-#include "gpio.h"
-
-#define GPIO_INPUT(x)	gpio_dir_in ( x )
-#define GPIO_OUTPUT(x)	gpio_dir_out ( x )
-#define GPIO_READ(x)	gpio_read_bit ( x )
-
-#define GPIO_SET(x)	gpio_set_bit ( x )
-#define GPIO_CLEAR(x)	gpio_clear_bit ( x )
-#endif
-
-static void iic_setdc ( int, int );
-static void iic_dc ( int, int );
-static void iic_dc_wait ( int, int, int );
-static void iic_writeb ( int );
-static int iic_readb ( void );
-static void iic_setAck ( int );
-static int iic_getAck ( void );
-
-static void iic_start ( void );
-static void iic_stop ( void );
-static int iic_recv_byte ( int );
-static int iic_send_byte ( int );
-
-/* The following functions are all that a person
- * should ever need to use.
- */
-// void iic_init ( int, int );
-void iic_init ( int, int, int, int );
-int iic_send ( int, unsigned char *, int );
-int iic_recv ( int, unsigned char *, int );
-
-/* -------------------------------------------------- */
-
-/* Some notes on the i2c protocol
- * both signals are open drain.
- *  a device can pull a line low, but can never drive it high.
- * an idle bus has both sda and scl high
- * a start sequence pulls SDA low, with SCL left high
- * a stop sequence first raises SCL, then raises SDA
- *  (avoid changing SDS with SCL high to avoid false stops)
- * data is asserted after SCL falls, is sampled when SCL rises.
- */
-/* -------------------------------------------------- */
-
-/* For Hydra */
-static uint8 sda_gpio;
-static uint8 scl_gpio;
-
-static uint8 sda_pin;
-static uint8 scl_pin;
-
-static uint8 cur_sda;
-static uint8 cur_scl;
-
-#define MAX_BITS	28
-
-static void
-iic_bus_init ( void )
-{
-    int i;
-
-    iic_dc ( 1, 0 );
-
-    iic_dc ( 0, 0 );
-    iic_dc ( 1, 0 );
-
-    for (i = 0; i < MAX_BITS; i++) {
-	iic_dc ( 1, 0 );
-	iic_dc ( 1, 1 );
-    }
-
-    iic_stop();
-}
-
-/* This does whatever needs to be done to get the gpio
- * system into a state that lets us do what we need to do.
- * Hydra must take note of both gpio and pin for each
- */
-void 
-iic_init ( int sda_g, int sda_p, int scl_g, int scl_p )
-{
-    sda_gpio = sda_g;
-    sda_pin = sda_p;
-    scl_gpio = scl_g;
-    scl_pin = scl_p;
-
-    gpio_output_od_config ( sda_gpio, sda_pin );
-    gpio_output_od_config ( scl_gpio, scl_pin );
-
-    iic_setdc ( 1, 1 );
-    iic_bus_init ();
-}
-
-/* -------------------------------------------------- */
-
-/* These do not require 0/1 return values from GPIO_READ */
-static int
-iic_raw_bit ( void )
-{
-    // return GPIO_READ ( sda_pin ) ? 1 : 0;
-    return GPIO_READ ( sda_gpio, sda_pin ) ? 1 : 0;
-}
-
-static int
-iic_get_bit ( void )
-{
-    int rv;
-
-    // GPIO_INPUT ( sda_pin );
-    // rv = GPIO_READ ( sda_pin );
-    // GPIO_OUTPUT ( sda_pin );
-    GPIO_INPUT ( sda_gpio, sda_pin );
-    rv = GPIO_READ ( sda_gpio, sda_pin );
-    GPIO_OUTPUT ( sda_gpio, sda_pin );
-    return rv ? 1 : 0;
-}
-
-static void
-iic_setdc ( int sda, int scl )
-{
-    cur_sda = sda;
-    GPIO_VAL ( sda_gpio, sda_pin, sda );
-    /*
-    if ( sda ) {
-	GPIO_SET ( sda_pin );
-    } else {
-	GPIO_CLEAR ( sda_pin );
-    }
-    */
-
-    cur_scl = scl;
-    GPIO_VAL ( scl_gpio, scl_pin, scl );
-    /*
-    if ( scl ) {
-	GPIO_SET ( scl_pin );
-    } else {
-	GPIO_CLEAR ( scl_pin );
-    }
-    */
-}
-
-static void
-iic_setclk ( int scl )
-{
-    GPIO_VAL ( scl_gpio, scl_pin, scl );
-    /*
-    if ( scl ) {
-	GPIO_SET ( scl_pin );
-    } else {
-	GPIO_CLEAR ( scl_pin );
-    }
-    */
-}
-
-static void
-iic_dc ( int data, int clock )
-{
-    iic_setdc ( data, clock );
-    delay_us ( 5 );
-}
-
-static void
-iic_dc_wait ( int data, int clock, int wait )
-{
-    iic_setdc ( data, clock );
-    delay_us ( wait );
-}
-
-static void
-iic_start(void)
-{
-    iic_dc ( 1, cur_scl );
-    iic_dc ( 1, 1 );
-    iic_dc ( 0, 1 );
-}
-
-static void
-iic_stop(void)
-{
-    delay_us (5);
-
-    iic_dc ( 0, cur_scl );
-    iic_dc ( 0, 1 );
-    iic_dc ( 1, 1 );
-}
-
-static void
-iic_setAck ( int level )
-{
-    iic_dc ( cur_sda, 0 );
-    iic_dc ( level, 0 );
-    iic_dc ( level, 1 );
-    iic_dc ( level, 0 );
-    iic_dc ( 1, 0 );
-}
-
-static int
-iic_getAck ( void )
-{
-    int rv;
-
-    iic_dc ( cur_sda, 0 );
-    iic_dc ( 1, 0 );
-    iic_dc ( 1, 1 );
-
-    rv = iic_get_bit ();
-    delay_us (5);
-
-    iic_dc ( 1, 0 );
-
-    return rv;
-}
-
-/* XXX - why even manipulate the sda pin when reading ?? */
-/* We send the Ack outside of this routine */
-static int
-iic_readb ( void )
-{
-    int rv = 0;
-    int i;
-
-    // GPIO_INPUT ( sda_pin );
-    GPIO_INPUT ( sda_gpio, sda_pin );
-
-    delay_us (5);
-
-    iic_dc ( cur_sda, 0 );
-
-    for (i = 0; i < 8; i++) {
-        delay_us (5);
-	iic_dc ( 1, 0 );
-	iic_dc ( 1, 1 );
-
-        rv |= iic_get_bit() << (7-i);
-
-	iic_dc_wait ( 1, 1, i == 7 ? 8 : 5 );
-    }
-
-    // GPIO_OUTPUT ( sda_pin );
-    GPIO_OUTPUT ( sda_gpio, sda_pin );
-
-    iic_dc ( 1, 0 );
-
-    return rv;
-}
-
-/* ARM */
-static void
-iic_watch ( int delay )
-{
-    int i;
-    int val;
-
-    for ( i=0; i<delay; i++ ) {
-        val = iic_raw_bit();
-	printf ( "SDA = %d\n", val );
-	delay_us ( 1 );
-    }
-}
-
-/* ARM */
-static void
-iic_clk_d ( int clk, int delay )
-{
-    iic_setclk ( clk );
-    iic_watch ( delay );
-}
-
-/* ARM */
-static int
-iic_readbx ( void )
-{
-    int rv = 0;
-    int i;
-    int val;
-
-    // GPIO_INPUT ( sda_pin );
-    GPIO_INPUT ( sda_gpio, sda_pin );
-
-    delay_us (5);
-
-    // iic_dc ( cur_sda, 0 );
-    iic_clk_d ( 0, 5 );
-
-    for (i = 0; i < 8; i++) {
-        // delay_us (5);
-	iic_watch ( 5 );
-	// iic_dc ( 1, 0 );
-	iic_clk_d ( 0, 5 );
-	// iic_dc ( 1, 1 );
-	iic_clk_d ( 1, 5 );
-
-        // rv |= GPIO_READ( sda_pin ) << (7-i);
-        val = iic_raw_bit();
-	rv |= val << (7-i);
-	printf ( "*SDA = %d\n", val );
-
-	// iic_dc_wait ( 1, 1, i == 7 ? 8 : 5 );
-	iic_clk_d ( 1, i == 7 ? 8 : 5 );
-    }
-
-    // GPIO_OUTPUT ( sda_pin );
-    GPIO_OUTPUT ( sda_gpio, sda_pin );
-
-    iic_dc ( 1, 0 );
-
-    return rv;
-}
-
-static void
-iic_writeb ( int data )
-{
-    int bit;
-    int i;
-
-    delay_us (5);
-
-    iic_dc ( cur_sda, 0 );
-
-    for (i = 7; i >= 0; i--) {
-        // bit = data >> i;
-        bit = (data >> i) & 1;
-	iic_dc ( bit, 0 );
-	iic_dc_wait ( bit, 1, i == 0 ? 8 : 5 );
-	iic_dc ( bit, 0 );
-    }
-}
-
-static int
-iic_send_byte ( int byte )
-{
-	int ack;
-
-	iic_writeb ( byte );
-	ack = iic_getAck();
-	if ( ack ) {
-	    iic_stop();
-	    return 1;
-	}
-	return 0;
-}
-
-/* XXX - useful when debugging
- *  but not what I would want when in production.
- */
-static int
-iic_send_byte_m ( int byte, char *msg )
-{
-	int ack;
-
-	iic_writeb ( byte );
-	ack = iic_getAck();
-	if ( ack ) {
-	    printf("IIC: No ack after sending %s\n", msg);
-	    iic_stop();
-	    return 1;
-	}
-	return 0;
-}
-
-static int
-iic_recv_byte ( int ack )
-{
-	int rv;
-
-	rv = iic_readb();
-	iic_setAck ( ack );
-	return rv;
-}
-
-/* ----------------------------------------------------------- */
-/* Higher level iic routines */
-/* ----------------------------------------------------------- */
-
-#define IIC_WADDR(a)	(a << 1)
-#define IIC_RADDR(a)	((a << 1) | 1)
-
-/* raw write an array of bytes (8 bit objects)
- * for a device without registers (like the MCP4725)
- */
-int
-iic_send ( int addr, unsigned char *buf, int n )
-{
-	int i;
-
-	iic_start();
-	if ( iic_send_byte_m ( IIC_WADDR(addr), "W address" ) ) return 1;
-	for ( i = 0; i < n; i++ ) {
-		if ( iic_send_byte_m ( buf[i], "reg" ) ) return 1;
-	}
-	iic_stop();
-
-	return 0;
-}
-
-/* raw read an array of bytes (8 bit objects)
- * for a device without registers (like the MCP4725)
- */
-int
-iic_recv ( int addr, unsigned char *buf, int n )
-{
-	int i;
-
-	iic_start();
-	if ( iic_send_byte_m ( IIC_RADDR(addr), "R address" ) ) return 1;
-
-	for ( i=0; i < n; i++ ) {
-		*buf++ = iic_recv_byte ( i == n - 1 ? 1 : 0 );
-	}
-
-	iic_stop();
-
-	return 0;
-}
-
-/* THE END */
+/*
+ * Copyright (C) 2016  Tom Trebisky  <tom@mmto.org>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation. See README and COPYING for
+ * more details.
+ */
+
+/* Tom Trebisky
+ * 5-11-2016 - begun for ESP8266
+ * 5-29-2016 - begin port for ARM/BBB/Kyu
+ * 6-22-2016 - integrated under new i2c.c
+ * 11-13-2020 - moved to libmaple-unwired
+ * 12-4-2020 - moved to Hydra with big cleanup.
+ *
+ *  iic.c
+ *
+ *  Bit banging i2c library
+ *    for the ESP8266 and for Kyu/BBB
+ *
+ * A key idea is that the sda and scl pins can be
+ * specified as arguments to the initializer function.
+ *
+ * A fairly high level interface is presented as an API.
+ *  low level code derived from i2c_master.c
+ *
+ * There are 3 functions in the API:
+ *    void iic_init ( sda_gpio, sda_pin, sclk_gpio, sclk_pin );
+ *    (previously -- ) void iic_init ( sda_pin, sclk_pin );
+ *    int iic_send ( addr, unsigned char *, int );
+ *    int iic_recv ( addr, unsigned char *, int );
+ *
+ * Each of these works on a default bus.  There can be several
+ * buses, each described by an iic_bus_t, and every call above
+ * has an iic_bus_xxx() twin that takes the bus as its first
+ * argument.  Each bus has its own speed (100k, 400k, 1M).
+ *
+ * Added 2026 for devices with registers (most sensors):
+ *    int iic_write_reg ( addr, reg, val );
+ *    int iic_write_regs ( addr, reg, unsigned char *, int );
+ *    int iic_read_reg ( addr, reg );
+ *    int iic_read_regs ( addr, reg, unsigned char *, int );
+ *    int iic_xfer ( addr, struct iic_seg *, int );
+ *
+ * And an interrupt driven engine (a bus gets a timer):
+ *    void iic_bus_async ( iic_bus_t *, timer );
+ *    void iic_bus_submit ( iic_bus_t *, struct iic_xact * );
+ *    int iic_wait ( struct iic_xact * );
+ */
+
+typedef unsigned char uint8;
+
+/* For libmaple-unwired */
+// #define ARCH_MAPLE
+
+/* For Kyu */
+// #define ARCH_KYU
+
+/* For Hydra */
+#define ARCH_HYDRA
+
+#ifdef ARCH_HYDRA
+#include "hydra.h"
+
+#define GPIO_INPUT(g,p)		gpio_input_config ( g, p )
+#define GPIO_OUTPUT(g,p)	gpio_output_od_config ( g, p )
+// #define GPIO_READ(g,p)	gpio_read ( g, p )
+#define GPIO_READ(g,p)		gpio_read_fast ( g, p )
+
+// #define GPIO_SET(g,p)	gpio_bit ( g, p, 1 )
+// #define GPIO_CLEAR(g,p)	gpio_bit ( g, p, 0 )
+// #define GPIO_VAL(g,p,x)	gpio_bit ( g, p, x )
+#define GPIO_VAL(g,p,x)	gpio_bit_fast ( g, p, x )
+#endif
+
+/* On the Maple/STM32, we have a handy upper layer on the more fundamental
+ * lower gpio layer.  The lower layer requires a gpio device and pin.
+ * The upper layer requires a single index that indexes pinmap transparently
+ * hiding the details of device/pin.  So we use the upper layer.
+ * (we abandon that in Hydra though)
+ */
+
+#ifdef ARCH_MAPLE
+#include "serial.h"
+#include "time.h"
+#include "gpio.h"
+#include "io.h"
+
+#define GPIO_INPUT(x)	pinMode ( x, INPUT_FLOATING )
+#define GPIO_OUTPUT(x)	pinMode ( x, OUTPUT_OPEN_DRAIN )
+#define GPIO_READ(x)	digitalRead ( x )
+
+#define GPIO_SET(x)	digitalWrite ( x, 1 )
+#define GPIO_CLEAR(x)	digitalWrite ( x, 0 )
+#endif
+
+#ifdef ARCH_KYU
+#include "gpio.h"
+
+#define GPIO_INPUT(x)	gpio_dir_in ( x )
+#define GPIO_OUTPUT(x)	gpio_dir_out ( x )
+#define GPIO_READ(x)	gpio_read_bit ( x )
+
+#define GPIO_SET(x)	gpio_set_bit ( x )
+#define GPIO_CLEAR(x)	gpio_clear_bit ( x )
+#endif
+
+static void iic_setdc ( iic_bus_t *, int, int );
+static void iic_dc ( iic_bus_t *, int, int );
+static void iic_dc_wait ( iic_bus_t *, int, int, int );
+static void iic_writeb ( iic_bus_t *, int );
+static int iic_readb ( iic_bus_t * );
+static void iic_setAck ( iic_bus_t *, int );
+static int iic_getAck ( iic_bus_t * );
+
+static void iic_start ( iic_bus_t * );
+static void iic_stop ( iic_bus_t * );
+static int iic_recv_byte ( iic_bus_t *, int );
+static int iic_send_byte ( iic_bus_t *, int );
+
+/* The following functions are all that a person
+ * should ever need to use.
+ */
+// void iic_init ( int, int );
+void iic_init ( int, int, int, int );
+int iic_send ( int, unsigned char *, int );
+int iic_recv ( int, unsigned char *, int );
+int iic_xfer ( int, struct iic_seg *, int );
+
+void iic_bus_init ( iic_bus_t *, int, int, int, int, int );
+void iic_bus_speed ( iic_bus_t *, int );
+int iic_bus_send ( iic_bus_t *, int, unsigned char *, int );
+int iic_bus_recv ( iic_bus_t *, int, unsigned char *, int );
+int iic_bus_byte ( iic_bus_t *, int );
+int iic_bus_xfer ( iic_bus_t *, int, struct iic_seg *, int );
+void iic_bus_async ( iic_bus_t *, int );
+void iic_bus_submit ( iic_bus_t *, struct iic_xact * );
+int iic_wait ( struct iic_xact * );
+
+/* -------------------------------------------------- */
+
+/* Some notes on the i2c protocol
+ * both signals are open drain.
+ *  a device can pull a line low, but can never drive it high.
+ * an idle bus has both sda and scl high
+ * a start sequence pulls SDA low, with SCL left high
+ * a stop sequence first raises SCL, then raises SDA
+ *  (avoid changing SDS with SCL high to avoid false stops)
+ * data is asserted after SCL falls, is sampled when SCL rises.
+ */
+/* -------------------------------------------------- */
+
+/* For Hydra -- the bus used by the old single bus calls */
+static iic_bus_t iic_default;
+
+/* Speed profiles.
+ * Each protocol step (iic_dc) waits one "step" time.
+ * A data bit is three steps, SCL low for two of them
+ * and high for one, so the step is about a third of the
+ * clock period.  The high time must still meet the spec
+ * minimum (4.0, 0.6, 0.26 us), which is what limits the
+ * 100 kHz profile to about 83 kHz.
+ * The 9th clock (where a slave may want a moment) gets
+ * a step and a half.
+ * Previously the step was a fixed delay_us(5).
+ */
+static const int iic_step_ns[] = {
+    4000,	/* IIC_100K */
+    830,	/* IIC_400K */
+    330		/* IIC_1M */
+};
+
+#define MAX_BITS	28
+
+static void
+iic_bus_reset ( iic_bus_t *bp )
+{
+    int i;
+
+    iic_dc ( bp, 1, 0 );
+
+    iic_dc ( bp, 0, 0 );
+    iic_dc ( bp, 1, 0 );
+
+    for (i = 0; i < MAX_BITS; i++) {
+	iic_dc ( bp, 1, 0 );
+	iic_dc ( bp, 1, 1 );
+    }
+
+    iic_stop ( bp );
+}
+
+/* Recompute the delay loop counts for a bus.
+ * The counts come from the CPU clock, so this should be
+ * called again if the CPU clock ever changes.
+ */
+void
+iic_bus_speed ( iic_bus_t *bp, int speed )
+{
+    int ns;
+
+    if ( speed < IIC_100K || speed > IIC_1M )
+	speed = IIC_100K;
+
+    ns = iic_step_ns[speed];
+
+    bp->speed = speed;
+    bp->step = delay_ns_count ( ns );
+    bp->step9 = delay_ns_count ( ns + ns / 2 );
+
+    if ( bp->timer >= 0 )
+	timer_rate ( bp->timer, 1000000000 / ns );
+}
+
+/* Every bus we set up, so we can redo the delay
+ * counts when the CPU clock changes (see rcc_notify).
+ */
+#define MAX_BUSES	4
+
+static iic_bus_t *iic_buses[MAX_BUSES];
+static int num_buses;
+
+static void
+iic_clock ( int what )
+{
+    int i;
+
+    if ( what != RCC_CHANGED )
+	return;
+
+    for ( i=0; i<num_buses; i++ )
+	iic_bus_speed ( iic_buses[i], iic_buses[i]->speed );
+}
+
+static void
+iic_bus_remember ( iic_bus_t *bp )
+{
+    int i;
+
+    for ( i=0; i<num_buses; i++ )
+	if ( iic_buses[i] == bp )
+	    return;
+
+    if ( num_buses == 0 )
+	rcc_notify ( iic_clock );
+
+    if ( num_buses < MAX_BUSES )
+	iic_buses[num_buses++] = bp;
+}
+
+/* This does whatever needs to be done to get the gpio
+ * system into a state that lets us do what we need to do.
+ * Hydra must take note of both gpio and pin for each
+ */
+void
+iic_bus_init ( iic_bus_t *bp, int sda_g, int sda_p, int scl_g, int scl_p, int speed )
+{
+    bp->sda_gpio = sda_g;
+    bp->sda_pin = sda_p;
+    bp->scl_gpio = scl_g;
+    bp->scl_pin = scl_p;
+
+    bp->timer = -1;
+    bp->cur = bp->head = bp->tail = (struct iic_xact *) 0;
+    bp->naks = 0;
+
+    iic_bus_speed ( bp, speed );
+    iic_bus_remember ( bp );
+
+    gpio_output_od_config ( bp->sda_gpio, bp->sda_pin );
+    gpio_output_od_config ( bp->scl_gpio, bp->scl_pin );
+
+    iic_setdc ( bp, 1, 1 );
+    iic_bus_reset ( bp );
+}
+
+void 
+iic_init ( int sda_g, int sda_p, int scl_g, int scl_p )
+{
+    iic_bus_init ( &iic_default, sda_g, sda_p, scl_g, scl_p, IIC_100K );
+}
+
+/* -------------------------------------------------- */
+
+/* These do not require 0/1 return values from GPIO_READ */
+static int
+iic_raw_bit ( iic_bus_t *bp )
+{
+    // return GPIO_READ ( sda_pin ) ? 1 : 0;
+    return GPIO_READ ( bp->sda_gpio, bp->sda_pin ) ? 1 : 0;
+}
+
+static int
+iic_get_bit ( iic_bus_t *bp )
+{
+    int rv;
+
+    // GPIO_INPUT ( sda_pin );
+    // rv = GPIO_READ ( sda_pin );
+    // GPIO_OUTPUT ( sda_pin );
+    GPIO_INPUT ( bp->sda_gpio, bp->sda_pin );
+    rv = GPIO_READ ( bp->sda_gpio, bp->sda_pin );
+    GPIO_OUTPUT ( bp->sda_gpio, bp->sda_pin );
+    return rv ? 1 : 0;
+}
+
+static void
+iic_setdc ( iic_bus_t *bp, int sda, int scl )
+{
+    bp->cur_sda = sda;
+    GPIO_VAL ( bp->sda_gpio, bp->sda_pin, sda );
+
+    bp->cur_scl = scl;
+    GPIO_VAL ( bp->scl_gpio, bp->scl_pin, scl );
+}
+
+static void
+iic_setclk ( iic_bus_t *bp, int scl )
+{
+    GPIO_VAL ( bp->scl_gpio, bp->scl_pin, scl );
+}
+
+static void
+iic_dc ( iic_bus_t *bp, int data, int clock )
+{
+    iic_setdc ( bp, data, clock );
+    delay_count ( bp->step );
+}
+
+static void
+iic_dc_wait ( iic_bus_t *bp, int data, int clock, int wait )
+{
+    iic_setdc ( bp, data, clock );
+    delay_count ( wait );
+}
+
+static void
+iic_start ( iic_bus_t *bp )
+{
+    iic_dc ( bp, 1, bp->cur_scl );
+    iic_dc ( bp, 1, 1 );
+    iic_dc ( bp, 0, 1 );
+}
+
+static void
+iic_stop ( iic_bus_t *bp )
+{
+    delay_count ( bp->step );
+
+    iic_dc ( bp, 0, bp->cur_scl );
+    iic_dc ( bp, 0, 1 );
+    iic_dc ( bp, 1, 1 );
+}
+
+static void
+iic_setAck ( iic_bus_t *bp, int level )
+{
+    iic_dc ( bp, bp->cur_sda, 0 );
+    iic_dc ( bp, level, 0 );
+    iic_dc ( bp, level, 1 );
+    iic_dc ( bp, level, 0 );
+    iic_dc ( bp, 1, 0 );
+}
+
+static int
+iic_getAck ( iic_bus_t *bp )
+{
+    int rv;
+
+    iic_dc ( bp, bp->cur_sda, 0 );
+    iic_dc ( bp, 1, 0 );
+    iic_dc ( bp, 1, 1 );
+
+    rv = iic_get_bit ( bp );
+    delay_count ( bp->step );
+
+    iic_dc ( bp, 1, 0 );
+
+    return rv;
+}
+
+/* XXX - why even manipulate the sda pin when reading ?? */
+/* We send the Ack outside of this routine */
+static int
+iic_readb ( iic_bus_t *bp )
+{
+    int rv = 0;
+    int i;
+
+    // GPIO_INPUT ( sda_pin );
+    GPIO_INPUT ( bp->sda_gpio, bp->sda_pin );
+
+    delay_count ( bp->step );
+
+    iic_dc ( bp, bp->cur_sda, 0 );
+
+    for (i = 0; i < 8; i++) {
+        delay_count ( bp->step );
+	iic_dc ( bp, 1, 0 );
+	iic_dc ( bp, 1, 1 );
+
+        rv |= iic_get_bit ( bp ) << (7-i);
+
+	iic_dc_wait ( bp, 1, 1, i == 7 ? bp->step9 : bp->step );
+    }
+
+    // GPIO_OUTPUT ( sda_pin );
+    GPIO_OUTPUT ( bp->sda_gpio, bp->sda_pin );
+
+    iic_dc ( bp, 1, 0 );
+
+    return rv;
+}
+
+/* ARM */
+static void
+iic_watch ( iic_bus_t *bp, int delay )
+{
+    int i;
+    int val;
+
+    for ( i=0; i<delay; i++ ) {
+        val = iic_raw_bit ( bp );
+	printf ( "SDA = %d\n", val );
+	delay_us ( 1 );
+    }
+}
+
+/* ARM */
+static void
+iic_clk_d ( iic_bus_t *bp, int clk, int delay )
+{
+    iic_setclk ( bp, clk );
+    iic_watch ( bp, delay );
+}
+
+/* ARM */
+static int
+iic_readbx ( iic_bus_t *bp )
+{
+    int rv = 0;
+    int i;
+    int val;
+
+    // GPIO_INPUT ( sda_pin );
+    GPIO_INPUT ( bp->sda_gpio, bp->sda_pin );
+
+    delay_us (5);
+
+    // iic_dc ( cur_sda, 0 );
+    iic_clk_d ( bp, 0, 5 );
+
+    for (i = 0; i < 8; i++) {
+        // delay_us (5);
+	iic_watch ( bp, 5 );
+	// iic_dc ( 1, 0 );
+	iic_clk_d ( bp, 0, 5 );
+	// iic_dc ( 1, 1 );
+	iic_clk_d ( bp, 1, 5 );
+
+        // rv |= GPIO_READ( sda_pin ) << (7-i);
+        val = iic_raw_bit ( bp );
+	rv |= val << (7-i);
+	printf ( "*SDA = %d\n", val );
+
+	// iic_dc_wait ( 1, 1, i == 7 ? 8 : 5 );
+	iic_clk_d ( bp, 1, i == 7 ? 8 : 5 );
+    }
+
+    // GPIO_OUTPUT ( sda_pin );
+    GPIO_OUTPUT ( bp->sda_gpio, bp->sda_pin );
+
+    iic_dc ( bp, 1, 0 );
+
+    return rv;
+}
+
+static void
+iic_writeb ( iic_bus_t *bp, int data )
+{
+    int bit;
+    int i;
+
+    delay_count ( bp->step );
+
+    iic_dc ( bp, bp->cur_sda, 0 );
+
+    for (i = 7; i >= 0; i--) {
+        // bit = data >> i;
+        bit = (data >> i) & 1;
+	iic_dc ( bp, bit, 0 );
+	iic_dc_wait ( bp, bit, 1, i == 0 ? bp->step9 : bp->step );
+	iic_dc ( bp, bit, 0 );
+    }
+}
+
+/* No printf here when nobody acks, this can run from a
+ * timer or systick callback.  Just count it in bp->naks.
+ */
+static int
+iic_send_byte ( iic_bus_t *bp, int byte )
+{
+	int ack;
+
+	iic_writeb ( bp, byte );
+	ack = iic_getAck ( bp );
+	if ( ack ) {
+	    bp->naks++;
+	    iic_stop ( bp );
+	    return 1;
+	}
+	return 0;
+}
+
+static int
+iic_recv_byte ( iic_bus_t *bp, int ack )
+{
+	int rv;
+
+	rv = iic_readb ( bp );
+	iic_setAck ( bp, ack );
+	return rv;
+}
+
+/* ----------------------------------------------------------- */
+/* Higher level iic routines */
+/* ----------------------------------------------------------- */
+
+#define IIC_WADDR(a)	(a << 1)
+#define IIC_RADDR(a)	((a << 1) | 1)
+
+/* raw write an array of bytes (8 bit objects)
+ * for a device without registers (like the MCP4725)
+ */
+int
+iic_bus_send ( iic_bus_t *bp, int addr, unsigned char *buf, int n )
+{
+	int i;
+
+	iic_start ( bp );
+	if ( iic_send_byte ( bp, IIC_WADDR(addr) ) ) return 1;
+	for ( i = 0; i < n; i++ ) {
+		if ( iic_send_byte ( bp, buf[i] ) ) return 1;
+	}
+	iic_stop ( bp );
+
+	return 0;
+}
+
+/* Clock one byte out and read the ack bit, with no START
+ * or STOP, so nobody on the bus takes any notice.
+ * This is the byte time benchmark in bench.c
+ * Returns the ack bit (0 if somebody did ack).
+ */
+int
+iic_bus_byte ( iic_bus_t *bp, int byte )
+{
+	iic_writeb ( bp, byte );
+	return iic_getAck ( bp );
+}
+
+/* raw read an array of bytes (8 bit objects)
+ * for a device without registers (like the MCP4725)
+ */
+int
+iic_bus_recv ( iic_bus_t *bp, int addr, unsigned char *buf, int n )
+{
+	int i;
+
+	iic_start ( bp );
+	if ( iic_send_byte ( bp, IIC_RADDR(addr) ) ) return 1;
+
+	for ( i=0; i < n; i++ ) {
+		*buf++ = iic_recv_byte ( bp, i == n - 1 ? 1 : 0 );
+	}
+
+	iic_stop ( bp );
+
+	return 0;
+}
+
+/* ----------------------------------------------------------- */
+/* Combined transactions */
+/* ----------------------------------------------------------- */
+
+/* Without a START there is no address byte, so there is no
+ * way to turn the bus around.  A NOSTART segment must go the
+ * same direction as the one before it.  (A NOSTART on the
+ * first segment is ignored, that one always gets a START.)
+ * We check this before touching the bus.
+ */
+static int
+iic_segs_ok ( struct iic_seg *segs, int nseg )
+{
+	int i;
+
+	for ( i = 1; i < nseg; i++ ) {
+	    if ( ! (segs[i].flags & IIC_SEG_NOSTART) )
+		continue;
+	    if ( (segs[i].flags & IIC_SEG_READ) != (segs[i-1].flags & IIC_SEG_READ) )
+		return 0;
+	}
+	return 1;
+}
+
+/* A transaction is a list of segments, each of which is a
+ * read or a write of some bytes.  The whole list goes out as
+ * a single bus transaction, with one STOP at the very end.
+ * Each segment normally begins with a (repeated) START and the
+ * address byte, but a segment flagged IIC_SEG_NOSTART just
+ * continues the previous one in the same direction.
+ * This lets a register pointer and a data block live in
+ * separate buffers without copying them together.
+ *
+ * Nothing in the segment list is specific to bit banging,
+ * so a driver for the hardware i2c can accept the same list.
+ *
+ * The last byte of a read gets a NAK, unless the next
+ * segment continues the read.
+ * Returns 0 on success, 1 if any byte fails to get an ACK
+ * (in which case the bus has already been stopped), or
+ * IIC_BADSEG if the list is no good (see iic_segs_ok).
+ */
+int
+iic_bus_xfer ( iic_bus_t *bp, int addr, struct iic_seg *segs, int nseg )
+{
+	struct iic_seg *sp;
+	unsigned char *p;
+	int cont;
+	int i, n;
+
+	if ( ! iic_segs_ok ( segs, nseg ) )
+	    return IIC_BADSEG;
+
+	for ( i = 0; i < nseg; i++ ) {
+	    sp = &segs[i];
+
+	    if ( i == 0 || ! (sp->flags & IIC_SEG_NOSTART) ) {
+		iic_start ( bp );
+		if ( sp->flags & IIC_SEG_READ ) {
+		    if ( iic_send_byte ( bp, IIC_RADDR(addr) ) ) return 1;
+		} else {
+		    if ( iic_send_byte ( bp, IIC_WADDR(addr) ) ) return 1;
+		}
+	    }
+
+	    cont = i < nseg - 1 && (segs[i+1].flags & IIC_SEG_NOSTART);
+
+	    p = sp->buf;
+	    if ( sp->flags & IIC_SEG_READ ) {
+		for ( n = 0; n < sp->len; n++ )
+		    *p++ = iic_recv_byte ( bp, n == sp->len - 1 && ! cont ? 1 : 0 );
+	    } else {
+		for ( n = 0; n < sp->len; n++ )
+		    if ( iic_send_byte ( bp, *p++ ) ) return 1;
+	    }
+	}
+
+	iic_stop ( bp );
+
+	return 0;
+}
+
+/* Write a single 8 bit register */
+int
+iic_bus_write_reg ( iic_bus_t *bp, int addr, int reg, int val )
+{
+	unsigned char buf[2];
+
+	buf[0] = reg;
+	buf[1] = val;
+	return iic_bus_send ( bp, addr, buf, 2 );
+}
+
+/* Write a block of registers, starting at reg.
+ * Most devices auto-increment the register pointer.
+ */
+int
+iic_bus_write_regs ( iic_bus_t *bp, int addr, int reg, unsigned char *buf, int n )
+{
+	struct iic_seg seg[2];
+	unsigned char r = reg;
+
+	seg[0].flags = IIC_SEG_WRITE;
+	seg[0].buf = &r;
+	seg[0].len = 1;
+
+	seg[1].flags = IIC_SEG_WRITE | IIC_SEG_NOSTART;
+	seg[1].buf = buf;
+	seg[1].len = n;
+
+	return iic_bus_xfer ( bp, addr, seg, 2 );
+}
+
+/* Burst read a block of registers, starting at reg.
+ * This writes the register pointer, then does a repeated
+ * START and reads, all without a STOP in between.
+ * Previously this took an iic_send() and an iic_recv(),
+ * each with its own START, address, and STOP.
+ */
+int
+iic_bus_read_regs ( iic_bus_t *bp, int addr, int reg, unsigned char *buf, int n )
+{
+	struct iic_seg seg[2];
+	unsigned char r = reg;
+
+	seg[0].flags = IIC_SEG_WRITE;
+	seg[0].buf = &r;
+	seg[0].len = 1;
+
+	seg[1].flags = IIC_SEG_READ;
+	seg[1].buf = buf;
+	seg[1].len = n;
+
+	return iic_bus_xfer ( bp, addr, seg, 2 );
+}
+
+/* Read a single 8 bit register.
+ * Returns -1 on error.
+ */
+int
+iic_bus_read_reg ( iic_bus_t *bp, int addr, int reg )
+{
+	unsigned char val;
+
+	if ( iic_bus_read_regs ( bp, addr, reg, &val, 1 ) )
+	    return -1;
+	return val;
+}
+
+/* ----------------------------------------------------------- */
+/* Interrupt driven engine */
+/* ----------------------------------------------------------- */
+
+/* The calls above spin in delay loops for the whole transaction.
+ * The engine here runs the same protocol as a state machine,
+ * one protocol step per interrupt from a hardware timer, so
+ * the mainline code keeps running while the bus is busy.
+ * Transactions get queued on the bus and each one calls
+ * its done() function (at interrupt level) when it finishes.
+ * The timer only runs while there is something to do.
+ *
+ * The timer runs at one tick per step, so 250 kHz for the
+ * 100 kHz profile (4000 ns steps).  That is fine on the F4
+ * at 96 or 168 Mhz, but the 400k and 1M profiles would need
+ * an interrupt every 50 to 150 cycles, so those really only
+ * make sense with the blocking calls.
+ *
+ * Don't mix the blocking calls and the engine on one bus.
+ */
+
+enum { IA_IDLE, IA_START, IA_WBIT, IA_WACK, IA_RBIT, IA_RACK, IA_STOP };
+
+static void
+ia_phase ( iic_bus_t *bp, int phase )
+{
+	bp->phase = phase;
+	bp->tick = 0;
+}
+
+/* Figure out what comes next, after the address or
+ * a data byte (along with its ack) has gone by.
+ */
+static void
+ia_next ( iic_bus_t *bp )
+{
+	struct iic_xact *xp = bp->cur;
+	struct iic_seg *sp;
+
+	for ( ;; ) {
+	    if ( bp->seg >= xp->nseg ) {
+		ia_phase ( bp, IA_STOP );
+		return;
+	    }
+
+	    sp = &xp->segs[bp->seg];
+
+	    /* idx is -1 until the address has gone out */
+	    if ( bp->idx < 0 ) {
+		if ( bp->seg == 0 || ! (sp->flags & IIC_SEG_NOSTART) ) {
+		    ia_phase ( bp, IA_START );
+		    return;
+		}
+		bp->idx = 0;
+	    }
+
+	    if ( bp->idx < sp->len ) {
+		bp->bit = 8;
+		if ( sp->flags & IIC_SEG_READ ) {
+		    bp->byte = 0;
+		    ia_phase ( bp, IA_RBIT );
+		} else {
+		    bp->byte = sp->buf[bp->idx];
+		    ia_phase ( bp, IA_WBIT );
+		}
+		return;
+	    }
+
+	    bp->seg++;
+	    bp->idx = -1;
+	}
+}
+
+static void
+ia_begin ( iic_bus_t *bp )
+{
+	bp->cur = bp->head;
+	bp->head = bp->cur->next;
+	if ( ! bp->head )
+	    bp->tail = (struct iic_xact *) 0;
+
+	bp->seg = 0;
+	bp->idx = -1;
+	bp->nak = 0;
+	ia_next ( bp );
+
+	timer_start ( bp->timer );
+}
+
+static void
+ia_finish ( iic_bus_t *bp )
+{
+	struct iic_xact *xp = bp->cur;
+
+	xp->status = bp->nak;
+	bp->cur = (struct iic_xact *) 0;
+
+	/* Get the next one going before calling back
+	 * so there is no gap on the bus.
+	 */
+	if ( bp->head )
+	    ia_begin ( bp );
+	else {
+	    timer_stop ( bp->timer );
+	    ia_phase ( bp, IA_IDLE );
+	}
+
+	if ( xp->done )
+	    (*xp->done) ( xp );
+}
+
+/* The timer hook.
+ * Each call does one step, just as one iic_dc() call
+ * does in the blocking code.
+ */
+static void
+ia_tick ( void *arg )
+{
+	iic_bus_t *bp = (iic_bus_t *) arg;
+	struct iic_xact *xp = bp->cur;
+	struct iic_seg *sp;
+	int t = bp->tick++;
+	int v;
+
+	if ( ! xp )
+	    return;
+
+	/* seg runs off the end once we get to the STOP */
+	sp = &xp->segs[bp->seg < xp->nseg ? bp->seg : 0];
+
+	switch ( bp->phase ) {
+	case IA_START:
+	    if ( t == 0 )
+		iic_setdc ( bp, 1, bp->cur_scl );
+	    else if ( t == 1 )
+		iic_setdc ( bp, 1, 1 );
+	    else {
+		iic_setdc ( bp, 0, 1 );
+		if ( sp->flags & IIC_SEG_READ )
+		    bp->byte = IIC_RADDR(xp->addr);
+		else
+		    bp->byte = IIC_WADDR(xp->addr);
+		bp->bit = 8;
+		ia_phase ( bp, IA_WBIT );
+	    }
+	    break;
+
+	case IA_WBIT:
+	    if ( bp->bit == 8 ) {
+		/* drop the clock before SDA changes */
+		iic_setdc ( bp, bp->cur_sda, 0 );
+		bp->bit = 7;
+		bp->tick = 0;
+		break;
+	    }
+	    v = (bp->byte >> bp->bit) & 1;
+	    if ( t == 0 )
+		iic_setdc ( bp, v, 0 );
+	    else if ( t == 1 )
+		iic_setdc ( bp, v, 1 );
+	    else {
+		iic_setdc ( bp, v, 0 );
+		bp->tick = 0;
+		if ( bp->bit-- == 0 )
+		    ia_phase ( bp, IA_WACK );
+	    }
+	    break;
+
+	case IA_WACK:
+	    if ( t == 0 )
+		iic_setdc ( bp, 1, 0 );
+	    else if ( t == 1 )
+		iic_setdc ( bp, 1, 1 );
+	    else {
+		bp->nak = iic_get_bit ( bp );
+		iic_setdc ( bp, 1, 0 );
+		if ( bp->nak ) {
+		    bp->naks++;
+		    ia_phase ( bp, IA_STOP );
+		    break;
+		}
+		if ( bp->idx < 0 )
+		    bp->idx = 0;
+		else
+		    bp->idx++;
+		ia_next ( bp );
+	    }
+	    break;
+
+	case IA_RBIT:
+	    if ( bp->bit == 8 ) {
+		GPIO_INPUT ( bp->sda_gpio, bp->sda_pin );
+		iic_setdc ( bp, bp->cur_sda, 0 );
+		bp->bit = 7;
+		bp->tick = 0;
+		break;
+	    }
+	    if ( t == 0 )
+		iic_setdc ( bp, 1, 0 );
+	    else if ( t == 1 )
+		iic_setdc ( bp, 1, 1 );
+	    else {
+		bp->byte |= iic_raw_bit ( bp ) << bp->bit;
+		bp->tick = 0;
+		if ( bp->bit-- == 0 ) {
+		    GPIO_OUTPUT ( bp->sda_gpio, bp->sda_pin );
+		    sp->buf[bp->idx] = bp->byte;
+		    ia_phase ( bp, IA_RACK );
+		}
+	    }
+	    break;
+
+	case IA_RACK:
+	    /* NAK the last byte, unless the next segment
+	     * continues the read.
+	     */
+	    v = 0;
+	    if ( bp->idx == sp->len - 1 ) {
+		if ( bp->seg == xp->nseg - 1 ||
+			! (xp->segs[bp->seg+1].flags & IIC_SEG_NOSTART) )
+		    v = 1;
+	    }
+	    if ( t == 0 )
+		iic_setdc ( bp, bp->cur_sda, 0 );
+	    else if ( t == 1 )
+		iic_setdc ( bp, v, 0 );
+	    else if ( t == 2 )
+		iic_setdc ( bp, v, 1 );
+	    else if ( t == 3 )
+		iic_setdc ( bp, v, 0 );
+	    else {
+		iic_setdc ( bp, 1, 0 );
+		bp->idx++;
+		ia_next ( bp );
+	    }
+	    break;
+
+	case IA_STOP:
+	    if ( t == 0 )
+		iic_setdc ( bp, 0, bp->cur_scl );
+	    else if ( t == 1 )
+		iic_setdc ( bp, 0, 1 );
+	    else {
+		iic_setdc ( bp, 1, 1 );
+		ia_finish ( bp );
+	    }
+	    break;
+
+	default:
+	    break;
+	}
+}
+
+/* Hand a bus a timer to run the engine with.
+ * Call this after iic_bus_init().
+ */
+void
+iic_bus_async ( iic_bus_t *bp, int timer )
+{
+	bp->timer = timer;
+	timer_init ( timer, 1000000000 / iic_step_ns[bp->speed], ia_tick, bp );
+}
+
+/* Queue a transaction.
+ * This returns right away, xp->status stays IIC_PENDING
+ * until the transaction is done.
+ * A bad segment list (see iic_segs_ok) never gets queued,
+ * done() gets called right here with status IIC_BADSEG.
+ * The queue is kept in priority order (bigger xp->pri goes
+ * first), and in order of arrival for equal priorities.
+ * Nothing preempts a transaction already on the bus.
+ * This is fine to call from interrupt level, interrupts
+ * are left masked or not, just as we found them.
+ */
+void
+iic_bus_submit ( iic_bus_t *bp, struct iic_xact *xp )
+{
+	struct iic_xact *p, *lp;
+	int state;
+
+	if ( ! iic_segs_ok ( xp->segs, xp->nseg ) ) {
+	    xp->status = IIC_BADSEG;
+	    if ( xp->done )
+		(*xp->done) ( xp );
+	    return;
+	}
+
+	state = irq_save ();
+
+	xp->status = IIC_PENDING;
+
+	lp = (struct iic_xact *) 0;
+	for ( p = bp->head; p && p->pri >= xp->pri; p = p->next )
+	    lp = p;
+
+	xp->next = p;
+	if ( lp )
+	    lp->next = xp;
+	else
+	    bp->head = xp;
+	if ( ! p )
+	    bp->tail = xp;
+
+	if ( ! bp->cur )
+	    ia_begin ( bp );
+
+	irq_restore ( state );
+}
+
+/* Sleep until a queued transaction is done */
+int
+iic_wait ( struct iic_xact *xp )
+{
+	while ( xp->status == IIC_PENDING )
+	    sleep ();
+	return xp->status;
+}
+
+/* ----------------------------------------------------------- */
+/* The original single bus interface */
+/* ----------------------------------------------------------- */
+
+int
+iic_send ( int addr, unsigned char *buf, int n )
+{
+	return iic_bus_send ( &iic_default, addr, buf, n );
+}
+
+int
+iic_recv ( int addr, unsigned char *buf, int n )
+{
+	return iic_bus_recv ( &iic_default, addr, buf, n );
+}
+
+int
+iic_xfer ( int addr, struct iic_seg *segs, int nseg )
+{
+	return iic_bus_xfer ( &iic_default, addr, segs, nseg );
+}
+
+int
+iic_write_reg ( int addr, int reg, int val )
+{
+	return iic_bus_write_reg ( &iic_default, addr, reg, val );
+}
+
+int
+iic_write_regs ( int addr, int reg, unsigned char *buf, int n )
+{
+	return iic_bus_write_regs ( &iic_default, addr, reg, buf, n );
+}
+
+int
+iic_read_regs ( int addr, int reg, unsigned char *buf, int n )
+{
+	return iic_bus_read_regs ( &iic_default, addr, reg, buf, n );
+}
+
+int
+iic_read_reg ( int addr, int reg )
+{
+	return iic_bus_read_reg ( &iic_default, addr, reg );
+}
+
+/* THE END */
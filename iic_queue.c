@@ -0,0 +1,215 @@
+/* iic_queue.c
+ * (c) Tom Trebisky  10-19-2026
+ *
+ * Devices and scheduling for the interrupt driven i2c engine.
+ *
+ * This sits above the queue in iic.c.  Each device on a bus
+ * gets a struct iic_dev, which carries a priority, an optional
+ * sampling period, and statistics on latency and errors.
+ * With several sensors on one bus, each just submits (or is
+ * sampled periodically) and the engine runs the transactions
+ * back to back.  The blocking calls in iic.c are unchanged.
+ *
+ * Periodic sampling is driven by a single repeat() (see event.c)
+ * that ticks once per ms and counts down each periodic device.
+ */
+
+#include "hydra.h"
+
+static struct iic_dev *dev_list;
+static int sched_running;
+
+/* Called at interrupt level when the engine finishes a
+ * transaction for one of our devices.
+ */
+static void
+dev_done ( struct iic_xact *xp )
+{
+	struct iic_dev *dp = (struct iic_dev *) xp->arg;
+	unsigned int lat;
+
+	lat = (get_cycles () - dp->t_submit) / (get_cpu_hz () / 1000000);
+
+	dp->count++;
+	if ( xp->status )
+	    dp->errors++;
+
+	dp->lat_last = lat;
+	dp->lat_total += lat;
+	if ( dp->count == 1 || lat < dp->lat_min )
+	    dp->lat_min = lat;
+	if ( lat > dp->lat_max )
+	    dp->lat_max = lat;
+
+	if ( dp->done )
+	    (*dp->done) ( dp );
+}
+
+/* Set up a device.
+ * pri is the queue priority, bigger goes first.
+ */
+void
+iic_dev_init ( struct iic_dev *dp, char *name, iic_bus_t *bp, int addr, int pri )
+{
+	dp->name = name;
+	dp->bus = bp;
+	dp->period = 0;
+	dp->done = 0;
+
+	dp->xact.addr = addr;
+	dp->xact.pri = pri;
+	dp->xact.arg = (void *) dp;
+	dp->xact.done = dev_done;
+	dp->xact.status = 0;
+
+	dp->count = 0;
+	dp->errors = 0;
+	dp->overruns = 0;
+	dp->lat_min = 0;
+	dp->lat_max = 0;
+	dp->lat_total = 0;
+	dp->lat_last = 0;
+
+	irq_disable ();
+	dp->next = dev_list;
+	dev_list = dp;
+	irq_enable ();
+}
+
+/* Queue a transaction for a device.
+ * done() gets called at interrupt level when it finishes,
+ * dp->xact.status tells how it went.
+ * Returns 1 (and does nothing) if the last one for this
+ * device has not finished yet, and 2 if the device is being
+ * sampled by iic_dev_periodic(), which owns dp->xact then.
+ * The check and the submit happen with interrupts masked,
+ * so sched_tick can't slip in between.
+ */
+int
+iic_dev_submit ( struct iic_dev *dp, struct iic_seg *segs, int nseg, void (*done) ( struct iic_dev * ) )
+{
+	int state;
+
+	state = irq_save ();
+
+	if ( dp->period ) {
+	    irq_restore ( state );
+	    return 2;
+	}
+
+	if ( dp->xact.status == IIC_PENDING ) {
+	    irq_restore ( state );
+	    return 1;
+	}
+
+	dp->xact.segs = segs;
+	dp->xact.nseg = nseg;
+	dp->done = done;
+
+	dp->t_submit = get_cycles ();
+	iic_bus_submit ( dp->bus, &dp->xact );
+
+	irq_restore ( state );
+	return 0;
+}
+
+/* Runs once per ms at interrupt level.
+ * The iic engine interrupt can preempt us and finish a
+ * transaction, so each device is checked and submitted
+ * with interrupts masked.
+ */
+static void
+sched_tick ( void )
+{
+	struct iic_dev *dp;
+	int state;
+
+	for ( dp = dev_list; dp; dp = dp->next ) {
+	    state = irq_save ();
+
+	    if ( ! dp->period || --dp->count_down > 0 ) {
+		irq_restore ( state );
+		continue;
+	    }
+	    dp->count_down = dp->period;
+
+	    if ( dp->xact.status == IIC_PENDING )
+		dp->overruns++;
+	    else {
+		dp->t_submit = get_cycles ();
+		iic_bus_submit ( dp->bus, &dp->xact );
+	    }
+
+	    irq_restore ( state );
+	}
+}
+
+/* Submit the same transaction every "ms" milliseconds.
+ * If a sample is still on the queue when the next one is
+ * due, we skip it and count an overrun.
+ * Pass ms = 0 to stop, which is fine at any time, the
+ * transaction on the queue (if any) just runs out.
+ * Returns 1 (and does nothing) if a transaction for this
+ * device is still pending, since the engine may be in the
+ * middle of the old segment list, and 0 otherwise.
+ */
+int
+iic_dev_periodic ( struct iic_dev *dp, struct iic_seg *segs, int nseg, void (*done) ( struct iic_dev * ), int ms )
+{
+	int state;
+	int start;
+
+	state = irq_save ();
+
+	if ( ! ms ) {
+	    dp->period = 0;
+	    irq_restore ( state );
+	    return 0;
+	}
+
+	if ( dp->xact.status == IIC_PENDING ) {
+	    irq_restore ( state );
+	    return 1;
+	}
+
+	dp->xact.segs = segs;
+	dp->xact.nseg = nseg;
+	dp->done = done;
+	dp->count_down = ms;
+	dp->period = ms;
+
+	start = ! sched_running;
+	sched_running = 1;
+
+	irq_restore ( state );
+
+	/* repeat() unmasks interrupts on its own */
+	if ( start )
+	    repeat ( 1, sched_tick );
+	return 0;
+}
+
+void
+iic_dev_show ( struct iic_dev *dp )
+{
+	int avg = 0;
+
+	if ( dp->count )
+	    avg = dp->lat_total / dp->count;
+
+	printf ( "%s: %d xfers, %d errors, %d overruns\n",
+	    dp->name, dp->count, dp->errors, dp->overruns );
+	printf ( "  latency (us) min/avg/max/last %d %d %d %d\n",
+	    dp->lat_min, avg, dp->lat_max, dp->lat_last );
+}
+
+void
+iic_dev_show_all ( void )
+{
+	struct iic_dev *dp;
+
+	for ( dp = dev_list; dp; dp = dp->next )
+	    iic_dev_show ( dp );
+}
+
+/* THE END */
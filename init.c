@@ -27,6 +27,30 @@ extern int  __text_end;
 extern unsigned int __rodata_start;
 extern unsigned int __rodata_end;
 
+extern char __data_load;
+
+/* We hand these to boot_defer() */
+extern void usb_init ( void );
+extern void gpio_mco_setup ( void );
+
+extern char __ramfunc_start, __ramfunc_end, __ramfunc_load;
+
+/* CCM and SRAM2/SRAM3, only on the chips that have them.
+ * Otherwise these sections are part of .bss and .data
+ */
+#ifdef HAS_CCM
+extern char __ccmram_start, __ccmram_end;
+extern char __ccmram_data_start, __ccmram_data_end, __ccmram_data_load;
+#endif
+#ifdef HAS_SRAM2
+extern char __sram2_start, __sram2_end;
+extern char __sram2_data_start, __sram2_data_end, __sram2_data_load;
+#endif
+#ifdef HAS_SRAM3
+extern char __sram3_start, __sram3_end;
+extern char __sram3_data_start, __sram3_data_end, __sram3_data_load;
+#endif
+
 static void
 setup_default_serial ( void )
 {
@@ -40,41 +64,80 @@ setup_default_serial ( void )
         set_std_serial ( fd );
 }
 
+/* Put off until boot_late(), see boot.c */
+static void
+boot_banner ( void )
+{
+	printf ( "Rebooted -- initializing\n" );
+	nvic_show ();
+}
+
 /* Perform various magic before the user code gets started.
+ * Each stage gets a boot_mark() so we can see where the time
+ * goes (boot_show).  Only what user code needs right away
+ * gets done here, the rest is deferred to boot_late().
  */
 void
 stm_init ( void )
 {
-	int *p;
-	int *src;
+	/* First, so we can time everything else */
+	cycle_init ();
 
 	/* Zero the BSS area */
-	for ( p = (int *) &__bss_start; p < (int *) &__bss_end; )
-	    *p++ = 0;
+	memset ( &__bss_start, 0, (char *) &__bss_end - (char *) &__bss_start );
 
 	/* Copy initialized data from flash */
 	// src = &__rodata_start;
-	src = &__text_end;
+	memcpy ( &__data_start, &__data_load, (char *) &__data_end - (char *) &__data_start );
+
+	/* Code that runs from ram (HYDRA_RAMFUNC), nothing there
+	 * gets called before this.  The barriers make sure we
+	 * fetch the new code, not whatever was there before.
+	 */
+	memcpy ( &__ramfunc_start, &__ramfunc_load, &__ramfunc_end - &__ramfunc_start );
+	asm volatile ( "dsb\n\tisb" ::: "memory" );
+
+	/* The stack is up at the top of the CCM, well clear of these */
+#ifdef HAS_CCM
+	memset ( &__ccmram_start, 0, &__ccmram_end - &__ccmram_start );
+	memcpy ( &__ccmram_data_start, &__ccmram_data_load, &__ccmram_data_end - &__ccmram_data_start );
+#endif
+#ifdef HAS_SRAM2
+	memset ( &__sram2_start, 0, &__sram2_end - &__sram2_start );
+	memcpy ( &__sram2_data_start, &__sram2_data_load, &__sram2_data_end - &__sram2_data_start );
+#endif
+#ifdef HAS_SRAM3
+	memset ( &__sram3_start, 0, &__sram3_end - &__sram3_start );
+	memcpy ( &__sram3_data_start, &__sram3_data_load, &__sram3_data_end - &__sram3_data_start );
+#endif
 
-	for ( p = &__data_start; p < &__data_end; p++ )
-		*p = *src++;
+	boot_mark ( "ram" );
 
 	ram_init ();
 	rcc_init ();
+	boot_clock ();
+	boot_mark ( "rcc" );
 
 	setup_default_serial ();
-	printf ( "Rebooted -- initializing\n" );
+	boot_mark ( "serial" );
 
 	systick_init ();
+	delay_init ();
 	nvic_init ();
-
-	usb_init ();
-
-	/* So we can use scope on clocks */
-    gpio_mco_setup ();
+	boot_mark ( "systick" );
 
 	led_init ();
 	led_off ();
+	boot_mark ( "led" );
+
+	boot_defer ( "banner", boot_banner );
+#ifndef HYDRA_QEMU
+	/* QEMU has no USB */
+	boot_defer ( "usb", usb_init );
+#endif
+
+	/* So we can use scope on clocks */
+	boot_defer ( "mco", gpio_mco_setup );
 
 	/* Not needed, the chip starts up with
 	 * interrupts enabled
@@ -82,6 +145,7 @@ stm_init ( void )
 	// enable_irq;
 
 	/* Call user code */
+	boot_mark ( "startup" );
 	startup ();
 }
 
@@ -176,4 +240,31 @@ fault ( void )
 	for ( ;; ) ;
 }
 
+/* The F4 sends the real faults here (by way of fault_entry
+ * in locore_411.s) with the stacked frame and EXC_RETURN.
+ * The frame starts r0-r3, r12, lr, pc, xpsr, whether or not
+ * the FPU registers got stacked after that.
+ */
+#define SCB_CFSR	((volatile unsigned int *) 0xE000ED28)
+#define SCB_HFSR	((volatile unsigned int *) 0xE000ED2C)
+
+#define CFSR_NOCP	BIT(19)		/* usage fault, no coprocessor */
+#define EXC_NOFP	BIT(4)		/* clear for a frame with FPU registers */
+
+void
+fault_frame ( unsigned int *frame, unsigned int exc_return )
+{
+	unsigned int cfsr = *SCB_CFSR;
+
+	printf ( "Unexpected fault!\n" );
+	printf ( "pc %X, lr %X, psr %X\n", frame[6], frame[5], frame[7] );
+	printf ( "cfsr %X, hfsr %X\n", cfsr, *SCB_HFSR );
+	if ( ! (exc_return & EXC_NOFP) )
+	    printf ( "FPU registers were stacked too\n" );
+	if ( cfsr & CFSR_NOCP )
+	    printf ( "FPU instruction with the FPU off\n" );
+	printf ( "Spinning\n" );
+	for ( ;; ) ;
+}
+
 /* THE END */
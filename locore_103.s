@@ -10,7 +10,7 @@
 .thumb
 
 @ First the "standard" 16 entries for a cortex-m3
-.word   0x20005000  	/* stack top address */
+.word   __stack_top  	/* stack top address, see the lds file */
 .word   _reset      	/* 1 Reset */
 .word   fault        	/* 2 NMI */
 .word   fault        	/* 3 Hard Fault */
@@ -36,10 +36,10 @@
 .word   bogus           /* IRQ  4 */
 .word   bogus           /* IRQ  5 */
 .word   exti0_handler   /* IRQ  6 */
-.word   bogus           /* IRQ  7 */
-.word   bogus           /* IRQ  8 */
-.word   bogus           /* IRQ  9 */
-.word   bogus           /* IRQ 10 */
+.word   exti1_handler   /* IRQ  7 */
+.word   exti2_handler   /* IRQ  8 */
+.word   exti3_handler   /* IRQ  9 */
+.word   exti4_handler   /* IRQ 10 */
 .word   bogus           /* IRQ 11 */
 .word   bogus           /* IRQ 12 */
 .word   bogus           /* IRQ 13 */
@@ -52,15 +52,15 @@
 .word   bogus           /* IRQ 20 */
 .word	bogus		/* IRQ 21 */
 .word	bogus		/* IRQ 22 */
-.word	bogus		/* IRQ 23 */
+.word	exti9_5_handler	/* IRQ 23 -- EXTI 5-9 */
 .word	bogus		/* IRQ 24 -- Timer 1 break */
 .word	bogus		/* IRQ 25 -- Timer 1 update */
 .word	bogus		/* IRQ 26 -- Timer 1 trig */
 .word	bogus		/* IRQ 27 -- Timer 1 cc */
 
-.word	bogus		/* IRQ 28 -- Timer 2 */
-.word	bogus		/* IRQ 29 -- Timer 3 */
-.word	bogus		/* IRQ 30 -- Timer 4 */
+.word	tim2_handler	/* IRQ 28 -- Timer 2 */
+.word	tim3_handler	/* IRQ 29 -- Timer 3 */
+.word	tim4_entry	/* IRQ 30 -- Timer 4 (see prof.c) */
 
 .word	bogus		/* IRQ 31 */
 .word	bogus		/* IRQ 32 */
@@ -71,7 +71,7 @@
 .word	uart1_handler	/* IRQ 37 -- UART 1 */
 .word	uart2_handler	/* IRQ 38 -- UART 2 */
 .word	bogus		/* IRQ 39 -- UART 3 */
-.word	bogus		/* IRQ 40 */
+.word	exti15_10_handler	/* IRQ 40 -- EXTI 10-15 */
 .word	bogus		/* IRQ 41 */
 .word	bogus		/* IRQ 42 */
 .word	bogus		/* IRQ 43 */
@@ -112,6 +112,18 @@ _reset:
     bl stm_init
     b .
 
+@ Timer 4 comes here so the profiler (prof.c) can see what it
+@ interrupted (the frame is the same on the M3 and M4).
+@ prof_irq() runs the timer as usual afterwards.
+.thumb_func
+tim4_entry:
+    mrs	r0, msp
+    tst	lr, #4
+    beq	1f
+    mrs	r0, psp
+1:  mov	r1, lr
+    b	prof_irq
+
         .globl get_sp
 get_sp:
         add     r0, sp, #0
@@ -10,13 +10,13 @@
 .thumb
 
 @ First the "standard" 16 entries for a cortex-m4
-.word   0x20020000  	/* stack top address */
+.word   __stack_top  	/* stack top address, see the lds file */
 .word   _reset      	/* 1 Reset */
 .word   fault        	/* 2 NMI */
-.word   fault        	/* 3 Hard Fault */
-.word   fault        	/* 4 MM Fault */
-.word   fault        	/* 5 Bus Fault */
-.word   fault        	/* 6 Usage Fault */
+.word   fault_entry  	/* 3 Hard Fault */
+.word   fault_entry  	/* 4 MM Fault */
+.word   fault_entry  	/* 5 Bus Fault */
+.word   fault_entry  	/* 6 Usage Fault */
 .word   fault        	/* 7 RESERVED */
 .word   fault        	/* 8 RESERVED */
 .word   fault        	/* 9 RESERVED*/
@@ -35,31 +35,31 @@
 .word   bogus           /* IRQ  4 */
 .word   bogus           /* IRQ  5 */
 .word   exti0_handler   /* IRQ  6 */
-.word   bogus           /* IRQ  7 */
-.word   bogus           /* IRQ  8 */
-.word   bogus           /* IRQ  9 */
-.word   bogus           /* IRQ 10 */
-.word   bogus           /* IRQ 11 */
-.word   bogus           /* IRQ 12 */
-.word   bogus           /* IRQ 13 */
-.word   bogus           /* IRQ 14 */
-.word   bogus           /* IRQ 15 */
-.word   bogus           /* IRQ 16 */
-.word   bogus           /* IRQ 17 */
+.word   exti1_handler   /* IRQ  7 */
+.word   exti2_handler   /* IRQ  8 */
+.word   exti3_handler   /* IRQ  9 */
+.word   exti4_handler   /* IRQ 10 */
+.word   dma1_s0_handler /* IRQ 11 -- DMA1 stream 0 */
+.word   dma1_s1_handler /* IRQ 12 -- DMA1 stream 1 */
+.word   dma1_s2_handler /* IRQ 13 -- DMA1 stream 2 */
+.word   dma1_s3_handler /* IRQ 14 -- DMA1 stream 3 */
+.word   dma1_s4_handler /* IRQ 15 -- DMA1 stream 4 */
+.word   dma1_s5_handler /* IRQ 16 -- DMA1 stream 5 */
+.word   dma1_s6_handler /* IRQ 17 -- DMA1 stream 6 */
 .word   bogus           /* IRQ 18 */
 .word   bogus           /* IRQ 19 */
 .word   bogus           /* IRQ 20 */
 .word	bogus		/* IRQ 21 */
 .word	bogus		/* IRQ 22 */
-.word	bogus		/* IRQ 23 */
+.word	exti9_5_handler	/* IRQ 23 -- EXTI 5-9 */
 .word	bogus		/* IRQ 24 -- Timer 1 break */
 .word	bogus		/* IRQ 25 -- Timer 1 update */
 .word	bogus		/* IRQ 26 -- Timer 1 trig */
 .word	bogus		/* IRQ 27 -- Timer 1 cc */
 
-.word	bogus		/* IRQ 28 -- Timer 2 */
-.word	bogus		/* IRQ 29 -- Timer 3 */
-.word	bogus		/* IRQ 30 -- Timer 4 */
+.word	tim2_handler	/* IRQ 28 -- Timer 2 */
+.word	tim3_handler	/* IRQ 29 -- Timer 3 */
+.word	tim4_entry	/* IRQ 30 -- Timer 4 (see prof.c) */
 
 .word	bogus		/* IRQ 31 */
 .word	bogus		/* IRQ 32 */
@@ -70,27 +70,27 @@
 .word	uart1_handler	/* IRQ 37 -- UART 1 */
 .word	uart2_handler	/* IRQ 38 -- UART 2 */
 .word	bogus		/* IRQ 39 -- UART 3 */
-.word	bogus		/* IRQ 40 */
+.word	exti15_10_handler	/* IRQ 40 -- EXTI 10-15 */
 .word	bogus		/* IRQ 41 */
 .word	usb_wakeup_handler	/* IRQ 42 */
 .word	bogus		/* IRQ 43 */
 .word	bogus		/* IRQ 44 */
 .word	bogus		/* IRQ 45 */
 .word	bogus		/* IRQ 46 */
-.word	bogus		/* IRQ 47 */
+.word	dma1_s7_handler	/* IRQ 47 -- DMA1 stream 7 */
 .word	bogus		/* IRQ 48 */
 .word	bogus		/* IRQ 49 */
-.word	bogus		/* IRQ 50 */
+.word	tim5_handler	/* IRQ 50 -- Timer 5 */
 .word	bogus		/* IRQ 51 */
 .word	bogus		/* IRQ 52 */
 .word	bogus		/* IRQ 53 */
 .word	bogus		/* IRQ 54 */
 .word	bogus		/* IRQ 55 */
-.word	bogus		/* IRQ 56 */
-.word	bogus		/* IRQ 57 */
-.word	bogus		/* IRQ 58 */
-.word	bogus		/* IRQ 59 */
-.word	bogus		/* IRQ 60 */
+.word	dma2_s0_handler	/* IRQ 56 -- DMA2 stream 0 */
+.word	dma2_s1_handler	/* IRQ 57 -- DMA2 stream 1 */
+.word	dma2_s2_handler	/* IRQ 58 -- DMA2 stream 2 */
+.word	dma2_s3_handler	/* IRQ 59 -- DMA2 stream 3 */
+.word	dma2_s4_handler	/* IRQ 60 -- DMA2 stream 4 */
 .word	bogus		/* IRQ 61 */
 .word	bogus		/* IRQ 62 */
 .word	bogus		/* IRQ 63 */
@@ -100,9 +100,9 @@
 .word	usb_irq_handler		/* IRQ 67 */
 
 /* Beyond here for the F429 */
-.word	bogus		/* IRQ 68 */
-.word	bogus		/* IRQ 69 */
-.word	bogus		/* IRQ 70 */
+.word	dma2_s5_handler	/* IRQ 68 -- DMA2 stream 5 */
+.word	dma2_s6_handler	/* IRQ 69 -- DMA2 stream 6 */
+.word	dma2_s7_handler	/* IRQ 70 -- DMA2 stream 7 */
 .word	bogus		/* IRQ 71 */
 .word	bogus		/* IRQ 72 */
 .word	bogus		/* IRQ 73 */
@@ -114,11 +114,57 @@
 
 .section .text
 
+@ Turn on the FPU (full access for CP10 and CP11) before any C
+@ code runs, with a hard float build gcc may use the FPU registers
+@ anywhere.  Lazy stacking (ASPEN and LSPEN in FPCCR, which is how
+@ the chip comes out of reset anyway) means an interrupt only saves
+@ the FPU registers if the handler itself touches the FPU.  So plain
+@ C interrupt handlers can use float, at the cost of a bigger
+@ exception frame (104 bytes rather than 32) when they do.
+.equ	CPACR,	0xE000ED88
+.equ	FPCCR,	0xE000EF34
+
 .thumb_func
 _reset:
+    ldr	r0, =CPACR
+    ldr	r1, [r0]
+    orr	r1, r1, #(0xf << 20)
+    str	r1, [r0]
+    ldr	r0, =FPCCR
+    ldr	r1, [r0]
+    orr	r1, r1, #0xC0000000
+    str	r1, [r0]
+    dsb
+    isb
     bl stm_init
     b .
 
+@ Faults come here so fault_frame() can look at what got stacked,
+@ bit 2 of EXC_RETURN says which stack, bit 4 (clear) says the
+@ frame has the FPU registers too.
+.thumb_func
+fault_entry:
+    mrs	r0, msp
+    tst	lr, #4
+    beq	1f
+    mrs	r0, psp
+1:  mov	r1, lr
+    b	fault_frame
+
+@ Timer 4 comes here so the profiler (prof.c) can see what it
+@ interrupted, just like fault_entry.  prof_irq() runs the timer
+@ as usual afterwards.
+.thumb_func
+tim4_entry:
+    mrs	r0, msp
+    tst	lr, #4
+    beq	1f
+    mrs	r0, psp
+1:  mov	r1, lr
+    b	prof_irq
+
+.ltorg
+
         .globl get_sp
 get_sp:
         add     r0, sp, #0
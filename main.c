@@ -11,6 +11,8 @@
 
 extern void show_events ( void );
 extern void led_off ( void );
+extern void react_show ( void );
+extern void event_tick ( void );
 
 /* ================ */
 
@@ -284,20 +286,35 @@ usb_test_1 ( void )
 	}
 }
 
+/* This used to call usb_read() in a tight loop, which
+ * returns 0 at a ferocious rate.  Now the USB interrupt
+ * posts a reactor source (see react.c) and we sleep until then.
+ */
+static int usb_react;
+
 static void
-usb_test_2 ( void )
+usb_rx_ready ( void )
+{
+	react_post ( usb_react );
+}
+
+static void
+usb_reader ( void )
 {
 	int n;
 	char buf[64];
-	int count;
 
-	count = 0;
-	for ( ;; ) {
-	    ++count;
-	    n = usb_read ( buf, 64 );
-	    if ( n )
-		printf ( "USB: %d (%d)\n", n, count );
-	}
+	while ( (n = usb_read ( buf, 64 )) )
+	    printf ( "USB: %d\n", n );
+}
+
+static void
+usb_test_2 ( void )
+{
+	usb_react = react_add ( usb_reader );
+	usb_notify ( usb_rx_ready );
+
+	react_run ();
 }
 
 static void
@@ -323,21 +340,29 @@ usb_test_3 ( void )
  * we type a character.
  */
 
+static unsigned char serial_buf[64];
+static struct ring serial_ring = RING_INIT ( serial_buf );
+
 void
-serial_fn ( int x )
+serial_fn ( void )
 {
-	printf ( "SERIAL: %x\n", x );
+	int x;
+
+	while ( (x = ring_get ( &serial_ring )) >= 0 )
+	    printf ( "SERIAL: %x\n", x );
 }
 
+/* 10-2026 - the interrupt just queues the byte and
+ * the printing is done from the reactor loop.
+ */
 void
 serial_test ( void )
 {
 	printf ( "Start serial test\n" );
 
-	serial_read_hookup ( UART1, serial_fn );
+	react_uart ( UART1, &serial_ring, serial_fn );
 
-	for ( ;; )
-		;
+	react_run ();
 }
 
 /* ================================================= */
@@ -446,39 +471,199 @@ writer ( void )
 		usb_write ( buf, len );
 }
 
+/* The xfer test used to run the LEDs with delay_ms() and
+ * look at the console once a second.  Now it is driven
+ * by the reactor, a timer for the ticks and the console
+ * uart for the keyboard.
+ */
+static unsigned char xfer_kbd_buf[16];
+static struct ring xfer_kbd = RING_INIT ( xfer_kbd_buf );
+static int xfer_ticks = 0;
+
+static void
+xfer_tick ( void )
+{
+	if ( xfer_ticks++ & 1 ) {
+		red_off ();
+		green_off ();
+		return;
+	}
+
+	// printf ( "Tick %d -- bytes: %d\n", xfer_ticks/2, xfer_count );
+	printf ( "Tick %d -- bytes: %d -- int, sof, xof = %d %d %d\n", xfer_ticks/2, xfer_count, tusb_int_count, tusb_sof_count, tusb_xof_count );
+	red_on ();
+	green_on ();
+}
+
+static void
+xfer_key ( void )
+{
+	while ( ring_get ( &xfer_kbd ) >= 0 ) {
+		// printf ( "Somebody typed: %X\n", cc );
+		if ( ! class_is_connected() )
+			printf ( "Nobody connected\n" );
+		else {
+			writer ();
+		}
+	}
+}
+
 /*
  * 3-17-2025
  */
 void
 xfer_test ( void )
 {
-	int ii = 0;
-	int cc;
-	char *pbuf = (char *) 0x20000000;
-
 	printf ( "xfer test!\n" );
 	usb_hookup ( gobbler );
 
-	for ( ;; ) {
-		// printf ( "Tick %d -- bytes: %d\n", ii++, xfer_count );
-		printf ( "Tick %d -- bytes: %d -- int, sof, xof = %d %d %d\n", ii++, xfer_count, tusb_int_count, tusb_sof_count, tusb_xof_count );
-		red_on ();
-		green_on ();
-		delay_ms ( 500 );
-		// printf ( "OFF\n" );
-		red_off ();
-		green_off ();
-		delay_ms ( 500 );
-		if ( console_check () ) {
-			cc = getc ();
-			// printf ( "Somebody typed: %X\n", cc );
-			if ( ! class_is_connected() )
-				printf ( "Nobody connected\n" );
-			else {
-				writer ();
-			}
-		}
+	react_timer ( 500, xfer_tick );
+	react_uart ( get_std_serial (), &xfer_kbd, xfer_key );
+
+	react_run ();
+}
+
+/* ================================================= */
+
+/* Dispatch latency for the reactor.
+ * A 1 ms timer source and a button, with a report every
+ * 5 seconds.  The awake number should be tiny.
+ */
+static void
+react_fast ( void )
+{
+}
+
+static void
+react_button ( void )
+{
+	printf ( "Button at %X\n", exti_stamp ( 0 ) );
+}
+
+void
+react_test ( void )
+{
+	react_timer ( 1, react_fast );
+	react_timer ( 5000, react_show );
+	react_exti ( GPIOA, 0, EXTI_FALLING, react_button );
+
+	react_run ();
+}
+
+/* ================================================= */
+
+/* The sampling profiler (see prof.c), with the reactor
+ * test as something to look at.  Every 10 seconds we dump
+ * what we have (for Tools/prof) and start over.
+ */
+static void
+prof_show ( void )
+{
+	prof_dump ( 0 );
+	prof_clear ();
+}
+
+void
+prof_test ( void )
+{
+	prof_init ( 997 );
+	prof_start ();
+
+	react_timer ( 10000, prof_show );
+	react_test ();
+}
+
+/* ================================================= */
+
+/* Message queues (see msgq.c)
+ * The button interrupt fills in a message right in the
+ * queue and the reactor hands it to button_msg() in the
+ * mainline.  A repeat (also at interrupt level) sends one
+ * every second too, so there is something to see.
+ * Each queue may have only one producer, so the repeat
+ * gets a queue of its own.
+ */
+struct button_msg {
+	int line;
+	int count;
+	unsigned int stamp;	/* cycles, at the edge */
+	unsigned int sent;	/* cycles, at the commit */
+};
+
+static struct button_msg button_slots[8];
+static struct msgq button_q = MSGQ_INIT ( button_slots );
+
+static struct button_msg tick_slots[4];
+static struct msgq tick_q = MSGQ_INIT ( tick_slots );
+
+static void
+button_isr ( void )
+{
+	struct button_msg *mp;
+
+	mp = msgq_reserve ( &button_q );
+	if ( ! mp )
+	    return;
+
+	mp->line = 0;
+	mp->count = exti_count ( 0 );
+	mp->stamp = exti_stamp ( 0 );
+	mp->sent = get_cycles ();
+	msgq_commit ( &button_q );
+}
+
+static void
+button_tick ( void )
+{
+	struct button_msg *mp;
+
+	mp = msgq_reserve ( &tick_q );
+	if ( ! mp )
+	    return;
+
+	mp->line = -1;
+	mp->count = get_systick_count ();
+	mp->stamp = get_cycles ();
+	mp->sent = mp->stamp;
+	msgq_commit ( &tick_q );
+}
+
+static void
+button_drain ( struct msgq *qp )
+{
+	struct button_msg *mp;
+	unsigned int now;
+
+	while ( (mp = msgq_get ( qp )) ) {
+	    now = get_cycles ();
+	    printf ( "Message line %d, count %d, %d cycles after the event, %d after commit\n",
+		mp->line, mp->count, now - mp->stamp, now - mp->sent );
+	    msgq_release ( qp );
 	}
+	if ( msgq_drops ( qp ) )
+	    printf ( "%d messages dropped\n", msgq_drops ( qp ) );
+}
+
+static void
+button_msg ( void )
+{
+	button_drain ( &button_q );
+	button_drain ( &tick_q );
+}
+
+void
+msgq_test ( void )
+{
+	int id;
+
+	id = react_add ( button_msg );
+	msgq_notify ( &button_q, id );
+	msgq_notify ( &tick_q, id );
+
+	exti_setup ( GPIOA, 0, button_isr );
+	repeat ( 1000, button_tick );
+
+	react_run ();
 }
 
 void
@@ -488,16 +673,410 @@ flood ( void )
 			putc ( 'V' );
 }
 
-/* This is the first "user" C code.
- * it is called from stm_init() in init.c
+/* ================================================= */
+
+/* memcpy and memset from string.c, versus a byte loop,
+ * in cycles per byte (x100) for sizes from 1 to 2048.
+ * Source and destination are offset by "skew" bytes
+ * so we see the unaligned path too.
  */
+#define MEM_BENCH_MAX	2048
+
+static unsigned int mem_src[MEM_BENCH_MAX/4 + 2];
+static unsigned int mem_dst[MEM_BENCH_MAX/4 + 2];
+
+static void
+byte_copy ( char *dst, char *src, int n )
+{
+	while ( n-- )
+	    *dst++ = *src++;
+}
+
+static int
+per_byte ( unsigned int cycles, int size )
+{
+	return cycles * 100 / size;
+}
+
 void
-startup ( void )
+mem_bench ( void )
 {
-	int fd = 999;
+	static const int sizes[] = { 1, 4, 7, 16, 33, 64, 128, 256, 512, 1024, 2048 };
+	char *src;
+	char *dst;
+	unsigned int t0, t1, t2, t3;
+	int skew;
+	int size;
+	int i;
+
+	for ( skew = 0; skew < 2; skew++ ) {
+	    src = (char *) mem_src + skew;
+	    dst = (char *) mem_dst;
+	    printf ( "%s: bytes  byte_loop  memcpy  memset  (cycles/byte x 100)\n",
+		skew ? "unaligned" : "aligned" );
+
+	    for ( i=0; i<sizeof(sizes)/sizeof(int); i++ ) {
+		size = sizes[i];
+		t0 = get_cycles ();
+		byte_copy ( dst, src, size );
+		t1 = get_cycles ();
+		memcpy ( dst, src, size );
+		t2 = get_cycles ();
+		memset ( dst + skew, 0x55, size );
+		t3 = get_cycles ();
+		printf ( "%d  %d  %d  %d\n", size,
+		    per_byte ( t1-t0, size ), per_byte ( t2-t1, size ), per_byte ( t3-t2, size ) );
+	    }
+	}
+}
 
-	// flood ();
+/* ================================================= */
+
+/* GPS time, PPS on PA15 (TIM2 CH1), NMEA on UART2
+ * Prints our time (seconds into the UTC day and ns)
+ * and the servo state every few seconds.
+ */
+#ifndef CHIP_F103
+void
+gps_time_test ( void )
+{
+	unsigned int sec;
+	unsigned int ns;
+
+	time_init ( TIMER2, 1, GPIOA, 15 );
+
+	for ( ;; ) {
+	    delay_ms ( 5000 );
+	    time_split ( time_now_ns (), &sec, &ns );
+	    printf ( "%d %d\n", sec % 86400, ns );
+	    time_show ();
+	}
+}
+
+/* DMA2 memory to memory versus the CPU.
+ * Sizes in bytes, all aligned.
+ */
+static unsigned int dma_src[1024] HYDRA_DMA;
+static unsigned int dma_dst[1024] HYDRA_DMA;
+
+static void
+cpu_copy_bytes ( char *dst, char *src, int n )
+{
+	while ( n-- )
+	    *dst++ = *src++;
+}
+
+void
+dma_bench ( void )
+{
+	static const int sizes[] = { 16, 64, 256, 1024, 4096 };
+	unsigned int t0, t1, t2, t3;
+	int size;
+	int i;
+
+	for ( i=0; i<1024; i++ )
+	    dma_src[i] = i * 0x01010101;
+
+	printf ( "bytes   dma  memcpy  cpu_byte (cycles)\n" );
+	for ( i=0; i<sizeof(sizes)/sizeof(int); i++ ) {
+	    size = sizes[i];
+	    t0 = get_cycles ();
+	    dma_memcpy ( dma_dst, dma_src, size );
+	    t1 = get_cycles ();
+	    memcpy ( dma_dst, dma_src, size );
+	    t2 = get_cycles ();
+	    cpu_copy_bytes ( (char *) dma_dst, (char *) dma_src, size );
+	    t3 = get_cycles ();
+	    printf ( "%d  %d  %d  %d\n", size, t1-t0, t2-t1, t3-t2 );
+	}
+
+	if ( dma_dst[1023] != dma_src[1023] )
+	    printf ( "DMA copy is wrong!\n" );
+}
+
+/* Where things landed, and memcpy out of CCM versus SRAM.
+ * DMA into the CCM must be refused.
+ */
+static unsigned int ccm_buf[1024] HYDRA_CCM;
+static unsigned int ccm_init_val HYDRA_CCM_DATA = 0x12345678;
+
+void
+ccm_test ( void )
+{
+	int stack_var;
+	unsigned int t0, t1, t2;
+
+	printf ( "stack %X, ccm_buf %X, dma_src %X\n", &stack_var, ccm_buf, dma_src );
+	printf ( "ccm_init_val = %X\n", ccm_init_val );
+
+	memcpy ( ccm_buf, dma_src, sizeof(ccm_buf) );
+	t0 = get_cycles ();
+	memcpy ( dma_dst, ccm_buf, sizeof(ccm_buf) );
+	t1 = get_cycles ();
+	memcpy ( dma_dst, dma_src, sizeof(ccm_buf) );
+	t2 = get_cycles ();
+	printf ( "4096 bytes from ccm %d, from sram %d (cycles)\n", t1-t0, t2-t1 );
+
+#ifdef HAS_CCM
+	if ( dma_memcpy ( ccm_buf, dma_src, 64 ) == 0 )
+	    printf ( "DMA into CCM was not refused!\n" );
+#endif
+}
+
+/* Flash versus ram (HYDRA_RAMFUNC) execution.
+ * The same branchy loop built twice, once in each place,
+ * then the cycles event_tick() and the USB interrupt take
+ * every second while we send something on USB.
+ * Build once more with -DNO_RAMFUNC to see those from flash.
+ */
+static inline __attribute__ ((always_inline)) int
+branchy ( unsigned char *buf, int n )
+{
+	int rv = 0;
+
+	while ( n-- ) {
+	    switch ( *buf++ & 7 ) {
+		case 0: rv += 3; break;
+		case 1: rv ^= 0x55; break;
+		case 2: rv -= 7; break;
+		case 3: rv <<= 1; break;
+		case 4: rv |= 1; break;
+		case 5: rv >>= 1; break;
+		default: rv++; break;
+	    }
+	}
+	return rv;
+}
+
+static int __attribute__ ((noinline))
+branchy_flash ( unsigned char *buf, int n )
+{
+	return branchy ( buf, n );
+}
+
+static int HYDRA_RAMFUNC
+branchy_ram ( unsigned char *buf, int n )
+{
+	return branchy ( buf, n );
+}
+
+static int ramfunc_count;
+
+static void
+ramfunc_tick ( void )
+{
+	usb_printf ( "%d ramfunc\n", ramfunc_count++ );
+	tick_show ();
+	usb_isr_show ();
+}
+
+void
+ramfunc_test ( void )
+{
+	unsigned char *buf = (unsigned char *) dma_src;
+	unsigned int t0, t1, t2;
+	int i;
+
+	for ( i=0; i<1024; i++ )
+	    dma_src[i] = i * 0x9e3779b9;
+
+	printf ( "branchy_flash at %X, branchy_ram at %X, event_tick at %X\n",
+	    branchy_flash, branchy_ram, event_tick );
+
+	for ( i=0; i<3; i++ ) {
+	    t0 = get_cycles ();
+	    branchy_flash ( buf, sizeof(dma_src) );
+	    t1 = get_cycles ();
+	    branchy_ram ( buf, sizeof(dma_src) );
+	    t2 = get_cycles ();
+	    printf ( "4096 bytes, flash %d, ram %d (cycles)\n", t1-t0, t2-t1 );
+	}
+
+	react_timer ( 1000, ramfunc_tick );
+	react_run ();
+}
+
+/* A float workload against the fixed point we would write
+ * otherwise: a biquad low pass (Butterworth, fc = fs/10) over
+ * a block of samples, and unit conversions (adc counts to mV,
+ * 1e-7 degrees of latitude to meters).
+ * With FLOAT = hard (the default) the float is FPU instructions,
+ * with FLOAT = soft in the Makefile it is libgcc calls, so build
+ * both ways to see the speedup.
+ * Then the same filter again while an interrupt routine does
+ * float too, the answer must not change (lazy FPU stacking).
+ * printf has no %f, so we print things scaled to integers.
+ */
+#define FPU_N	256
 
+static short fix_in[FPU_N];
+static short fix_out[FPU_N];
+static float flt_in[FPU_N];
+static float flt_out[FPU_N];
+
+/* The same filter in Q14 */
+#define Q14_B0	1105
+#define Q14_B1	2210
+#define Q14_B2	1105
+#define Q14_A1	-18727
+#define Q14_A2	6763
+
+static void
+biquad_fix ( short *in, short *out, int n )
+{
+	int x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+	int x, y;
+
+	while ( n-- ) {
+	    x = *in++;
+	    y = (Q14_B0*x + Q14_B1*x1 + Q14_B2*x2 - Q14_A1*y1 - Q14_A2*y2) >> 14;
+	    x2 = x1; x1 = x;
+	    y2 = y1; y1 = y;
+	    *out++ = y;
+	}
+}
+
+static void
+biquad_float ( float *in, float *out, int n )
+{
+	float x1 = 0.0f, x2 = 0.0f, y1 = 0.0f, y2 = 0.0f;
+	float x, y;
+
+	while ( n-- ) {
+	    x = *in++;
+	    y = 0.0674553f*x + 0.1349105f*x1 + 0.0674553f*x2 + 1.1429805f*y1 - 0.4128016f*y2;
+	    x2 = x1; x1 = x;
+	    y2 = y1; y1 = y;
+	    *out++ = y;
+	}
+}
+
+/* 12 bit adc counts to mV (3.3 volt reference), and
+ * 1e-7 degrees of latitude to meters, summed up.
+ */
+static int
+convert_fix ( short *in, int n )
+{
+	int sum = 0;
+
+	while ( n-- ) {
+	    sum += ((*in & 0xfff) * 3300) >> 12;
+	    sum += (*in++ * 100 * 730) >> 16;
+	}
+	return sum;
+}
+
+static float
+convert_float ( float *in, int n )
+{
+	float sum = 0.0f;
+
+	while ( n-- ) {
+	    sum += (float) ((int) *in & 0xfff) * (3300.0f / 4096.0f);
+	    sum += *in++ * 100.0f * 0.01113195f;
+	}
+	return sum;
+}
+
+static volatile float isr_float;
+
+static void
+fpu_isr ( void )
+{
+	isr_float = isr_float * 0.999f + 1.0f;
+}
+
+void
+fpu_bench ( void )
+{
+	unsigned int seed = 12345;
+	unsigned int t0, t1, t2, t3, t4;
+	int ifix;
+	float fsum;
+	int check;
+	int id;
+	int i;
+
+#if defined(__ARM_FP)
+	printf ( "FPU bench, hard float\n" );
+#else
+	printf ( "FPU bench, soft float\n" );
+#endif
+
+	/* a square wave with some noise */
+	for ( i=0; i<FPU_N; i++ ) {
+	    seed = seed * 1103515245 + 12345;
+	    fix_in[i] = ((i & 32) ? 4000 : -4000) + ((seed >> 16) & 0x1ff) - 256;
+	    flt_in[i] = (float) fix_in[i];
+	}
+
+	t0 = get_cycles ();
+	biquad_fix ( fix_in, fix_out, FPU_N );
+	t1 = get_cycles ();
+	biquad_float ( flt_in, flt_out, FPU_N );
+	t2 = get_cycles ();
+	ifix = convert_fix ( fix_in, FPU_N );
+	t3 = get_cycles ();
+	fsum = convert_float ( flt_in, FPU_N );
+	t4 = get_cycles ();
+
+	printf ( "biquad %d samples: fixed %d, float %d (cycles)\n", FPU_N, t1-t0, t2-t1 );
+	printf ( "  last output: fixed %d, float %d\n", fix_out[FPU_N-1], (int) flt_out[FPU_N-1] );
+	printf ( "convert %d values: fixed %d, float %d (cycles)\n", FPU_N, t3-t2, t4-t3 );
+	printf ( "  sum: fixed %d, float %d\n", ifix, (int) fsum );
+
+	/* Now with float at interrupt level too */
+	check = (int) (flt_out[FPU_N-1] * 1000.0f);
+	id = repeat ( 1, fpu_isr );
+	for ( i=0; i<2000; i++ ) {
+	    biquad_float ( flt_in, flt_out, FPU_N );
+	    if ( (int) (flt_out[FPU_N-1] * 1000.0f) != check ) {
+		printf ( "Float result changed under interrupts!\n" );
+		break;
+	    }
+	}
+	repeat_cancel ( id );
+	printf ( "Interrupt level float: %d\n", (int) isr_float );
+}
+#endif
+
+/* ================================================= */
+
+/* Change the CPU clock on the fly (rcc_set_sysclk).
+ * At each speed the console should still work, and a
+ * 1000 ms delay (systick) should take hz cycles.
+ */
+static const int clock_speeds[] = {
+	24000000, 48000000, 72000000, 96000000, 120000000, 168000000, 180000000, 0
+};
+
+void
+clock_test ( void )
+{
+	int boot_hz = get_cpu_hz ();
+	unsigned int t;
+	int i;
+
+	for ( i=0; clock_speeds[i]; i++ ) {
+	    if ( rcc_set_sysclk ( clock_speeds[i] ) ) {
+		printf ( "Can't run at %d\n", clock_speeds[i] );
+		continue;
+	    }
+	    t = get_cycles ();
+	    delay ( 1000 );
+	    t = get_cycles () - t;
+	    printf ( "Clock %d Hz, one second is %d cycles, USB at %d\n",
+		get_cpu_hz (), t, get_usb_hz () );
+	}
+
+	rcc_set_sysclk ( boot_hz );
+	rcc_show ();
+}
+
+/* Put off so the reactor gets going first, see boot.c */
+static void
+banner ( void )
+{
 	puts ( "\n" );
 	puts ( "******************************\n" );
 	puts ( "******************************\n" );
@@ -505,8 +1084,39 @@ startup ( void )
 	puts ( "******************************\n" );
 	puts ( "Up and running mainline code\n" );
 	puts ( "March 8, 2025\n" );
+#ifdef HYDRA_PROFILE
+	/* So benchmark numbers say which build they came from */
+	printf ( "Build profile: %s\n", HYDRA_PROFILE );
+#endif
 
 	rcc_show ();
+	boot_show ();
+}
+
+/* This is the first "user" C code.
+ * it is called from stm_init() in init.c
+ */
+void
+startup ( void )
+{
+	int fd = 999;
+
+#ifdef HYDRA_QEMU
+	/* "make qemu", this never returns */
+	boot_late ();
+	qemu_main ();
+#endif
+
+	// flood ();
+
+	boot_defer ( "main banner", banner );
+
+	/* Tests that don't run the reactor should call
+	 * boot_late() first, that gets USB going among
+	 * other things.
+	 */
+	// boot_late ();
+
 	// blinker ();
 	xfer_test ();
 
@@ -541,6 +1151,40 @@ startup ( void )
 	// Scope loop for delay_us()
 	// delay_calibrate ();
 
+	// memcpy and memset versus byte loops
+	// mem_bench ();
+
+	// GPS disciplined clock
+	// gps_time_test ();
+
+	// DMA memory to memory versus CPU copy
+	// dma_bench ();
+
+	// CCM placement
+	// ccm_test ();
+
+	// Code in flash versus ram
+	// ramfunc_test ();
+
+	// Float, hardware versus fixed point (or soft float)
+	// fpu_bench ();
+
+	// Reactor dispatch latency and idle time
+	// react_test ();
+
+	// Where the time goes, the same with the profiler on
+	// prof_test ();
+
+	// Messages from interrupt code to the reactor
+	// msgq_test ();
+
+	// Change the CPU clock on the fly
+	// clock_test ();
+
+	// Benchmarks, CSV on the console, see bench.c
+	// (call boot_late first)
+	// bench_run ( 0, BENCH_CSV );
+
 	// printf ( "Yo Ho Ho\n" );
 
 	printf ( "USB test running\n" );
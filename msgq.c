@@ -0,0 +1,170 @@
+/* msgq.c
+ * (c) Tom Trebisky  10-19-2026
+ *
+ * Message queues between interrupt code and ordinary code.
+ *
+ * Up to now the only way to hand something from an interrupt
+ * to the mainline was a callback that ran inside the interrupt.
+ * A msgq is an array of fixed size slots (one per message, of
+ * whatever type you like, see MSGQ_INIT in hydra.h) used as a
+ * ring, with the same one producer, one consumer rules as ring.c.
+ *
+ * Nothing gets copied.  The producer does:
+ *   p = msgq_reserve ( q );   fill in *p,   msgq_commit ( q );
+ * and the consumer does:
+ *   p = msgq_get ( q );   look at *p,   msgq_release ( q );
+ * The slot belongs to whoever has it until commit or release.
+ * If the queue is full, msgq_reserve() returns 0 (and counts
+ * a drop), an interrupt routine never waits.
+ *
+ * The consumer can either wait for a message with msgq_wait(),
+ * or have each commit post a reactor source (see react.c) with
+ * msgq_notify().
+ */
+
+#include "hydra.h"
+
+static inline void
+msgq_barrier ( void )
+{
+#ifdef __arm__
+	asm volatile ( "dmb" ::: "memory" );
+#else
+	__atomic_thread_fence ( __ATOMIC_SEQ_CST );
+#endif
+}
+
+/* The slot index is head & (num - 1), so num must be a
+ * power of 2.  Returns 0, or -1 if it isn't, in which case
+ * the queue gets no slots at all (every reserve is a drop)
+ * rather than quietly using the wrong ones.
+ */
+int
+msgq_init ( struct msgq *qp, void *slots, int size, int num )
+{
+	int rv = 0;
+
+	if ( num < 1 || (num & (num - 1)) ) {
+	    num = 0;
+	    rv = -1;
+	}
+
+	qp->slots = slots;
+	qp->size = size;
+	qp->num = num;
+	qp->head = 0;
+	qp->tail = 0;
+	qp->react = 0;
+	qp->drops = 0;
+	return rv;
+}
+
+/* Post reactor source id on every commit.
+ * Returns 0, or -1 for a bad id (react_add() failed).
+ */
+int
+msgq_notify ( struct msgq *qp, int id )
+{
+	if ( id < 0 )
+	    return -1;
+
+	qp->react = id + 1;
+	return 0;
+}
+
+int
+msgq_count ( struct msgq *qp )
+{
+	return qp->head - qp->tail;
+}
+
+int
+msgq_drops ( struct msgq *qp )
+{
+	return qp->drops;
+}
+
+/* ---------------------------------------------------------- */
+/* Producer side */
+
+/* Returns the next free slot, or 0 if full.
+ * Calling this twice without a commit gives the same slot.
+ */
+void *
+msgq_reserve ( struct msgq *qp )
+{
+	unsigned int head = qp->head;
+
+	if ( head - qp->tail >= qp->num ) {
+	    qp->drops++;
+	    return (void *) 0;
+	}
+
+	msgq_barrier ();
+	return qp->slots + (head & (qp->num - 1)) * qp->size;
+}
+
+/* The slot from msgq_reserve() is ready for the consumer */
+void
+msgq_commit ( struct msgq *qp )
+{
+	msgq_barrier ();
+	qp->head++;
+
+	if ( qp->react )
+	    react_post ( qp->react - 1 );
+}
+
+/* ---------------------------------------------------------- */
+/* Consumer side */
+
+/* Returns the oldest message, or 0 if none.
+ * Calling this twice without a release gives the same one.
+ */
+void *
+msgq_get ( struct msgq *qp )
+{
+	unsigned int tail = qp->tail;
+
+	if ( qp->head == tail )
+	    return (void *) 0;
+
+	msgq_barrier ();
+	return qp->slots + (tail & (qp->num - 1)) * qp->size;
+}
+
+/* We are done with the message from msgq_get() */
+void
+msgq_release ( struct msgq *qp )
+{
+	msgq_barrier ();
+	qp->tail++;
+}
+
+/* Like msgq_get(), but sleep until there is something.
+ * Not for interrupt code, obviously.
+ * Interrupts are masked around the check and the wfi,
+ * the same trick as in react.c, so a commit in between
+ * can't be missed.
+ */
+void *
+msgq_wait ( struct msgq *qp )
+{
+	void *p;
+
+	for ( ;; ) {
+	    p = msgq_get ( qp );
+	    if ( p )
+		return p;
+	    irq_disable ();
+	    if ( qp->head == qp->tail )
+#ifdef __arm__
+		asm volatile ( "wfi" );
+#else
+		host_wfi ();
+#endif
+	    irq_enable ();
+	}
+}
+
+/* THE END */
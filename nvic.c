@@ -59,6 +59,12 @@ nvic_init ( void )
 	// Be sure the serial IO system is initialized
 	//  before printing from here.
 	// show_reg ( "nvic stir", &np->stir );
+}
+
+/* Not from nvic_init(), the console is slow, see boot.c */
+void
+nvic_show ( void )
+{
 	printf ( "Nvic initialized with %d IRQ\n", NUM_IRQ );
 }
 
@@ -75,4 +81,66 @@ nvic_enable ( int irq )
 	np->iser[irq/32] = 1 << (irq%32);
 }
 
+/* Priorities, 0 is the highest, and the STM32 only looks at
+ * the top 4 bits.  Everything comes up at 0, so nothing can
+ * preempt anything else until somebody changes that.
+ */
+#define SCB_SHPR3	((volatile unsigned int *) 0xE000ED20)
+
+void
+nvic_priority ( int irq, int pri )
+{
+	struct nvic *np = NVIC_BASE;
+
+	if ( irq < NUM_IRQ )
+	    np->ip[irq] = pri;
+}
+
+/* Every IRQ, and systick too (the top byte of SHPR3).
+ * Handy for putting one interrupt above all the rest
+ * (see prof.c).
+ */
+void
+nvic_priority_all ( int pri )
+{
+	struct nvic *np = NVIC_BASE;
+	int irq;
+
+	for ( irq=0; irq<NUM_IRQ; irq++ )
+	    np->ip[irq] = pri;
+
+	*SCB_SHPR3 = (*SCB_SHPR3 & 0x00ffffff) | (pri << 24);
+}
+
+/* Keep the priorities (IRQs and systick) as they are now,
+ * so they can be put back after nvic_priority_all().
+ * There is just the one place to keep them.
+ */
+static unsigned char saved_ip[NUM_IRQ];
+static unsigned int saved_shpr3;
+
+void
+nvic_priority_save ( void )
+{
+	struct nvic *np = NVIC_BASE;
+	int irq;
+
+	for ( irq=0; irq<NUM_IRQ; irq++ )
+	    saved_ip[irq] = np->ip[irq];
+
+	saved_shpr3 = *SCB_SHPR3;
+}
+
+void
+nvic_priority_restore ( void )
+{
+	struct nvic *np = NVIC_BASE;
+	int irq;
+
+	for ( irq=0; irq<NUM_IRQ; irq++ )
+	    np->ip[irq] = saved_ip[irq];
+
+	*SCB_SHPR3 = saved_shpr3;
+}
+
 /* THE END */
@@ -0,0 +1,203 @@
+/* prof.c
+ * (c) Tom Trebisky  10-19-2026
+ *
+ * A sampling profiler.
+ *
+ * TIM4 interrupts at some rate, above every other interrupt,
+ * and we note the pc and lr it interrupted.  Do that enough
+ * and the counts say where the time goes.
+ *
+ * The TIM4 vector goes to tim4_entry in locore, which hands
+ * us the exception frame and EXC_RETURN, as fault_entry does
+ * for faults.  The frame starts r0-r3, r12, lr, pc, xpsr on
+ * both the M3 and M4, whether or not the FPU registers got
+ * stacked after that (bit 4 of EXC_RETURN clear), so there
+ * is nothing more to it than frame[5] and frame[6].  The low
+ * bits of the stacked xpsr (IPSR) say if we interrupted some
+ * other handler, and which.
+ *
+ * Samples go in a little hash table, one entry for each
+ * (pc, lr, ipsr) with a count.  If it fills up (or a chain
+ * gets too long) the sample is counted as dropped.
+ *
+ *   prof_init ( 997 );	 TIM4 at 997 Hz (not in step with systick)
+ *   prof_start ();
+ *	...
+ *   prof_stop ();
+ *   prof_dump ( 0 );	 on the console, 1 for USB
+ *
+ * Tools/prof (make prof_report) turns the dump into a flat
+ * profile and folded stacks.  The lr is only the caller if
+ * the function hasn't called anything yet (a leaf, say), so
+ * the "stacks" are two deep at most and a little rough.
+ *
+ * Code that runs with interrupts masked (irq_disable) can't
+ * be sampled, its time shows up wherever it turns them back on.
+ * Also, while we run, every other interrupt (and systick) is
+ * down at PROF_OTHERS, so TIM4 is the only one that preempts.
+ * prof_start() saves the priorities before it does that, and
+ * prof_stop() puts them back.
+ */
+
+#include <stdarg.h>
+#include "hydra.h"
+
+#ifdef CHIP_F103
+#define PROF_SLOTS	128
+#else
+#define PROF_SLOTS	512
+#endif
+
+#define PROF_PROBE	8
+
+#define PROF_TIMER	TIMER4
+#define PROF_IRQ	30		/* TIM4 */
+#define PROF_OTHERS	0x40		/* everyone else */
+
+#define IPSR_MASK	0x1ff
+
+struct prof_slot {
+	unsigned int pc;
+	unsigned int lr;
+	unsigned int ipsr;
+	unsigned int count;
+};
+
+static struct prof_slot prof_table[PROF_SLOTS];
+
+static volatile int prof_running;
+static unsigned int prof_samples;
+static unsigned int prof_dropped;
+static int prof_hz;
+
+static void
+prof_sample ( unsigned int pc, unsigned int lr, unsigned int ipsr )
+{
+	struct prof_slot *sp;
+	unsigned int h;
+	int i;
+
+	prof_samples++;
+
+	h = (pc >> 1) + (lr >> 1) * 7 + ipsr;
+	for ( i=0; i<PROF_PROBE; i++ ) {
+	    sp = &prof_table[(h + i) & (PROF_SLOTS - 1)];
+	    if ( sp->count == 0 ) {
+		sp->pc = pc;
+		sp->lr = lr;
+		sp->ipsr = ipsr;
+		sp->count = 1;
+		return;
+	    }
+	    if ( sp->pc == pc && sp->lr == lr && sp->ipsr == ipsr ) {
+		sp->count++;
+		return;
+	    }
+	}
+
+	prof_dropped++;
+}
+
+/* From tim4_entry in locore */
+void
+prof_irq ( unsigned int *frame, unsigned int exc_return )
+{
+	if ( prof_running )
+	    prof_sample ( frame[6], frame[5], frame[7] & IPSR_MASK );
+
+	tim4_handler ();
+}
+
+void
+prof_clear ( void )
+{
+	irq_disable ();
+	memset ( prof_table, 0, sizeof(prof_table) );
+	prof_samples = 0;
+	prof_dropped = 0;
+	irq_enable ();
+}
+
+void
+prof_init ( int hz )
+{
+	prof_hz = hz;
+	prof_clear ();
+
+	timer_init ( PROF_TIMER, hz, 0, 0 );
+}
+
+void
+prof_start ( void )
+{
+	if ( prof_running )
+	    return;
+
+	nvic_priority_save ();
+	nvic_priority_all ( PROF_OTHERS );
+	nvic_priority ( PROF_IRQ, 0 );
+
+	prof_running = 1;
+	timer_start ( PROF_TIMER );
+}
+
+void
+prof_stop ( void )
+{
+	if ( ! prof_running )
+	    return;
+
+	timer_stop ( PROF_TIMER );
+	prof_running = 0;
+
+	nvic_priority_restore ();
+}
+
+/* ---------------------------------------------------------- */
+
+static int prof_usb;
+
+void asnprintf ( char *, unsigned int, const char *, va_list );
+
+static void
+prof_out ( char *fmt, ... )
+{
+	char buf[64];
+	va_list args;
+
+	va_start ( args, fmt );
+	asnprintf ( buf, sizeof(buf), fmt, args );
+	va_end ( args );
+
+#if defined(HYDRA_USB) && !defined(CHIP_F103)
+	if ( prof_usb ) {
+	    usb_puts ( buf );
+	    return;
+	}
+#endif
+	puts ( buf );
+}
+
+/* For Tools/prof, a header, then pc, lr, ipsr and count
+ * for each entry.  We don't sample ourself while at it.
+ */
+void
+prof_dump ( int usb )
+{
+	struct prof_slot *sp;
+	int was;
+
+	was = prof_running;
+	prof_running = 0;
+	prof_usb = usb;
+
+	prof_out ( "PROF BEGIN %d %d %d\n", prof_hz, prof_samples, prof_dropped );
+	for ( sp = prof_table; sp < &prof_table[PROF_SLOTS]; sp++ )
+	    if ( sp->count )
+		prof_out ( "%X %X %d %d\n", sp->pc, sp->lr, sp->ipsr, sp->count );
+	prof_out ( "PROF END\n" );
+
+	prof_running = was;
+}
+
+/* THE END */
@@ -0,0 +1,272 @@
+/* qemu.c
+ * (c) Tom Trebisky  10-19-2026
+ *
+ * System tests under QEMU, see "make qemu" and Tools/qemu_run.c
+ *
+ * QEMU's olimex-stm32-h405 machine is an F405 like my P405
+ * board, so we build for p405 with -DHYDRA_QEMU, which leaves
+ * out what QEMU doesn't have (the RCC and USB) and counts
+ * cycles with systick (QEMU has no DWT).
+ *
+ * startup() calls qemu_main(), which reads commands from the
+ * console, one per line, a scenario name and a number:
+ *
+ *   storm 32     - 32 repeats at 1-4 ms for STORM_MS
+ *   flood 200    - 200 lines out the console
+ *   cancel 500   - 500 events, each cancelled as it comes due
+ *   idle 100     - do nothing for 100 ms, for a baseline
+ *
+ * Each one prints "STAT name value" lines as it likes and
+ * then "RESULT name arg cycles status", where status is 0
+ * unless something went wrong.  Then we print "READY" and
+ * wait for the next command.  An empty line just gets READY,
+ * QEMU throws away what we send before anyone opens the pty.
+ */
+
+#include "hydra.h"
+
+#define LINE_SIZE	64
+
+#define STORM_MS	500
+#define MAX_STORM	64
+
+struct scenario {
+	char *name;
+	int (*fn) ( int );
+};
+
+/* ---------------------------------------------------------- */
+
+static volatile int storm_hits;
+
+static void
+storm_fn ( void )
+{
+	storm_hits++;
+}
+
+/* Lots of repeats, at the rates that all land on the same tick
+ * now and then, and see what that does to event_tick.
+ */
+static int
+qemu_storm ( int n )
+{
+	int ids[MAX_STORM];
+	int calls, avg, max;
+	int i;
+
+	if ( n > MAX_STORM )
+	    n = MAX_STORM;
+
+	storm_hits = 0;
+	for ( i=0; i<n; i++ )
+	    ids[i] = repeat ( 1 + i % 4, storm_fn );
+
+	tick_stats ( &calls, &avg, &max );
+	delay ( STORM_MS );
+	tick_stats ( &calls, &avg, &max );
+
+	for ( i=0; i<n; i++ )
+	    repeat_cancel ( ids[i] );
+
+	printf ( "STAT hits %d\n", storm_hits );
+	printf ( "STAT ticks %d\n", calls );
+	printf ( "STAT tick_avg %d\n", avg );
+	printf ( "STAT tick_max %d\n", max );
+
+	return calls == 0;
+}
+
+/* Blocking console output */
+static int
+qemu_flood ( int n )
+{
+	unsigned int t;
+	int i;
+
+	t = get_cycles ();
+	for ( i=0; i<n; i++ )
+	    printf ( "flood %d 0123456789abcdefghijklmnopqrstuvwxyz\n", i );
+	t = get_cycles () - t;
+
+	printf ( "STAT per_line %d\n", t / n );
+	return 0;
+}
+
+/* ---------------------------------------------------------- */
+
+static volatile int cancel_fired;
+static volatile int cancel_done;
+static volatile int cancel_late;
+static volatile int victim_id;
+static volatile int victim_fired;
+
+static void
+cancel_fn ( void )
+{
+	cancel_fired = 1;
+	if ( cancel_done )
+	    cancel_late++;
+}
+
+/* From interrupt level, cancel the event due one tick later */
+static void
+killer_fn ( void )
+{
+	event_cancel ( victim_id );
+}
+
+static void
+victim_fn ( void )
+{
+	victim_fired++;
+}
+
+/* Each event is cancelled from the main line just about when
+ * it comes due (the spin moves that around), so sometimes the
+ * tick gets it first and sometimes we do.  Either way it has
+ * to happen exactly once.  Meanwhile a pair of events where
+ * the first cancels the second from interrupt level keeps the
+ * list busy, the second must never run.
+ */
+static int
+qemu_cancel ( int n )
+{
+	int fired = 0;
+	int cancelled = 0;
+	int spin;
+	int id;
+	int i;
+
+	cancel_late = 0;
+	victim_fired = 0;
+
+	for ( i=0; i<n; i++ ) {
+	    if ( (i % 16) == 0 ) {
+		victim_id = event ( 3, victim_fn );
+		event ( 2, killer_fn );
+	    }
+
+	    cancel_fired = 0;
+	    cancel_done = 0;
+	    id = event ( 1, cancel_fn );
+
+	    /* up to a little over a ms at 168 Mhz */
+	    for ( spin = (i * 7919) % 60000; spin; spin-- )
+		;
+
+	    event_cancel ( id );
+	    cancel_done = 1;
+
+	    if ( cancel_fired )
+		fired++;
+	    else
+		cancelled++;
+	}
+
+	/* anything still out there */
+	delay ( 10 );
+
+	printf ( "STAT fired %d\n", fired );
+	printf ( "STAT cancelled %d\n", cancelled );
+	printf ( "STAT late %d\n", cancel_late );
+	printf ( "STAT victims %d\n", victim_fired );
+
+	return cancel_late + victim_fired + (fired + cancelled != n);
+}
+
+static int
+qemu_idle ( int ms )
+{
+	delay ( ms );
+	return 0;
+}
+
+/* ---------------------------------------------------------- */
+
+static struct scenario scenarios[] = {
+	{ "storm",	qemu_storm },
+	{ "flood",	qemu_flood },
+	{ "cancel",	qemu_cancel },
+	{ "idle",	qemu_idle },
+};
+
+#define NUM_SCENARIOS	(sizeof(scenarios) / sizeof(scenarios[0]))
+
+static void
+get_line ( char *buf, int size )
+{
+	int n = 0;
+	int c;
+
+	for ( ;; ) {
+	    c = getc ();
+	    if ( c == '\n' )
+		break;
+	    if ( n < size - 1 )
+		buf[n++] = c;
+	}
+	buf[n] = '\0';
+}
+
+/* "name 123" - we stop the name at the blank */
+static int
+get_arg ( char *buf )
+{
+	int val = 0;
+
+	while ( *buf && *buf != ' ' )
+	    buf++;
+	if ( *buf )
+	    *buf++ = '\0';
+
+	while ( *buf >= '0' && *buf <= '9' )
+	    val = val * 10 + *buf++ - '0';
+
+	return val;
+}
+
+static int
+same ( char *a, char *b )
+{
+	while ( *a && *a == *b ) {
+	    a++;
+	    b++;
+	}
+	return *a == *b;
+}
+
+void
+qemu_main ( void )
+{
+	char line[LINE_SIZE];
+	struct scenario *sp;
+	unsigned int t;
+	int status;
+	int arg;
+
+	for ( ;; ) {
+	    printf ( "READY\n" );
+	    get_line ( line, LINE_SIZE );
+	    if ( line[0] == '\0' )
+		continue;
+	    arg = get_arg ( line );
+
+	    for ( sp = scenarios; sp < &scenarios[NUM_SCENARIOS]; sp++ )
+		if ( same ( sp->name, line ) )
+		    break;
+
+	    if ( sp == &scenarios[NUM_SCENARIOS] ) {
+		printf ( "RESULT %s %d 0 -1\n", line, arg );
+		continue;
+	    }
+
+	    t = get_cycles ();
+	    status = (*sp->fn) ( arg );
+	    t = get_cycles () - t;
+
+	    printf ( "RESULT %s %d %d %d\n", sp->name, arg, t, status );
+	}
+}
+
+/* THE END */
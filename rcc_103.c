@@ -99,7 +99,19 @@ struct rcc {
 /* It works to run at 80, but we may warp the universe ... */
 #define PLL_10		(8<<18)	/* XXX - danger !! */
 
-/* These must be maintained by hand */
+/* In general, multiply by n (2 to 16) */
+#define PLL_MUL(n)	(((n)-2)<<18)
+
+#define USB_NODIV	0x400000	/* PLL/1 to USB, else PLL/1.5 */
+
+#define SYS_BITS	0x03
+#define SYS_STATUS_SHIFT	2
+
+#define HSE_HZ		8000000
+#define MAX_CPU		72000000
+#define MAX_PCLK1	36000000
+
+/* What rcc_clocks() sets up, rcc_set_sysclk() can change it */
 #define PCLK1		36000000
 #define PCLK2		72000000
 #define CPU_HZ          72000000
@@ -168,6 +180,8 @@ rcc_bus_init ( void )
 	rp->apb1_enr |= UART3_ENABLE;
 
 	rp->apb1_enr |= TIMER2_ENABLE;
+	rp->apb1_enr |= TIMER3_ENABLE;
+	rp->apb1_enr |= TIMER4_ENABLE;
 	rp->apb1_enr |= I2C1_ENABLE;
 	rp->apb1_enr |= I2C2_ENABLE;
 
@@ -212,22 +226,152 @@ rcc_show ( void )
 
 /* ================================================================ */
 
+static int cpu_hz = CPU_HZ;
+static int pclk1 = PCLK1;
+static int pclk2 = PCLK2;
+
 int
 get_pclk1 ( void )
 {
-	return PCLK1;
+	return pclk1;
 }
 
 int
 get_pclk2 ( void )
 {
-	return PCLK2;
+	return pclk2;
 }
 
 int
 get_cpu_hz ( void )
 {
-        return CPU_HZ;
+        return cpu_hz;
+}
+
+/* ================================================================ */
+/* Changing the clock on the fly, see rcc_411.c for the story.
+ */
+
+#define MAX_NOTIFY	8
+
+static ifptr rcc_notifiers[MAX_NOTIFY];
+static int num_notify;
+
+void
+rcc_notify ( ifptr fn )
+{
+	if ( num_notify < MAX_NOTIFY )
+	    rcc_notifiers[num_notify++] = fn;
+}
+
+static void
+rcc_notify_all ( int what )
+{
+	int i;
+
+	for ( i=0; i<num_notify; i++ )
+	    (*rcc_notifiers[i]) ( what );
+}
+
+static int
+flash_waits_for ( int hz )
+{
+	if ( hz <= 24000000 )
+	    return 0;
+	if ( hz <= 48000000 )
+	    return 1;
+	return 2;
+}
+
+/* The PLL here is simple, HSE or HSE/2 times 2 to 16.
+ * USB needs the PLL at 48 or 72.
+ * APB1 is always divided by at least 2 (see timer.c)
+ * and by 4 if that isn't enough.  APB2 can always be 72.
+ * Returns 0 if all is well, -1 if we can't get hz.
+ */
+int
+rcc_set_sysclk ( int hz )
+{
+	struct rcc *rp = RCC_BASE;
+	unsigned int cfg;
+	int pre, mul;
+	int waits, old_waits;
+	int div1;
+
+	if ( hz > MAX_CPU )
+	    return -1;
+
+	for ( pre=1; pre<=2; pre++ ) {
+	    mul = hz / (HSE_HZ / pre);
+	    if ( mul >= 2 && mul <= 16 && mul * (HSE_HZ / pre) == hz )
+		break;
+	}
+	if ( pre > 2 )
+	    return -1;
+
+	cfg = (pre == 1 ? PLL_HSE : PLL_HSE2) | PLL_MUL(mul);
+
+	div1 = 2;
+	cfg |= APB1_DIV2;
+	if ( hz / 2 > MAX_PCLK1 ) {
+	    div1 = 4;
+	    cfg = (cfg & ~APB1_DIV2) | APB1_DIV4;
+	}
+
+	if ( hz == 48000000 )
+	    cfg |= USB_NODIV;
+
+	waits = flash_waits_for ( hz );
+	old_waits = flash_waits_for ( cpu_hz );
+
+	rcc_notify_all ( RCC_CHANGING );
+
+	irq_disable ();
+
+	if ( waits > old_waits )
+	    flash_init ( waits );
+
+	/* Over to the HSI, and stop the PLL
+	 * (see above about writing the whole ccr)
+	 */
+	rp->cfg = (rp->cfg & ~SYS_BITS) | SYS_HSI;
+	while ( (rp->cfg >> SYS_STATUS_SHIFT) & SYS_BITS )
+	    ;
+	rp->ccr = CCR_NORM;
+	while ( rp->ccr & PLL_LOCK )
+	    ;
+
+	rp->cfg = cfg | SYS_HSI;
+	rp->ccr = CCR_NORM | PLL_ENABLE;
+	while ( ! (rp->ccr & PLL_LOCK ) )
+	   ;
+
+	rp->cfg = cfg | SYS_PLL;
+	while ( ((rp->cfg >> SYS_STATUS_SHIFT) & SYS_BITS) != SYS_PLL )
+	    ;
+
+	if ( waits < old_waits )
+	    flash_init ( waits );
+
+	cpu_hz = hz;
+	pclk1 = hz / div1;
+	pclk2 = hz;
+
+	irq_enable ();
+
+	rcc_notify_all ( RCC_CHANGED );
+
+	return 0;
+}
+
+int
+get_usb_hz ( void )
+{
+	unsigned int cfg = ((struct rcc *) RCC_BASE)->cfg;
+
+	if ( cfg & USB_NODIV )
+	    return cpu_hz;
+	return cpu_hz * 2 / 3;
 }
 
 /* THE END */
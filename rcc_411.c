@@ -55,6 +55,9 @@ struct rcc {
 #define CONF_HSI		0x0
 #define CONF_HSE		0x1
 #define CONF_PLL		0x2
+#define CONF_STATUS_SHIFT	2
+
+#define CONF_APB_BITS		0xfc00
 
 #define APB1_SHIFT	10
 #define APB2_SHIFT	13
@@ -62,6 +65,8 @@ struct rcc {
 #define APB_DIV1	0
 #define APB_DIV2	4
 #define APB_DIV4	5
+#define APB_DIV8	6
+#define APB_DIV16	7
 
 /* Mux control for MCO1 and MCO2 */
 #define MCO2_SYSCLK     0
@@ -97,13 +102,21 @@ struct rcc {
 #define GPIOJ_ENABLE	0x200
 #define GPIOK_ENABLE	0x400
 
+#define DMA1_ENABLE	BIT(21)
+#define DMA2_ENABLE	BIT(22)
+
 #define USB_HS_ENABLE	0x20000000
 
 /* On AHB2 */
 #define USB_ENABLE	0x80
 
 /* On APB1 */
+#define TIM2_ENABLE	0x01
+#define TIM3_ENABLE	0x02
+#define TIM4_ENABLE	0x04
+#define TIM5_ENABLE	0x08
 #define UART2_ENABLE	0x20000
+#define PWR_ENABLE	BIT(28)
 
 /* On APB2 */
 #define UART1_ENABLE	0x10
@@ -336,6 +349,71 @@ cpu_clock_init_pll_f407 ( void )
 	rp->conf = xyz;
 }
 
+/* The F429 can run at 180 Mhz, but only with the regulator
+ * at voltage scale 1 and in "over-drive" mode.  168 and below
+ * is fine without over-drive.  See section 5.1.4 in RM0090.
+ * The scale can only be changed with the PLL off, and the
+ * over-drive only while running from HSI or HSE.
+ *
+ * Sadly there is no way to get 48 Mhz for USB at 180.
+ * The 48 Mhz clock is PLL/Q (360/7.5 is what we would want)
+ * and on the F429 the PLLSAI can't be used for it (that takes
+ * an F446 or F469), so at 180 Mhz USB is out of the question.
+ */
+#ifdef CHIP_F429
+struct pwr {
+	volatile unsigned int cr;	/* 0 */
+	volatile unsigned int csr;	/* 4 */
+};
+
+#define PWR_BASE	(struct pwr *) 0x40007000
+
+#define PWR_CR_VOS_BITS	(3<<14)
+#define PWR_CR_VOS1	(3<<14)
+#define PWR_CR_ODEN	BIT(16)
+#define PWR_CR_ODSWEN	BIT(17)
+
+#define PWR_CSR_ODRDY	BIT(16)
+#define PWR_CSR_ODSWRDY	BIT(17)
+
+/* Above this we need over-drive */
+#define OVERDRIVE_HZ	168000000
+
+/* With the PLL off */
+static void
+pwr_scale1 ( void )
+{
+	struct rcc *rp = RCC_BASE;
+	struct pwr *pp = PWR_BASE;
+
+	rp->apb1_e |= PWR_ENABLE;
+	(void) rp->apb1_e;
+
+	pp->cr = (pp->cr & ~PWR_CR_VOS_BITS) | PWR_CR_VOS1;
+}
+
+/* Not running from the PLL */
+static void
+pwr_overdrive ( int on )
+{
+	struct pwr *pp = PWR_BASE;
+
+	if ( on ) {
+	    pp->cr |= PWR_CR_ODEN;
+	    while ( ! (pp->csr & PWR_CSR_ODRDY) )
+		;
+	    pp->cr |= PWR_CR_ODSWEN;
+	    while ( ! (pp->csr & PWR_CSR_ODSWRDY) )
+		;
+	} else {
+	    pp->cr &= ~PWR_CR_ODSWEN;
+	    while ( pp->csr & PWR_CSR_ODSWRDY )
+		;
+	    pp->cr &= ~PWR_CR_ODEN;
+	}
+}
+#endif
+
 /* The MCO fields come set to all zeros
  * So, no prescaler and
  * PC9 = MCO2 is SYSCLK
@@ -396,6 +474,7 @@ cpu_clock_init ( void )
 {
 #ifdef CHIP_F429
 	flash_init ( 5 );
+	pwr_scale1 ();
 	cpu_clock_init_pll_f429 ();
 #elif CHIP_F405
 	// Same as the F429 here
@@ -436,8 +515,16 @@ rcc_bus_init ( void )
 	rp->ahb1_e |= GPIOJ_ENABLE;
 	rp->ahb1_e |= GPIOK_ENABLE;
 
+	rp->ahb1_e |= DMA1_ENABLE;
+	rp->ahb1_e |= DMA2_ENABLE;
+
 	rp->apb1_e |= UART2_ENABLE;
 
+	rp->apb1_e |= TIM2_ENABLE;
+	rp->apb1_e |= TIM3_ENABLE;
+	rp->apb1_e |= TIM4_ENABLE;
+	rp->apb1_e |= TIM5_ENABLE;
+
 	/* This is the FS OTG USB, which is
 	 * the only one on the F411.
 	 */
@@ -467,8 +554,18 @@ rcc_bus_init ( void )
 void
 rcc_init ( void )
 {
+	/* QEMU has no RCC, every read is 0 and we would wait for
+	 * the PLL forever.  It runs at 168 Mhz, just as we would.
+	 */
+#ifndef HYDRA_QEMU
 	cpu_clock_init ();
 	rcc_bus_init ();
+#endif
+
+#ifdef F429_OVERDRIVE
+	/* 180 Mhz, see above.  No USB. */
+	rcc_set_sysclk ( 180000000 );
+#endif
 }
 
 /* On the Black Pill boards that I have, we have an external
@@ -482,6 +579,10 @@ rcc_init ( void )
  *
  * There is also a 16 Mhz RC internal oscillator (HSI)
  * The chip fires up using it.
+ *
+ * The values here are what the boot code above sets up,
+ * rcc_set_sysclk() below can change them later.
+ * The limits are from the datasheets, at 3.3 volts.
  */
 
 /* for F407, my Olimex E407 board
@@ -492,6 +593,10 @@ rcc_init ( void )
 #define PCLK1           42000000
 #define PCLK2           84000000    // used by UART1
 #define CPU_HZ          168000000
+#define HSE_HZ		12000000
+#define MAX_CPU		168000000
+#define MAX_PCLK1	42000000
+#define MAX_PCLK2	84000000
 #endif
 
 /* This is my Olimex P405 board
@@ -503,13 +608,24 @@ rcc_init ( void )
 #define PCLK1           42000000
 #define PCLK2           84000000
 #define CPU_HZ          168000000
+#define HSE_HZ		8000000
+#define MAX_CPU		168000000
+#define MAX_PCLK1	42000000
+#define MAX_PCLK2	84000000
 #endif
 
+/* The F429 can go to 180, but only with over-drive,
+ * see pwr_overdrive() above.
+ */
 #ifdef CHIP_F429
 #define CPU_NAME        "F429"
 #define PCLK1           42000000
 #define PCLK2           84000000
 #define CPU_HZ          168000000
+#define HSE_HZ		8000000
+#define MAX_CPU		180000000
+#define MAX_PCLK1	45000000
+#define MAX_PCLK2	90000000
 #endif
 
 /* Correct for F411 at 96 Mhz */
@@ -518,6 +634,10 @@ rcc_init ( void )
 #define PCLK1           48000000
 #define PCLK2           96000000
 #define CPU_HZ          96000000
+#define HSE_HZ		25000000
+#define MAX_CPU		100000000
+#define MAX_PCLK1	50000000
+#define MAX_PCLK2	100000000
 #endif
 
 /* Retained for historical amusement */
@@ -528,10 +648,15 @@ rcc_init ( void )
 // #define PCLK_F429       32000000
 // #define PCLK_F429       30720000
 
+static int cpu_hz = CPU_HZ;
+static int pclk1 = PCLK1;
+static int pclk2 = PCLK2;
+static int usb_hz = 48000000;
+
 int
 get_cpu_hz ( void )
 {
-	return CPU_HZ;
+	return cpu_hz;
 }
 
 /* PCLK1 must not exceed 50.
@@ -539,13 +664,247 @@ get_cpu_hz ( void )
 int
 get_pclk1 ( void )
 {
-        return PCLK1;
+        return pclk1;
 }
 
 int
 get_pclk2 ( void )
 {
-        return PCLK2;
+        return pclk2;
+}
+
+/* ===================================================================================== */
+/* Changing the clock on the fly.
+ *
+ * Anybody who computed something from the clock (baud rates,
+ * the systick reload, delay loops, timers) calls rcc_notify()
+ * and gets called with RCC_CHANGING just before a change and
+ * with RCC_CHANGED just after.  These calls are not at interrupt
+ * level, but interrupts may be coming in with the new clock
+ * before the RCC_CHANGED call gets to you.
+ */
+
+#define MAX_NOTIFY	8
+
+static ifptr rcc_notifiers[MAX_NOTIFY];
+static int num_notify;
+
+void
+rcc_notify ( ifptr fn )
+{
+	if ( num_notify < MAX_NOTIFY )
+	    rcc_notifiers[num_notify++] = fn;
+}
+
+static void
+rcc_notify_all ( int what )
+{
+	int i;
+
+	for ( i=0; i<num_notify; i++ )
+	    (*rcc_notifiers[i]) ( what );
+}
+
+/* Flash wait states for a given clock, see the tables
+ * above cpu_clock_init()
+ */
+static int
+flash_waits_for ( int hz )
+{
+#if defined(CHIP_F429) || defined(CHIP_F407) || defined(CHIP_F405)
+	return (hz - 1) / 30000000;
+#else
+	if ( hz <= 30000000 )
+	    return 0;
+	if ( hz <= 64000000 )
+	    return 1;
+	if ( hz <= 90000000 )
+	    return 2;
+	return 3;
+#endif
+}
+
+/* The smallest APB divider that keeps us under max,
+ * but never 1 for APB1, see get_timer_hz() in timer.c
+ */
+static int
+apb_div ( int hz, int max, int min_div, int *code )
+{
+	static const char codes[] = { APB_DIV1, APB_DIV2, APB_DIV4, APB_DIV8, APB_DIV16 };
+	int i;
+
+	for ( i=0; i<4; i++ ) {
+	    if ( (1<<i) >= min_div && hz >> i <= max )
+		break;
+	}
+	*code = codes[i];
+	return 1 << i;
+}
+
+struct pll_setup {
+	int m, n, p, q;
+	int usb;	/* 1 if we get an exact 48 for USB */
+};
+
+/* Find a PLL setup that gives exactly hz.
+ * VCO in must be 1 to 2 Mhz (2 is better for jitter),
+ * VCO out 100 to 432 Mhz, N 50 to 432, P 2,4,6,8, Q 2 to 15.
+ * We would like VCO/Q to be 48 Mhz for USB, and take a
+ * setup without that only if there is nothing else.
+ * Among equals, the fastest VCO in wins.
+ * Returns 0, or -1 if there is no way to get hz.
+ */
+static int
+pll_solve ( int hz, struct pll_setup *sp )
+{
+	int m, p, q;
+	int vco_in, vco;
+	int usb;
+	int score;
+	int best = 0;
+
+	for ( m=2; m<=63; m++ ) {
+	    if ( HSE_HZ % m )
+		continue;
+	    vco_in = HSE_HZ / m;
+	    if ( vco_in < 1000000 || vco_in > 2000000 )
+		continue;
+
+	    for ( p=2; p<=8; p += 2 ) {
+		if ( hz > 432000000 / p )
+		    continue;
+		vco = hz * p;
+		if ( vco < 100000000 || (vco % vco_in) )
+		    continue;
+
+		/* The 48 Mhz clock must not go over 48 */
+		q = (vco + 48000000 - 1) / 48000000;
+		if ( q < 2 )
+		    q = 2;
+		if ( q > 15 )
+		    continue;
+		usb = vco == q * 48000000;
+
+		score = usb * 4000000 + vco_in;
+		if ( score <= best )
+		    continue;
+
+		best = score;
+		sp->m = m;
+		sp->n = vco / vco_in;
+		sp->p = p;
+		sp->q = q;
+		sp->usb = usb;
+	    }
+	}
+
+	return best ? 0 : -1;
+}
+
+/* Switch the CPU clock to hz, which must be something the
+ * PLL can make exactly from the crystal.
+ * Returns 0 if all is well, -1 if we can't do it.
+ * If the USB clock can't be 48 Mhz at this speed we still
+ * go ahead (get_usb_hz() will tell), USB won't work though.
+ *
+ * We run on the HSI while we fool with the PLL.
+ * The flash needs more wait states before we speed up,
+ * and can have fewer after we slow down.
+ * APB1 and APB2 get the smallest dividers they can have.
+ * On the F429 we also switch over-drive on (above 168)
+ * or off, again while on the HSI.
+ */
+int
+rcc_set_sysclk ( int hz )
+{
+	struct rcc *rp = RCC_BASE;
+	struct pll_setup pll;
+	unsigned int xyz;
+	int waits, old_waits;
+	int div1, div2;
+	int code1, code2;
+
+	if ( hz > MAX_CPU || pll_solve ( hz, &pll ) )
+	    return -1;
+
+	waits = flash_waits_for ( hz );
+	old_waits = flash_waits_for ( cpu_hz );
+
+	div1 = apb_div ( hz, MAX_PCLK1, 2, &code1 );
+	div2 = apb_div ( hz, MAX_PCLK2, 1, &code2 );
+
+	rcc_notify_all ( RCC_CHANGING );
+
+	irq_disable ();
+
+	if ( waits > old_waits )
+	    flash_init ( waits );
+
+	/* Over to the HSI */
+	rp->conf &= ~CONF_CLOCK_BITS;
+	while ( (rp->conf >> CONF_STATUS_SHIFT) & CONF_CLOCK_BITS )
+	    ;
+
+#ifdef CHIP_F429
+	if ( cpu_hz > OVERDRIVE_HZ )
+	    pwr_overdrive ( 0 );
+#endif
+
+	rp->cr &= ~CR_PLLON;
+	while ( rp->cr & CR_PLLRDY )
+	    ;
+
+#ifdef CHIP_F429
+	pwr_scale1 ();
+#endif
+
+	xyz = rp->pll & PLL_RESERVED;
+	xyz |= pll.m;
+	xyz |= pll.n << PLL_N_SHIFT;
+	xyz |= (pll.p/2 - 1) << PLL_P_SHIFT;
+	xyz |= pll.q << PLL_Q_SHIFT;
+	xyz |= PLL_SRC_HSE;
+	rp->pll = xyz;
+
+	rp->cr |= CR_PLLON;
+
+#ifdef CHIP_F429
+	if ( hz > OVERDRIVE_HZ )
+	    pwr_overdrive ( 1 );
+#endif
+
+	while ( ! (rp->cr & CR_PLLRDY) )
+	    ;
+
+	/* New APB dividers, and back to the PLL */
+	xyz = rp->conf;
+	xyz &= ~(CONF_APB_BITS | CONF_CLOCK_BITS);
+	xyz |= code1 << APB1_SHIFT;
+	xyz |= code2 << APB2_SHIFT;
+	xyz |= CONF_PLL;
+	rp->conf = xyz;
+	while ( ((rp->conf >> CONF_STATUS_SHIFT) & CONF_CLOCK_BITS) != CONF_PLL )
+	    ;
+
+	if ( waits < old_waits )
+	    flash_init ( waits );
+
+	cpu_hz = hz;
+	pclk1 = hz / div1;
+	pclk2 = hz / div2;
+	usb_hz = hz * pll.p / pll.q;
+
+	irq_enable ();
+
+	rcc_notify_all ( RCC_CHANGED );
+
+	return 0;
+}
+
+int
+get_usb_hz ( void )
+{
+	return usb_hz;
 }
 
 char *
@@ -568,6 +927,7 @@ rcc_show ( void )
     printf ( "%s cpu running at %d Hz\n", get_chip_name(), get_cpu_hz() );
     printf ( " Pclk1 (slow) = %d Hz\n", get_pclk1() );
     printf ( " Pclk2 (fast) = %d Hz\n", get_pclk2() );
+    printf ( " USB clock = %d Hz\n", get_usb_hz() );
 
 	// both are zero
 	// printf ( " RCC ahb1 reset = %X\n", rp->ahb1_r );
@@ -0,0 +1,315 @@
+/* react.c
+ * (c) Tom Trebisky  10-19-2026
+ *
+ * A little "reactor" for the main loop.
+ *
+ * Up to now user code waited for things by spinning on them,
+ * usb_read() for example returns 0 at a ferocious rate.
+ * Here interrupt code (the uart, USB, exti, or a timer) posts
+ * a "source" by setting its bit in a ready mask, and the main
+ * loop sleeps in wfi until some bit is set, then calls the
+ * handler for each set bit, lowest bit first.
+ * There are 32 sources, all in static tables, so posting and
+ * dispatch never allocate anything.
+ *
+ * Posting is a ldrex/strex or into the mask, so it is safe
+ * from any interrupt level (and we don't have to touch PRIMASK
+ * from inside an interrupt handler).  Posting a source that
+ * is already ready does nothing, the handler gets called once
+ * and should deal with everything that has arrived.
+ *
+ * We also keep track of how long it takes from the (first) post
+ * to the handler getting called, and how much of the time the
+ * processor is awake at all.  We only count cycles while awake
+ * (the DWT counter may or may not run during wfi) and compare
+ * that to systick time.
+ */
+
+#include "hydra.h"
+
+#define NUM_REACT	32
+
+struct react {
+	vfptr fn;
+	int period;		/* ms, for timer sources */
+	int count;
+	unsigned int posted;	/* cycle count at the first post */
+	int calls;
+	unsigned int lat_min;	/* cycles from post to handler */
+	unsigned int lat_max;
+	unsigned int lat_avg;	/* running average, scaled by 16 */
+};
+
+static struct react react_info[NUM_REACT] HYDRA_CCM;
+static int num_react;
+
+static volatile unsigned int react_ready;
+
+static int react_timers;
+
+/* For the idle statistics */
+static unsigned int wake_time;
+static unsigned int awake_cycles;
+static unsigned int wakeups;
+static unsigned int stat_ticks;
+
+/* Returns the id for react_post(), or -1 if we are full.
+ * Call this from ordinary code, not from interrupts.
+ */
+int
+react_add ( vfptr fn )
+{
+	struct react *rp;
+
+	if ( num_react >= NUM_REACT )
+	    return -1;
+
+	rp = &react_info[num_react];
+	rp->fn = fn;
+	rp->period = 0;
+	rp->calls = 0;
+	rp->lat_min = 0xffffffff;
+	rp->lat_max = 0;
+	rp->lat_avg = 0;
+
+	return num_react++;
+}
+
+/* Safe to call from anywhere, including interrupt code.
+ * An id we never handed out (say the -1 from a react_add()
+ * that failed) is ignored, BIT(-1) would be garbage.
+ */
+void
+react_post ( int id )
+{
+	unsigned int bit;
+
+	if ( id < 0 || id >= num_react )
+	    return;
+
+	bit = BIT(id);
+
+	/* If it is already ready, the first post time stands */
+	if ( ! (react_ready & bit) )
+	    react_info[id].posted = get_cycles ();
+
+	__atomic_fetch_or ( &react_ready, bit, __ATOMIC_RELEASE );
+}
+
+/* ---------------------------------------------------------- */
+
+/* Timer sources all run from one repeat (see event.c) */
+static void
+react_tick ( void )
+{
+	struct react *rp;
+	int id;
+
+	for ( id=0; id<num_react; id++ ) {
+	    rp = &react_info[id];
+	    if ( rp->period == 0 )
+		continue;
+	    if ( --rp->count < 1 ) {
+		rp->count = rp->period;
+		react_post ( id );
+	    }
+	}
+}
+
+/* fn gets called (from the main loop) every ms milliseconds */
+int
+react_timer ( int ms, vfptr fn )
+{
+	int id;
+
+	id = react_add ( fn );
+	if ( id < 0 )
+	    return id;
+
+	irq_disable ();
+	react_info[id].count = ms;
+	react_info[id].period = ms;
+	irq_enable ();
+
+	if ( ! react_timers++ )
+	    repeat ( 1, react_tick );
+
+	return id;
+}
+
+/* ---------------------------------------------------------- */
+
+/* A uart source.  The interrupt puts each byte into the ring
+ * and posts, the handler gets them out with ring_get() or
+ * ring_read() and so on.
+ */
+static struct ring *uart_ring[2];
+static int uart_react[2];
+static int uart_overruns;
+
+static void
+uart_rx ( int uart, int c )
+{
+	if ( ring_put ( uart_ring[uart], c ) )
+	    uart_overruns++;
+	react_post ( uart_react[uart] );
+}
+
+static void uart1_rx ( int c ) { uart_rx ( UART1, c ); }
+static void uart2_rx ( int c ) { uart_rx ( UART2, c ); }
+
+int
+react_uart ( int uart, struct ring *rp, vfptr fn )
+{
+	int id;
+
+	if ( uart != UART1 && uart != UART2 )
+	    return -1;
+
+	id = react_add ( fn );
+	if ( id < 0 )
+	    return id;
+
+	uart_ring[uart] = rp;
+	uart_react[uart] = id;
+
+	serial_read_hookup ( uart, uart == UART1 ? uart1_rx : uart2_rx );
+
+	return id;
+}
+
+/* An exti source (a button or some such).
+ * edge is EXTI_RISING, EXTI_FALLING, or EXTI_BOTH
+ * The handler can get the time of the edge from exti_stamp().
+ */
+int
+react_exti ( int gpio, int pin, int edge, vfptr fn )
+{
+	int id;
+
+	id = react_add ( fn );
+	if ( id < 0 )
+	    return id;
+
+	exti_setup_edge ( gpio, pin, edge, (vfptr) 0 );
+	exti_post ( pin, id );
+
+	return id;
+}
+
+/* ---------------------------------------------------------- */
+
+static void
+react_dispatch ( unsigned int ready )
+{
+	struct react *rp;
+	unsigned int lat;
+	int id;
+
+	while ( ready ) {
+	    id = __builtin_ctz ( ready );
+	    ready &= ready - 1;
+
+	    rp = &react_info[id];
+	    lat = get_cycles () - rp->posted;
+	    if ( lat < rp->lat_min )
+		rp->lat_min = lat;
+	    if ( lat > rp->lat_max )
+		rp->lat_max = lat;
+	    rp->lat_avg += lat - (rp->lat_avg >> 4);
+	    rp->calls++;
+
+	    (*rp->fn) ();
+	}
+}
+
+/* Sleep until something is ready, then run the handlers.
+ * Interrupts are masked while we check the mask and go into
+ * wfi, so a post that comes in between still wakes us up
+ * (wfi wakes for a pending interrupt even when masked), and
+ * the handler runs as soon as we unmask.
+ */
+void
+react_once ( void )
+{
+	unsigned int ready;
+
+	irq_disable ();
+	if ( ! react_ready ) {
+	    awake_cycles += get_cycles () - wake_time;
+#ifdef __arm__
+	    asm volatile ( "wfi" );
+#else
+	    host_wfi ();
+#endif
+	    wake_time = get_cycles ();
+	    wakeups++;
+	}
+	irq_enable ();
+
+	ready = __atomic_exchange_n ( &react_ready, 0, __ATOMIC_ACQUIRE );
+	react_dispatch ( ready );
+}
+
+/* The main loop, never returns.
+ * Any init put off at boot happens before we first sleep.
+ */
+void
+react_run ( void )
+{
+	boot_late ();
+	wake_time = get_cycles ();
+	for ( ;; )
+	    react_once ();
+}
+
+/* Without overflow for anything up to the 25 seconds */
+static int
+cycles_ns ( unsigned int cycles, int mhz )
+{
+	if ( cycles < 4000000 )
+	    return cycles * 1000 / mhz;
+	return cycles / mhz * 1000;
+}
+
+/* Show what has happened since the last call.
+ * The cycle counter wraps every 25 seconds or so at 168 Mhz,
+ * so this should be called more often than that.
+ */
+void
+react_show ( void )
+{
+	struct react *rp;
+	unsigned int now = get_systick_count ();
+	unsigned int ms = now - stat_ticks;
+	unsigned int per_ms = get_cpu_hz () / 1000;
+	int mhz = get_cpu_hz () / 1000000;
+	int busy = 0;
+	int id;
+
+	if ( ms )
+	    busy = (awake_cycles / ms) / (per_ms / 1000);
+
+	printf ( "React: %d wakeups in %d ms, awake %d/1000, %d uart overruns\n",
+	    wakeups, ms, busy, uart_overruns );
+
+	for ( id=0; id<num_react; id++ ) {
+	    rp = &react_info[id];
+	    if ( ! rp->calls )
+		continue;
+	    printf ( "  %d: %d calls, latency min/avg/max %d/%d/%d ns\n",
+		id, rp->calls,
+		cycles_ns ( rp->lat_min, mhz ),
+		cycles_ns ( rp->lat_avg >> 4, mhz ),
+		cycles_ns ( rp->lat_max, mhz ) );
+	    rp->calls = 0;
+	    rp->lat_min = 0xffffffff;
+	    rp->lat_max = 0;
+	}
+
+	stat_ticks = now;
+	awake_cycles = 0;
+	wakeups = 0;
+}
+
+/* THE END */
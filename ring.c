@@ -0,0 +1,206 @@
+/* ring.c
+ * (c) Tom Trebisky  10-19-2026
+ *
+ * Byte ring buffers, one producer and one consumer.
+ *
+ * The usual rule: only the producer moves head and only the
+ * consumer moves tail, so as long as there is one of each
+ * (say an interrupt routine and the main loop) we need no
+ * locks at all.  head and tail run free and we mask them
+ * when we index, so head - tail is always the count and the
+ * whole buffer can be used.  The size must be a power of 2.
+ *
+ * The barriers make sure the data is in memory before the
+ * other side can see the index move (and the other way around).
+ * On a single M3/M4 this is mostly about the compiler, but it
+ * also matters if DMA is involved.
+ *
+ * Besides byte and copy in/out calls, there are span calls:
+ *   ring_reserve() / ring_commit() for the producer,
+ *   ring_peek() / ring_consume() for the consumer,
+ * which give a pointer to contiguous space (or data) in the
+ * ring itself, so the caller can memcpy or DMA straight in
+ * or out.  A span stops at the end of the buffer, so getting
+ * everything can take two.
+ */
+
+#include "hydra.h"
+
+static inline void
+ring_barrier ( void )
+{
+#ifdef __arm__
+	asm volatile ( "dmb" ::: "memory" );
+#else
+	__atomic_thread_fence ( __ATOMIC_SEQ_CST );
+#endif
+}
+
+void
+ring_init ( struct ring *rp, unsigned char *buf, int size )
+{
+	rp->buf = buf;
+	rp->size = size;
+	rp->mask = size - 1;
+	rp->head = 0;
+	rp->tail = 0;
+}
+
+/* Either side can call these, the answer may be stale
+ * by the time you look at it, but only in the safe direction
+ * for the side that is asking.
+ */
+int
+ring_count ( struct ring *rp )
+{
+	return rp->head - rp->tail;
+}
+
+int
+ring_space ( struct ring *rp )
+{
+	return rp->size - (rp->head - rp->tail);
+}
+
+/* ---------------------------------------------------------- */
+/* Producer side */
+
+/* Returns 0, or -1 if full */
+int
+ring_put ( struct ring *rp, int c )
+{
+	unsigned int head = rp->head;
+
+	if ( head - rp->tail >= rp->size )
+	    return -1;
+
+	/* tail first, as in ring_reserve */
+	ring_barrier ();
+	rp->buf[head & rp->mask] = c;
+	ring_barrier ();
+	rp->head = head + 1;
+	return 0;
+}
+
+/* Contiguous free space, *len gets how much (maybe 0) */
+unsigned char *
+ring_reserve ( struct ring *rp, int *len )
+{
+	unsigned int head = rp->head;
+	unsigned int index = head & rp->mask;
+	int n;
+
+	/* tail first, then we write into what it freed */
+	n = rp->size - (head - rp->tail);
+	ring_barrier ();
+	if ( n > rp->size - index )
+	    n = rp->size - index;
+
+	*len = n;
+	return &rp->buf[index];
+}
+
+/* We put n bytes where ring_reserve() told us */
+void
+ring_commit ( struct ring *rp, int n )
+{
+	ring_barrier ();
+	rp->head += n;
+}
+
+/* Copy in as much as fits, returns how much that was */
+int
+ring_write ( struct ring *rp, const void *buf, int len )
+{
+	const unsigned char *src = buf;
+	unsigned char *p;
+	int total = 0;
+	int n;
+
+	while ( len > 0 ) {
+	    p = ring_reserve ( rp, &n );
+	    if ( n == 0 )
+		break;
+	    if ( n > len )
+		n = len;
+	    memcpy ( p, src, n );
+	    ring_commit ( rp, n );
+	    src += n;
+	    len -= n;
+	    total += n;
+	}
+
+	return total;
+}
+
+/* ---------------------------------------------------------- */
+/* Consumer side */
+
+/* Returns the byte, or -1 if empty */
+int
+ring_get ( struct ring *rp )
+{
+	unsigned int tail = rp->tail;
+	int c;
+
+	if ( rp->head == tail )
+	    return -1;
+
+	ring_barrier ();
+	c = rp->buf[tail & rp->mask];
+	ring_barrier ();
+	rp->tail = tail + 1;
+	return c;
+}
+
+/* Contiguous data, *len gets how much (maybe 0) */
+unsigned char *
+ring_peek ( struct ring *rp, int *len )
+{
+	unsigned int tail = rp->tail;
+	unsigned int index = tail & rp->mask;
+	int n;
+
+	n = rp->head - tail;
+	ring_barrier ();
+	if ( n > rp->size - index )
+	    n = rp->size - index;
+
+	*len = n;
+	return &rp->buf[index];
+}
+
+/* We are done with n bytes from ring_peek() */
+void
+ring_consume ( struct ring *rp, int n )
+{
+	ring_barrier ();
+	rp->tail += n;
+}
+
+/* Copy out as much as we have, up to len */
+int
+ring_read ( struct ring *rp, void *buf, int len )
+{
+	unsigned char *dst = buf;
+	unsigned char *p;
+	int total = 0;
+	int n;
+
+	while ( len > 0 ) {
+	    p = ring_peek ( rp, &n );
+	    if ( n == 0 )
+		break;
+	    if ( n > len )
+		n = len;
+	    memcpy ( dst, p, n );
+	    ring_consume ( rp, n );
+	    dst += n;
+	    len -= n;
+	    total += n;
+	}
+
+	return total;
+}
+
+/* THE END */
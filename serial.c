@@ -89,6 +89,8 @@ static struct uart *uart_bases[] = {
 
 struct uart_stuff {
 	ifptr uart_hook;
+	int mask;	/* 0x7f for the console, 0xff for binary */
+	int baud;	/* 0 if never set up */
 };
 
 static struct uart_stuff uart_info[NUM_UARTS];
@@ -139,7 +141,7 @@ uart1_handler ( void )
 	up->status = 0;
 
 	/* We only enable interrupts when we have a hook fn */
-	(*uart_info[UART1].uart_hook) ( up->data & 0x7f );
+	(*uart_info[UART1].uart_hook) ( up->data & uart_info[UART1].mask );
 }
 
 void
@@ -151,7 +153,7 @@ uart2_handler ( void )
 	up->status = 0;
 
 	/* We only enable interrupts when we have a hook fn */
-	(*uart_info[UART2].uart_hook) ( up->data & 0x7f );
+	(*uart_info[UART2].uart_hook) ( up->data & uart_info[UART2].mask );
 }
 
 #ifdef CHIP_F103
@@ -164,7 +166,7 @@ uart3_handler ( void )
 	up->status = 0;
 
 	/* We only enable interrupts when we have a hook fn */
-	(*uart_info[UART3].uart_hook) ( up->data & 0x7f );
+	(*uart_info[UART3].uart_hook) ( up->data & uart_info[UART3].mask );
 }
 #endif
 
@@ -173,16 +175,63 @@ uart3_handler ( void )
  * rate.  We could worry about it not dividing evenly, but
  * what can we do if it does not?
  */
+static void
+serial_set_baud ( int uart )
+{
+	struct uart *up = uart_bases[uart];
+	int baud = uart_info[uart].baud;
+
+	if ( uart == UART2 )
+	    up->baud = get_pclk1() / baud;
+	else
+	    up->baud = get_pclk2() / baud;
+}
+
+/* The CPU clock is changing (see rcc_411.c).
+ * Let what we are sending go out at the old rate, then
+ * work out the divisor again.
+ * The handlers clear TC along with everything else, so
+ * we can't just wait for it forever.
+ */
+static void
+serial_clock ( int what )
+{
+	struct uart *up;
+	int uart;
+	int tmo;
+
+	for ( uart=0; uart<NUM_UARTS; uart++ ) {
+	    if ( ! uart_info[uart].baud )
+		continue;
+	    up = uart_bases[uart];
+	    if ( what == RCC_CHANGING ) {
+		while ( ! (up->status & ST_TXE) )
+		    ;
+		for ( tmo=0; tmo<100000; tmo++ )
+		    if ( up->status & ST_TC )
+			break;
+	    } else
+		serial_set_baud ( uart );
+	}
+}
+
+static int serial_notified;
+
 int
 serial_begin ( int uart, int baud )
 {
 	struct uart *up;
-	int baud_val;
+
+	if ( ! serial_notified ) {
+	    rcc_notify ( serial_clock );
+	    serial_notified = 1;
+	}
 
 	gpio_uart_init ( uart );
 
 	up = uart_bases[uart];
 	uart_info[uart].uart_hook = (ifptr) 0;
+	uart_info[uart].mask = 0x7f;
 
 	/* 1 start bit, even parity */
 	up->cr1 = CR1_CONSOLE;
@@ -192,12 +241,25 @@ serial_begin ( int uart, int baud )
 	up->cr3 = 0;
 	up->gtp = 0;
 
-	if ( uart == UART2 )
-	    baud_val = get_pclk1() / baud;
-	else
-	    baud_val = get_pclk2() / baud;
+	uart_info[uart].baud = baud;
+	serial_set_baud ( uart );
+
+	return uart;
+}
+
+/* The GPS wants 8 bits, no parity (the console setup above
+ * is 8 bits plus even parity), and we pass all 8 bits along.
+ */
+int
+serial_begin_gps ( int uart, int baud )
+{
+	struct uart *up = uart_bases[uart];
 
-	up->baud = baud_val;
+	serial_begin ( uart, baud );
+	up->cr1 = CR1_GPS;
+
+	/* UBX messages are binary */
+	uart_info[uart].mask = 0xff;
 
 	return uart;
 }
@@ -286,6 +348,9 @@ serial_putc ( int uart, int c )
 	while ( ! (up->status & ST_TXE) )
 	    ;
 	up->data = c;
+#ifdef HYDRA_HOST
+	host_uart_tx ( uart, c );
+#endif
 }
 
 /* rarely used, like putc, but treats newlines
@@ -299,6 +364,9 @@ serial_write ( int uart, int c )
 	while ( ! (up->status & ST_TXE) )
 	    ;
 	up->data = c;
+#ifdef HYDRA_HOST
+	host_uart_tx ( uart, c );
+#endif
 }
 
 void
@@ -339,6 +407,12 @@ set_std_serial ( int arg )
 	std_serial = arg;
 }
 
+int
+get_std_serial ( void )
+{
+	return std_serial;
+}
+
 #ifdef notdef
 /* Common shortcut */
 void
@@ -429,7 +503,10 @@ sprintf ( char *buf, char *fmt, ... )
  *  %x to inject a 8 bit hex value
  */
 
-#define PUTCHAR(x)      if ( buf <= end ) *buf++ = (x)
+/* x gets evaluated even once the buffer is full, since
+ * sprintn() (*--cp) and %c (va_arg) count on its side effects.
+ */
+#define PUTCHAR(x)      do { int pc_ = (x); if ( buf <= end ) *buf++ = pc_; } while ( 0 )
 
 static const char hex_table[] = "0123456789ABCDEF";
 
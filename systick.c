@@ -75,7 +75,7 @@ struct systick {
  */
 #define CPUID_BASE	(unsigned int *) 0xE000ED00
 
-static unsigned int systick_count;
+static volatile unsigned int systick_count;
 
 unsigned int
 get_systick_count ( void )
@@ -85,20 +85,77 @@ get_systick_count ( void )
 
 static vfptr systick_hook;
 
+#ifdef HYDRA_IRQ_STATS
+/* How long event_tick() takes, see tick_show()
+ * This costs two get_cycles() on every tick, so it
+ * is only there with "make IRQ_STATS=yes" (and qemu).
+ */
+static unsigned int tick_calls;
+static unsigned int tick_cycles;
+static unsigned int tick_max;
+#endif
+
 /* This is referenced from the table in locore.s
  */
 void
 systick_handler ( void )
 {
+#ifdef HYDRA_IRQ_STATS
+	unsigned int t;
+#endif
+
 	systick_count++;
 
+#ifdef HYDRA_IRQ_STATS
+	t = get_cycles ();
 	event_tick ();
+	t = get_cycles () - t;
+
+	tick_cycles += t;
+	if ( t > tick_max )
+	    tick_max = t;
+	tick_calls++;
+#else
+	event_tick ();
+#endif
 
 	// toggle_led ();
 	if ( systick_hook )
 	    (*systick_hook) ();
 }
 
+/* Since the last call (or tick_show)
+ * All zero without HYDRA_IRQ_STATS.
+ */
+void
+tick_stats ( int *calls, int *avg, int *max )
+{
+#ifdef HYDRA_IRQ_STATS
+	*calls = tick_calls;
+	*avg = tick_calls ? tick_cycles / tick_calls : 0;
+	*max = tick_max;
+
+	tick_calls = 0;
+	tick_cycles = 0;
+	tick_max = 0;
+#else
+	*calls = 0;
+	*avg = 0;
+	*max = 0;
+#endif
+}
+
+void
+tick_show ( void )
+{
+	int calls, avg, max;
+
+	tick_stats ( &calls, &avg, &max );
+	if ( calls )
+	    printf ( "event_tick: %d calls, avg %d, max %d cycles\n",
+		calls, avg, max );
+}
+
 void
 systick_hookup ( vfptr fn )
 {
@@ -106,6 +163,63 @@ systick_hookup ( vfptr fn )
 	// show_reg ( "systick hookup", &systick_hook );
 }
 
+/* The DWT (data watchpoint and trace) unit has a 32 bit
+ * counter that counts CPU cycles.  It must be enabled by
+ * setting TRCENA in the debug DEMCR register first.
+ * Both the M3 and M4 have it.
+ * stm_init() calls this first thing, to time the boot.
+ */
+#define DEMCR		((volatile unsigned int *) 0xE000EDFC)
+#define DWT_CTRL	((volatile unsigned int *) 0xE0001000)
+
+#define DEMCR_TRCENA	BIT(24)
+#define DWT_CYCCNTENA	BIT(0)
+
+void
+cycle_init ( void )
+{
+	*DEMCR |= DEMCR_TRCENA;
+	*DWT_CYCCNT = 0;
+	*DWT_CTRL |= DWT_CYCCNTENA;
+}
+
+#ifdef HYDRA_QEMU
+/* QEMU has no DWT, so get_cycles() comes here and we count
+ * with systick instead.  Under -icount this goes by the
+ * instructions executed, see Tools/qemu_run.c
+ * If systick wraps while interrupts are masked we are off
+ * by one tick until the handler runs.
+ */
+unsigned int
+systick_cycles ( void )
+{
+	struct systick *sp = SYSTICK_BASE;
+	unsigned int count;
+	unsigned int val;
+
+	do {
+	    count = systick_count;
+	    val = sp->value;
+	} while ( count != systick_count );
+
+	return count * (sp->reload + 1) + sp->reload - val;
+}
+#endif
+
+/* Work out the reload for the CPU clock, again if
+ * that ever changes (see rcc_notify).
+ */
+static void
+systick_clock ( int what )
+{
+	struct systick *sp = SYSTICK_BASE;
+
+	if ( what == RCC_CHANGED ) {
+	    sp->reload = get_cpu_hz () / SYSTICK_RATE - 1;
+	    sp->value = 0;
+	}
+}
+
 /* Systick is a 24 bit counter.
  * 96,000,000 = 0x5B8D800 (too big)
  *  9,600,000 = 0x927C00  (ok - 10 Hz)
@@ -126,6 +240,8 @@ systick_init ( void )
 	sp->value = 0;
 	sp->csr = CSR_SYSCLK | CSR_INTENA | CSR_ENABLE;
 
+	rcc_notify ( systick_clock );
+
 	// show32 ( "Systick CSR: ", stp->csr );
 	// show32 ( "Systick Cal: ", stp->cal );
 }
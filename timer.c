@@ -0,0 +1,217 @@
+/* timer.c
+ * (c) Tom Trebisky  10-19-2026
+ *
+ * Driver for the general purpose timers TIM2 .. TIM5
+ *
+ * For now all we do is set a timer up to give periodic
+ * "update" interrupts and call a hook function each time.
+ *
+ * The F411 and F4xx have TIM2 through TIM5 on APB1.
+ * TIM2 and TIM5 are 32 bit, TIM3 and TIM4 are 16 bit.
+ * The F103 has TIM2 through TIM4 (all 16 bit) and happily
+ * they live at the same addresses as on the F4.
+ * The register layout is the same on both chips, as far
+ * as we care anyway.
+ */
+
+#include "hydra.h"
+
+struct timer {
+	volatile unsigned int cr1;	/* 0x00 */
+	volatile unsigned int cr2;	/* 0x04 */
+	volatile unsigned int smcr;	/* 0x08 */
+	volatile unsigned int dier;	/* 0x0c - interrupt enables */
+	volatile unsigned int sr;	/* 0x10 - status */
+	volatile unsigned int egr;	/* 0x14 - event generation */
+	volatile unsigned int ccmr1;	/* 0x18 */
+	volatile unsigned int ccmr2;	/* 0x1c */
+	volatile unsigned int ccer;	/* 0x20 */
+	volatile unsigned int cnt;	/* 0x24 */
+	volatile unsigned int psc;	/* 0x28 - prescaler */
+	volatile unsigned int arr;	/* 0x2c - auto reload */
+	    int __pad1;
+	volatile unsigned int ccr[4];	/* 0x34 .. 0x40 */
+	    int __pad2;
+	volatile unsigned int dcr;	/* 0x48 */
+	volatile unsigned int dmar;	/* 0x4c */
+	volatile unsigned int or;	/* 0x50 - F4 TIM2 and TIM5 only */
+};
+
+#define TIM2_BASE	(struct timer *) 0x40000000
+#define TIM3_BASE	(struct timer *) 0x40000400
+#define TIM4_BASE	(struct timer *) 0x40000800
+#define TIM5_BASE	(struct timer *) 0x40000c00
+
+#define TIM2_IRQ	28
+#define TIM3_IRQ	29
+#define TIM4_IRQ	30
+#define TIM5_IRQ	50
+
+#ifdef CHIP_F103
+#define NUM_TIMERS	3
+#else
+#define NUM_TIMERS	4
+#endif
+
+static struct timer *timer_bases[] = {
+    TIM2_BASE, TIM3_BASE, TIM4_BASE, TIM5_BASE
+};
+
+static int timer_irqs[] = {
+    TIM2_IRQ, TIM3_IRQ, TIM4_IRQ, TIM5_IRQ
+};
+
+/* Bits in cr1 */
+#define CR1_CEN		0x0001		/* counter enable */
+#define CR1_URS		0x0004		/* only overflow gives update */
+#define CR1_ARPE	0x0080		/* arr is buffered */
+
+/* Bits in dier and sr */
+#define TIM_UIE		0x0001		/* update */
+
+/* Bits in egr */
+#define EGR_UG		0x0001
+
+struct timer_stuff {
+	afptr hook;
+	void *arg;
+	int hz;		/* 0 if not set up by timer_rate() */
+};
+
+static struct timer_stuff timer_info[NUM_TIMERS];
+
+/* The timers on APB1 run at twice the APB1 clock whenever the
+ * APB1 prescaler is not 1, which is the case for every clock
+ * setup we use (F411, F4xx, and F103).
+ */
+int
+get_timer_hz ( void )
+{
+	return get_pclk1 () * 2;
+}
+
+static void
+timer_irq ( int timer )
+{
+	struct timer *tp = timer_bases[timer];
+	unsigned int sr;
+
+	sr = tp->sr;
+	tp->sr = ~sr;
+
+	if ( (sr & TIM_UIE) && timer_info[timer].hook )
+	    (*timer_info[timer].hook) ( timer_info[timer].arg );
+}
+
+/* These are referenced from the table in locore.s
+ */
+void tim2_handler ( void ) { timer_irq ( TIMER2 ); }
+void tim3_handler ( void ) { timer_irq ( TIMER3 ); }
+void tim4_handler ( void ) { timer_irq ( TIMER4 ); }
+
+#ifndef CHIP_F103
+void tim5_handler ( void ) { timer_irq ( TIMER5 ); }
+#endif
+
+/* Change the rate of a timer set up by timer_init()
+ * TIM3 and TIM4 are only 16 bits, so we use the prescaler
+ * if we need to.  We don't bother being clever about
+ * picking a prescaler that divides evenly.
+ */
+void
+timer_rate ( int timer, int hz )
+{
+	struct timer *tp = timer_bases[timer];
+	unsigned int count;
+	unsigned int pre;
+
+	count = get_timer_hz () / hz;
+	pre = 0;
+
+	if ( timer == TIMER3 || timer == TIMER4 || NUM_TIMERS == 3 ) {
+	    pre = (count - 1) / 65536;
+	    count /= pre + 1;
+	}
+
+	tp->psc = pre;
+	tp->arr = count - 1;
+
+	/* load the prescaler now, not at the next overflow */
+	tp->egr = EGR_UG;
+	tp->sr = 0;
+
+	timer_info[timer].hz = hz;
+}
+
+/* The CPU clock changed (see rcc_notify), so the
+ * timer clock did too.  Timers that run free for
+ * capture (capture.c) just count at the new rate.
+ */
+static void
+timer_clock ( int what )
+{
+	int timer;
+
+	if ( what != RCC_CHANGED )
+	    return;
+
+	for ( timer=0; timer<NUM_TIMERS; timer++ )
+	    if ( timer_info[timer].hz )
+		timer_rate ( timer, timer_info[timer].hz );
+}
+
+static int timer_notified;
+
+/* Set up a timer to call fn(arg) hz times per second
+ * at interrupt level.  The timer does not run until
+ * timer_start() is called.
+ */
+int
+timer_init ( int timer, int hz, afptr fn, void *arg )
+{
+	struct timer *tp;
+
+	if ( timer < 0 || timer >= NUM_TIMERS )
+	    return -1;
+
+	tp = timer_bases[timer];
+
+	if ( ! timer_notified ) {
+	    rcc_notify ( timer_clock );
+	    timer_notified = 1;
+	}
+
+	tp->cr1 = 0;
+	tp->dier = 0;
+
+	timer_info[timer].hook = fn;
+	timer_info[timer].arg = arg;
+
+	timer_rate ( timer, hz );
+
+	tp->cr1 = CR1_URS | CR1_ARPE;
+	tp->dier = TIM_UIE;
+
+	nvic_enable ( timer_irqs[timer] );
+
+	return timer;
+}
+
+void
+timer_start ( int timer )
+{
+	struct timer *tp = timer_bases[timer];
+
+	tp->cnt = 0;
+	tp->cr1 |= CR1_CEN;
+}
+
+void
+timer_stop ( int timer )
+{
+	struct timer *tp = timer_bases[timer];
+
+	tp->cr1 &= ~CR1_CEN;
+}
+
+/* THE END */
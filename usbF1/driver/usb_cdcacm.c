@@ -60,6 +60,11 @@
 #include "usb_def.h"
 #endif
 
+#ifdef HYDRA
+/* from string.c */
+void *memcpy ( void *, const void *, __SIZE_TYPE__ );
+#endif
+
 /******************************************************************************
  ******************************************************************************
  ***
@@ -443,12 +448,13 @@ uint32 usb_cdcacm_tx(const uint8* buf, uint32 len)
     }
 	if (len==0) return 0; // buffer full
 
-	uint16 i;
 	// copy data from user buffer to USB Tx buffer
-	for (i=0; i<len; i++) {
-		vcomBufferTx[head] = buf[i];
-		head = (head+1) & CDC_SERIAL_TX_BUFFER_SIZE_MASK;
-	}
+	// at most two pieces, if we wrap around the end
+	uint32 n = CDC_SERIAL_TX_BUFFER_SIZE - head;
+	if (n > len) n = len;
+	memcpy(&vcomBufferTx[head], buf, n);
+	memcpy(vcomBufferTx, buf + n, len - n);
+	head = (head + len) & CDC_SERIAL_TX_BUFFER_SIZE_MASK;
 	tx_head = head; // store volatile variable
 
 	if (transmitting<0) {
@@ -136,7 +136,7 @@ CoreReset(HANDLE *pdev)
 * @param  bytes : No. of bytes
 * @retval Status : status
 */
-Status
+Status __RAMFUNC__
 WritePacket(HANDLE *pdev, 
                                 uint8_t             *src, 
                                 uint8_t             ch_ep_num, 
@@ -162,7 +162,7 @@ WritePacket(HANDLE *pdev,
 * @param  dest : Destination Pointer
 * @param  bytes : No. of bytes
 */
-void *
+void * __RAMFUNC__
 ReadPacket(HANDLE *pdev, 
                          uint8_t *dest, 
                          uint16_t len)
@@ -169,13 +169,17 @@ int tusb_int_count = 0;
 int tusb_sof_count = 0;
 int tusb_xof_count = 0;
 
+/* tjt - this, the endpoint handlers it calls, and the FIFO
+ * routines in driver.c run from sram, see __RAMFUNC__ in types.h
+ */
+
 /**
 * @brief  STM32_USBF_OTG_ISR_Handler
 *         handles all USB Interrupts
 * @param  pdev: device instance
 * @retval status
 */
-uint32_t
+uint32_t __RAMFUNC__
 OTG_ISR_Handler (HANDLE *pdev)
 {
   GINTStatus_TypeDef  gintr_status;
@@ -430,7 +434,7 @@ static uint32_t HandleUSBSuspend_ISR(HANDLE *pdev)
 * @param  pdev: device instance
 * @retval status
 */
-static uint32_t
+static uint32_t __RAMFUNC__
 HandleInEP_ISR(HANDLE *pdev)
 {
   DIEPINTn_TypeDef  diepint;
@@ -498,7 +502,7 @@ HandleInEP_ISR(HANDLE *pdev)
 * @param  pdev: device instance
 * @retval status
 */
-static uint32_t
+static uint32_t __RAMFUNC__
 HandleOutEP_ISR(HANDLE *pdev)
 {
   uint32_t ep_intr;
@@ -596,7 +600,7 @@ static uint32_t HandleSof_ISR(HANDLE *pdev)
 * @param  pdev: device instance
 * @retval status
 */
-static uint32_t
+static uint32_t __RAMFUNC__
 HandleRxStatusQueueLevel_ISR(HANDLE *pdev)
 {
   GINTMSK_TypeDef  int_mask;
@@ -653,7 +657,7 @@ HandleRxStatusQueueLevel_ISR(HANDLE *pdev)
 * @param  pdev: device instance
 * @retval status
 */
-static uint32_t 
+static uint32_t __RAMFUNC__
 WriteEmptyTxFifo(HANDLE *pdev, uint32_t epnum)
 {
   DTXFStatusn_TypeDef  txstatus;
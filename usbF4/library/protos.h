@@ -5,6 +5,11 @@
  * Tom Trebisky 3/30/2025
  */
 
+/* Defined in ../string.c */
+void *memcpy ( void *, const void *, __SIZE_TYPE__ );
+void *memmove ( void *, const void *, __SIZE_TYPE__ );
+void *memset ( void *, int, __SIZE_TYPE__ );
+
 /* Defined in usbd_req.c */
 Status  StdDevReq (HANDLE  *pdev, USB_SETUP_REQ  *req);
 Status  StdItfReq (HANDLE  *pdev, USB_SETUP_REQ  *req);
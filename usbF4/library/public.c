@@ -11,6 +11,9 @@
 #include "usb_core.h"
 #include "protos.h"
 
+/* for get_cycles() */
+#include "../../hydra.h"
+
 // #include "usbd_core.h"
 
 typedef void (*bfptr) ( char *, int );
@@ -64,6 +67,15 @@ usb_hookup ( bfptr fn )
 		class_usb_hookup ( fn );
 }
 
+/* fn gets called (at interrupt level) when there is
+ * something for usb_read()
+ */
+void
+usb_notify ( void (*fn) ( void ) )
+{
+		class_usb_notify ( fn );
+}
+
 /* ============================================================================== */
 /* ============================================================================== */
 /* Next we have things called from the above that are "glue" to the
@@ -129,6 +141,30 @@ fusb_init (void)
 		return 0;
 }
 
+/* Straight to the endpoint 0 FIFOs, for the benchmarks
+ * in bench.c, which run these with interrupts off and
+ * flush afterwards.  Don't do this while the host is
+ * talking to us.
+ */
+void
+usb_fifo_write ( char *buf, int len )
+{
+	WritePacket ( &dev, (uint8_t *) buf, 0, len );
+}
+
+void
+usb_fifo_read ( char *buf, int len )
+{
+	ReadPacket ( &dev, (uint8_t *) buf, len );
+}
+
+void
+usb_fifo_flush ( void )
+{
+	FlushTxFifo ( &dev, 0 );
+	FlushRxFifo ( &dev );
+}
+
 #ifdef notdef
 void
 usbPowerOff ( void )
@@ -266,6 +302,39 @@ mystrlen ( char *s )
  * for its special EP-1 interrupts.
  */
 
+#ifdef HYDRA_IRQ_STATS
+/* How long the handler takes, see usb_isr_show() */
+static unsigned int isr_calls;
+static unsigned int isr_cycles;
+static unsigned int isr_max;
+
+void
+usb_irq_handler ( void )
+{
+	unsigned int t;
+
+	t = get_cycles ();
+	OTG_ISR_Handler ( &dev );
+	t = get_cycles () - t;
+
+	isr_cycles += t;
+	if ( t > isr_max )
+	    isr_max = t;
+	isr_calls++;
+}
+
+/* Since the last call */
+void
+usb_isr_show ( void )
+{
+	if ( isr_calls )
+	    printf ( "OTG_ISR_Handler: %d calls, avg %d, max %d cycles\n",
+		isr_calls, isr_cycles / isr_calls, isr_max );
+	isr_calls = 0;
+	isr_cycles = 0;
+	isr_max = 0;
+}
+#else
 void
 usb_irq_handler ( void )
 {
@@ -273,6 +342,13 @@ usb_irq_handler ( void )
 	OTG_ISR_Handler ( &dev );
 }
 
+/* Only with "make IRQ_STATS=yes" */
+void
+usb_isr_show ( void )
+{
+}
+#endif
+
 void
 usb_wakeup_handler ( void )
 {
@@ -64,6 +64,13 @@ typedef void (*voidFuncPtr)(void);
 #endif
 #endif
 
+/* tjt - code that runs from sram, see HYDRA_RAMFUNC in hydra.h */
+#ifndef NO_RAMFUNC
+#ifndef __attr_ramfunc
+  #define __attr_ramfunc __attribute__((section (".ramfunc"), noinline))
+#endif
+#endif
+
 #ifdef __always_inline
   #undef  __always_inline
 #endif
@@ -84,6 +91,12 @@ typedef void (*voidFuncPtr)(void);
 #define __CCMRAM__
 #endif
 
+#ifndef NO_RAMFUNC
+#define __RAMFUNC__ __attr_ramfunc
+#else
+#define __RAMFUNC__
+#endif
+
 #endif
 
 /* THE END */
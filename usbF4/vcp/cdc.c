@@ -28,6 +28,9 @@
 
 #include "usb_conf.h"
 #include "conf.h"
+
+/* For the rings (see ring.c) */
+#include "../../hydra.h"
 #include "vcp.h"
 
 
@@ -96,8 +99,12 @@ __ALIGN_BEGIN uint8_t __CCMRAM__ APP_Tx_Buffer[APP_TX_DATA_SIZE] __ALIGN_END ;
  
 __ALIGN_BEGIN uint8_t CmdBuff[CDC_CMD_PACKET_SZE] __ALIGN_END ;
 
-volatile uint16_t APP_Tx_ptr_in  = 0;
-volatile uint16_t APP_Tx_ptr_out = 0;
+/* VCP_DataTx() is the producer, we are the consumer.
+ * What we hand to EP_Tx() stays in the ring (so it can't
+ * get written over) until the IN transfer is done.
+ */
+struct ring app_tx_ring = RING_INIT ( APP_Tx_Buffer );
+static int USB_Tx_inflight = 0;
 
 static uint8_t  USB_Tx_State = 0;
 
@@ -401,8 +408,14 @@ CLASS_DataIn (void *pdev, uint8_t epnum)
 	if ( USB_Tx_State == 0 )
 		return OK;
 
-    uint16_t USB_Tx_ptr = APP_Tx_ptr_out;
-    uint16_t USB_Tx_length = (APP_Tx_ptr_in - USB_Tx_ptr) & APP_TX_DATA_SIZE_MASK;
+    uint8_t *USB_Tx_ptr;
+    int USB_Tx_length;
+
+    /* That one is done */
+    ring_consume ( &app_tx_ring, USB_Tx_inflight );
+    USB_Tx_inflight = 0;
+
+    USB_Tx_ptr = ring_peek ( &app_tx_ring, &USB_Tx_length );
 
     usb_debug ( DM_ORIG, "usbd_cdc_DataIn called with %d bytes waiting to send on endpoint %d\n", USB_Tx_length, epnum );
 
@@ -424,17 +437,14 @@ CLASS_DataIn (void *pdev, uint8_t epnum)
     if (USB_Tx_length > CDC_DATA_IN_PACKET_SIZE)
        USB_Tx_length = CDC_DATA_IN_PACKET_SIZE;
 
-    if ( USB_Tx_length > (APP_TX_DATA_SIZE - USB_Tx_ptr) )
-       USB_Tx_length = (APP_TX_DATA_SIZE - USB_Tx_ptr);
-
-    APP_Tx_ptr_out = (USB_Tx_ptr + USB_Tx_length) & APP_TX_DATA_SIZE_MASK;
+    USB_Tx_inflight = USB_Tx_length;
 
 	usb_debug ( DM_WRITE1, "USB Tx datain send: %d\n", USB_Tx_length );
 
     /* Prepare the available data buffer to be sent on IN endpoint */
     EP_Tx (pdev,
                  CDC_IN_EP,
-                 (uint8_t*)&APP_Tx_Buffer[USB_Tx_ptr],
+                 USB_Tx_ptr,
                  USB_Tx_length);
 
   return OK;
@@ -503,14 +513,13 @@ CLASS_SOF(void *pdev)
 static void
 Handle_USBAsynchXfer(void *pdev)
 {
-    uint16_t USB_Tx_ptr;
-    uint16_t USB_Tx_length;
+    uint8_t *USB_Tx_ptr;
+    int USB_Tx_length;
 
     if ( USB_Tx_State )
   	    return;
 
-    USB_Tx_ptr = APP_Tx_ptr_out;
-    USB_Tx_length = (APP_Tx_ptr_in - USB_Tx_ptr) & APP_TX_DATA_SIZE_MASK;
+    USB_Tx_ptr = ring_peek ( &app_tx_ring, &USB_Tx_length );
 
     if ( USB_Tx_length==0 )
         return; // nothing to send
@@ -522,16 +531,13 @@ Handle_USBAsynchXfer(void *pdev)
     if (USB_Tx_length > CDC_DATA_IN_PACKET_SIZE)
        USB_Tx_length = CDC_DATA_IN_PACKET_SIZE;
 
-    if ( USB_Tx_length > (APP_TX_DATA_SIZE - USB_Tx_ptr) )
-       USB_Tx_length = (APP_TX_DATA_SIZE - USB_Tx_ptr);
-
-    APP_Tx_ptr_out = (USB_Tx_ptr + USB_Tx_length) & APP_TX_DATA_SIZE_MASK;
+    USB_Tx_inflight = USB_Tx_length;
 
 	usb_debug ( DM_WRITE1, "USB Tx asynch send: %d\n", USB_Tx_length );
 
     EP_Tx (pdev,
                CDC_IN_EP,
-               (uint8_t*)&APP_Tx_Buffer[USB_Tx_ptr],
+               USB_Tx_ptr,
                USB_Tx_length);
 }
 
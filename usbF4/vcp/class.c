@@ -27,6 +27,12 @@ class_usb_hookup ( bfptr x )
 		VCP_hookup ( x );
 }
 
+void
+class_usb_notify ( void (*fn) ( void ) )
+{
+		VCP_notify ( fn );
+}
+
 void
 class_usb_write ( char *buf, int len )
 {
@@ -23,6 +23,9 @@
 #include "conf.h"
 #include "vcp.h"
 
+/* For the rings (see ring.c) */
+#include "../../hydra.h"
+
 #define DEFAULT_CONFIG                  0
 #define OTHER_CONFIG                    1
 
@@ -43,21 +46,14 @@ static LINE_CODING linecoding =
 
 /* These are external variables imported from CDC core to be used for IN
    transfer management. */
-extern uint8_t  APP_Tx_Buffer []; /* Write CDC received data in this buffer.
-                                     These data will be sent over USB IN endpoint
-                                     in the CDC core functions. */
-extern volatile uint16_t APP_Tx_ptr_in;    /* Increment this pointer or roll it back to
-                                     start address when writing received data
-                                     in the buffer APP_Tx_Buffer. */
-extern volatile uint16_t APP_Tx_ptr_out;
+extern struct ring app_tx_ring;	/* Write CDC received data in this ring.
+                                   These data will be sent over USB IN endpoint
+                                   in the CDC core functions. */
 
 #define UsbRecBufferSize 2048
-#define UsbRecBufferSizeMask (UsbRecBufferSize-1)
 
 static uint8_t __CCMRAM__ UsbRecBuffer[UsbRecBufferSize];
-
-volatile int UsbRecRead = 0;
-volatile int UsbRecWrite = 0;
+static struct ring usb_rx_ring = RING_INIT ( UsbRecBuffer );
 uint8_t UsbTXBlock = 1;
 
 uint8_t rxDisabled = 1;
@@ -78,7 +74,7 @@ int VCPGetRTS(void) { return VCP_RTSHIGH; }
 int
 VCPBytesAvailable(void)
 {
-	return (UsbRecWrite - UsbRecRead) & UsbRecBufferSizeMask;
+	return ring_count ( &usb_rx_ring );
 }
 
 extern void usbd_cdc_PrepareRx (void *pdev);
@@ -89,26 +85,12 @@ extern void usbd_cdc_PrepareRx (void *pdev);
 uint32_t
 VCPGetBytes(uint8_t * rxBuf, uint32_t len)
 {
-	int usbRxRead = UsbRecRead; // take volatile
-
-	uint32_t rx_unread = (UsbRecWrite - usbRxRead) & UsbRecBufferSizeMask;
-
-	if (rx_unread==0) {
+	len = ring_read ( &usb_rx_ring, rxBuf, len );
+	if ( len == 0 )
 		return 0;
-	}
-
-	if (len>rx_unread) len = rx_unread;
-	
-	for (uint32_t i = 0; i<len; i++) {
-		*rxBuf++ = UsbRecBuffer[usbRxRead++];
-		usbRxRead &= UsbRecBufferSizeMask;
-	}
-
-	UsbRecRead = usbRxRead; // update volatile
 
 	// check if the OUT endpoint has to be re-enabled
-	uint32_t free_rx_space = (usbRxRead-UsbRecWrite-1) & UsbRecBufferSizeMask;
-	if ( free_rx_space>=CDC_DATA_MAX_PACKET_SIZE && rxDisabled ) {
+	if ( ring_space ( &usb_rx_ring ) >= CDC_DATA_MAX_PACKET_SIZE && rxDisabled ) {
 		rxDisabled = 0;
 		if (usbDevice) usbd_cdc_PrepareRx(usbDevice);
 	}
@@ -261,33 +243,21 @@ VCP_Ctrl (uint32_t Cmd, uint8_t* Buf, uint32_t Len)
 uint32_t
 VCP_DataTx (const uint8_t* Buf, uint32_t Len)
 {
-	uint32_t ptrIn = APP_Tx_ptr_in; // get volatile
 	uint32_t cnt = 0;
-	uint16_t cdc_buf_cnt = 0;
+	int n;
 
 	usb_debug ( DM_ORIG, "- VCP DataTx %d bytes: %c%c%c\n", Len, Buf[0], Buf[1], Buf[2] );
 	// printf ( "- VCP DataTx %d bytes: %c%c%c\n", Len, Buf[0], Buf[1], Buf[2] );
 
+	/* If the ring is full, wait for the USB side to drain it
+	 * (unless we are not supposed to block).
+	 */
 	while ( cnt<Len ) {
-		while ( ((ptrIn+1)&APP_TX_DATA_SIZE_MASK)==APP_Tx_ptr_out ) {
-			if( ! UsbTXBlock || ! VCP_DTRHIGH ) {
-				goto tx_exit;
-			}
-		}
-		APP_Tx_Buffer[ptrIn++] = *Buf++;
-		ptrIn &= APP_TX_DATA_SIZE_MASK;
-		// update volatile pointer if the nr of bytes can fill up the CDC_DATA buffer
-		if ( cdc_buf_cnt==CDC_DATA_MAX_PACKET_SIZE ) {
-			cdc_buf_cnt = 0;
-			APP_Tx_ptr_in = ptrIn; // update volatile
-		} else {
-			cdc_buf_cnt ++;
-		}
-		cnt ++;
+		n = ring_write ( &app_tx_ring, Buf + cnt, Len - cnt );
+		if ( n == 0 && ( ! UsbTXBlock || ! VCP_DTRHIGH ) )
+			break;
+		cnt += n;
 	}
-
-tx_exit:
-	APP_Tx_ptr_in = ptrIn; // update volatile
 	printf ( "- VCP DataTx returns: %d\n", cnt );
 	return cnt;
 }
@@ -296,6 +266,7 @@ tx_exit:
 typedef void (*bfptr) ( char *, int );
 
 static bfptr usb_read_hook = (bfptr) 0;
+static vfptr usb_notify_hook = (vfptr) 0;
 
 /* see class.c */
 void
@@ -304,6 +275,16 @@ VCP_hookup ( bfptr f )
 	usb_read_hook = f;
 }
 
+/* Called (at interrupt level) whenever data gets put
+ * into the receive ring, so user code can wait for it
+ * rather than calling usb_read() over and over.
+ */
+void
+VCP_notify ( vfptr f )
+{
+	usb_notify_hook = f;
+}
+
 
 /**
   * @brief  VCP_DataRx
@@ -350,16 +331,13 @@ VCP_DataRx(uint8_t* Buf, uint32_t Len)
 	    return OK;
 	}
 
-	uint32_t rxWr = UsbRecWrite; // get volatile
-	while(Len-- > 0) {
-		UsbRecBuffer[rxWr++] = *Buf++;
-		rxWr &= UsbRecBufferSizeMask;
-	}
-	UsbRecWrite = rxWr; // store volatile
+	ring_write ( &usb_rx_ring, Buf, Len );
+
+	if ( usb_notify_hook )
+	    ( *usb_notify_hook ) ();
 
 	// check for enough space in Rx buffer for the next Rx packet
-	uint32_t free_rx_space = (UsbRecRead-rxWr-1) & UsbRecBufferSizeMask;
-	if ( free_rx_space<CDC_DATA_MAX_PACKET_SIZE ) {
+	if ( ring_space ( &usb_rx_ring ) < CDC_DATA_MAX_PACKET_SIZE ) {
 		rxDisabled = 1; // disable OUT endpoint
 		return BUSY;
 	}